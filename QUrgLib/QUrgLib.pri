@@ -7,11 +7,17 @@ INCLUDEPATH += "$$PWD"/src
 
 win32:LIBS += -lwsock32 -lsetupapi -ladvapi32
 
+linux:HEADERS += $$PWD/src/SerialBaudrate.h
+linux:SOURCES += $$PWD/src/SerialBaudrate_lin.cpp
+
 HEADERS += \
     $$PWD/src/UrgUsbCom.h \
     $$PWD/src/UrgLogHandler.h \
+    $$PWD/src/UbhIndex.h \
+    $$PWD/src/UbhIndexer.h \
     $$PWD/src/UrgDevice.h \
     $$PWD/src/ScipHandler.h \
+    $$PWD/src/ScipReply.h \
     $$PWD/src/IsUsbCom.h \
     $$PWD/src/isUsingComDriver.h \
     $$PWD/src/RangeCaptureMode.h \
@@ -20,14 +26,26 @@ HEADERS += \
     $$PWD/src/RangeSensorInformation.h \
     $$PWD/src/delay.h \
     $$PWD/src/RangeSensor.h \
+    $$PWD/src/ScanData.h \
+    $$PWD/src/ScanBufferPool.h \
+    $$PWD/src/ScanReactor.h \
+    $$PWD/src/SpscQueue.h \
+    $$PWD/src/TripleBuffer.h \
     $$PWD/src/Connection.h \
     $$PWD/src/SerialDevice.h \
+    $$PWD/src/CacheFile.h \
+    $$PWD/src/BaudrateCache.h \
+    $$PWD/src/CommandCache.h \
     $$PWD/src/CaptureSettings.h \
+    $$PWD/src/CaptureStatistics.h \
     $$PWD/src/ticks.h \
     $$PWD/src/Thread.h \
     $$PWD/src/log_printf.h \
     $$PWD/src/MathUtils.h \
     $$PWD/src/ConnectionUtils.h \
+    $$PWD/src/LineReader.h \
+    $$PWD/src/ScipFrameParser.h \
+    $$PWD/src/ScipDecoder.h \
     $$PWD/src/Position.h \
     $$PWD/src/Angle.h \
     $$PWD/src/RingBuffer.h \
@@ -38,15 +56,26 @@ HEADERS += \
 SOURCES += \
     $$PWD/src/UrgUsbCom.cpp \
     $$PWD/src/UrgLogHandler.cpp \
+    $$PWD/src/UbhIndex.cpp \
+    $$PWD/src/UbhIndexer.cpp \
     $$PWD/src/UrgDevice.cpp \
+    $$PWD/src/ScanData.cpp \
+    $$PWD/src/ScanBufferPool.cpp \
+    $$PWD/src/ScanReactor.cpp \
     $$PWD/src/ScipHandler.cpp \
     $$PWD/src/isUsingComDriver.cpp \
     $$PWD/src/SerialDevice_win.cpp \
     $$PWD/src/SerialDevice_lin.cpp \
     $$PWD/src/SerialDevice.cpp \
+    $$PWD/src/CacheFile.cpp \
+    $$PWD/src/BaudrateCache.cpp \
+    $$PWD/src/CommandCache.cpp \
     $$PWD/src/log_printf.cpp \
     $$PWD/src/MathUtils.cpp \
     $$PWD/src/ConnectionUtils.cpp \
+    $$PWD/src/LineReader.cpp \
+    $$PWD/src/ScipFrameParser.cpp \
+    $$PWD/src/ScipDecoder.cpp \
     $$PWD/src/Angle.cpp \
     $$PWD/src/ticks.cpp \
     $$PWD/src/Thread.cpp \
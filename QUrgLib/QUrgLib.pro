@@ -14,11 +14,13 @@ TEMPLATE = app
 SOURCES += \
 #    test/main.cpp \
     test/TestUrgDevice.cpp \
-    test/CustomConnection.cpp
+    test/CustomConnection.cpp \
+    test/SimulatedSensor.cpp
 
 HEADERS += \
     test/TestUrgDevice.h \
-    test/CustomConnection.h
+    test/CustomConnection.h \
+    test/SimulatedSensor.h
 
 RESOURCES += \
     QUrgLib.qrc
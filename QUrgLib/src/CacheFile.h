@@ -0,0 +1,86 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_CACHE_FILE_H
+#define QRK_CACHE_FILE_H
+
+/*!
+  \file
+  \brief Ini file shared by the sensor caches
+*/
+
+#include <QMutex>
+#include <QSettings>
+#include <QString>
+
+
+namespace qrk
+{
+/*!
+  \brief Ini file shared by the sensor caches
+
+  Holds the file name and the lock of one cache. By default the file is
+  named after the cache and placed in the configuration directory of the
+  application, so that several applications linking QUrgLib do not share
+  it.
+*/
+class CacheFile
+{
+public:
+    explicit CacheFile(const QString &base_name);
+
+    //! Replace the default file, for tests; empty restores the default
+    void setFileName(const QString &file_name);
+    QString fileName(void);
+
+
+    /*!
+      \brief Settings of the cache, locked for the lifetime of the object
+    */
+    class Settings
+    {
+    public:
+        explicit Settings(CacheFile &file);
+
+        QSettings* operator->(void)
+        {
+            return &settings_;
+        }
+
+    private:
+        Settings(const Settings &rhs);
+        Settings &operator = (const Settings &rhs);
+
+        QMutexLocker locker_;
+        QSettings settings_;
+    };
+
+private:
+    CacheFile(const CacheFile &rhs);
+    CacheFile &operator = (const CacheFile &rhs);
+
+    QString path(void) const;
+
+    QMutex mutex_;
+    QString base_name_;
+    QString file_name_;
+};
+}
+
+#endif /* !QRK_CACHE_FILE_H */
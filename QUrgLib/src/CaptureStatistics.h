@@ -0,0 +1,254 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_CAPTURE_STATISTICS_H
+#define QRK_CAPTURE_STATISTICS_H
+
+/*!
+  \file
+  \brief Counters of the capture of a sensor
+*/
+
+#include <QAtomicInteger>
+#include <QtGlobal>
+
+
+namespace qrk
+{
+/*!
+  \brief Histogram of durations with power of two buckets
+
+  Bucket 0 counts durations below 1 [usec], bucket i those in
+  [2^(i-1), 2^i) [usec], and the last bucket everything above.
+*/
+struct CaptureHistogram
+{
+    enum {
+        Buckets = 24,
+    };
+
+    quint64 counts[Buckets];
+
+
+    CaptureHistogram(void) {
+        for (int i = 0; i < Buckets; ++i) {
+            counts[i] = 0;
+        }
+    }
+
+
+    static int bucket(qint64 usec) {
+        int i = 0;
+        while ((usec > 0) && (i < Buckets - 1)) {
+            usec >>= 1;
+            ++i;
+        }
+        return i;
+    }
+
+
+    //! Upper bound of \p bucket [usec], -1 for the open last bucket
+    static qint64 upperBound(int bucket) {
+        return (bucket < Buckets - 1) ? (Q_INT64_C(1) << bucket) : -1;
+    }
+
+
+    quint64 total(void) const {
+        quint64 n = 0;
+        for (int i = 0; i < Buckets; ++i) {
+            n += counts[i];
+        }
+        return n;
+    }
+
+
+    /*!
+      \brief Upper bound of the bucket holding the \p ratio quantile [usec]
+
+      The lower bound is returned when the quantile is in the last bucket.
+    */
+    qint64 percentile(double ratio) const {
+        quint64 n = total();
+        if (n == 0) {
+            return 0;
+        }
+        quint64 rank = static_cast<quint64>(ratio * (n - 1));
+        quint64 seen = 0;
+        for (int i = 0; i < Buckets - 1; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return upperBound(i);
+            }
+        }
+        return upperBound(Buckets - 2);
+    }
+};
+
+
+//! Counters of the capture of a sensor since it was connected
+struct CaptureStatistics
+{
+    quint64 frames;             //!< Scans received
+    quint64 dropped_frames;     //!< Scans discarded because the queue was full
+    quint64 checksum_errors;    //!< Frames or responses failing their checksum
+    quint64 echoback_mismatches;//!< Responses not matching the sent command
+    quint64 timeouts;           //!< Captures and commands with no response
+    quint64 bytes_received;
+    quint64 bytes_sent;
+    quint32 queue_depth;        //!< Scans waiting in the asynchronous queue
+    quint32 max_queue_depth;
+    CaptureHistogram parse_time;        //!< Decoding of a scan [usec]
+    CaptureHistogram receive_latency;   //!< From the first line of a scan to its end [usec]
+
+
+    CaptureStatistics(void)
+        : frames(0), dropped_frames(0), checksum_errors(0),
+          echoback_mismatches(0), timeouts(0), bytes_received(0),
+          bytes_sent(0), queue_depth(0), max_queue_depth(0) {
+    }
+};
+
+
+/*!
+  \brief Lock-free counters behind CaptureStatistics
+
+  Each counter is updated by the capture thread and may be read by any
+  thread at any time. Counters are independent, so a snapshot taken
+  while a scan is received may be one scan apart between counters.
+*/
+class CaptureCounters
+{
+public:
+    CaptureCounters(void) {
+    }
+
+
+    void addFrame(void) {
+        frames_.fetchAndAddRelaxed(1);
+    }
+
+
+    void addDroppedFrame(void) {
+        dropped_frames_.fetchAndAddRelaxed(1);
+    }
+
+
+    void addChecksumError(void) {
+        checksum_errors_.fetchAndAddRelaxed(1);
+    }
+
+
+    void addEchobackMismatch(int count = 1) {
+        echoback_mismatches_.fetchAndAddRelaxed(count);
+    }
+
+
+    void addTimeout(void) {
+        timeouts_.fetchAndAddRelaxed(1);
+    }
+
+
+    void addBytesSent(int size) {
+        if (size > 0) {
+            bytes_sent_.fetchAndAddRelaxed(size);
+        }
+    }
+
+
+    void addParseTime(qint64 usec) {
+        parse_time_[CaptureHistogram::bucket(usec)].fetchAndAddRelaxed(1);
+    }
+
+
+    void addReceiveLatency(qint64 usec) {
+        receive_latency_[CaptureHistogram::bucket(usec)].fetchAndAddRelaxed(1);
+    }
+
+
+    void queueIn(void) {
+        quint32 depth = queue_depth_.fetchAndAddRelaxed(1) + 1;
+        quint32 max = max_queue_depth_.load();
+        while ((depth > max) &&
+               ! max_queue_depth_.testAndSetRelaxed(max, depth, max)) {
+        }
+    }
+
+
+    void queueOut(void) {
+        queue_depth_.fetchAndSubRelaxed(1);
+    }
+
+
+    void clearQueue(void) {
+        queue_depth_.store(0);
+    }
+
+
+    //! Bytes received are counted by the line reader
+    CaptureStatistics snapshot(void) const {
+        CaptureStatistics statistics;
+        statistics.frames = frames_.load();
+        statistics.dropped_frames = dropped_frames_.load();
+        statistics.checksum_errors = checksum_errors_.load();
+        statistics.echoback_mismatches = echoback_mismatches_.load();
+        statistics.timeouts = timeouts_.load();
+        statistics.bytes_sent = bytes_sent_.load();
+        statistics.queue_depth = queue_depth_.load();
+        statistics.max_queue_depth = max_queue_depth_.load();
+        for (int i = 0; i < CaptureHistogram::Buckets; ++i) {
+            statistics.parse_time.counts[i] = parse_time_[i].load();
+            statistics.receive_latency.counts[i] = receive_latency_[i].load();
+        }
+        return statistics;
+    }
+
+
+    void reset(void) {
+        frames_.store(0);
+        dropped_frames_.store(0);
+        checksum_errors_.store(0);
+        echoback_mismatches_.store(0);
+        timeouts_.store(0);
+        bytes_sent_.store(0);
+        queue_depth_.store(0);
+        max_queue_depth_.store(0);
+        for (int i = 0; i < CaptureHistogram::Buckets; ++i) {
+            parse_time_[i].store(0);
+            receive_latency_[i].store(0);
+        }
+    }
+
+private:
+    CaptureCounters(const CaptureCounters &rhs);
+    CaptureCounters &operator = (const CaptureCounters &rhs);
+
+    QAtomicInteger<quint64> frames_;
+    QAtomicInteger<quint64> dropped_frames_;
+    QAtomicInteger<quint64> checksum_errors_;
+    QAtomicInteger<quint64> echoback_mismatches_;
+    QAtomicInteger<quint64> timeouts_;
+    QAtomicInteger<quint64> bytes_sent_;
+    QAtomicInteger<quint32> queue_depth_;
+    QAtomicInteger<quint32> max_queue_depth_;
+    QAtomicInteger<quint64> parse_time_[CaptureHistogram::Buckets];
+    QAtomicInteger<quint64> receive_latency_[CaptureHistogram::Buckets];
+};
+}
+
+#endif /* !QRK_CAPTURE_STATISTICS_H */
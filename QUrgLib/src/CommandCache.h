@@ -0,0 +1,65 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_COMMAND_CACHE_H
+#define QRK_COMMAND_CACHE_H
+
+/*!
+  \file
+  \brief Commands and capture modes supported by a sensor model
+*/
+
+#include <QString>
+#include <QStringList>
+
+
+namespace qrk
+{
+/*!
+  \brief Commands and capture modes supported by a sensor model
+
+  Probing which commands a sensor answers takes thousands of round
+  trips, while the answer only depends on the model and the firmware.
+  Results are kept per product and firmware string in an ini file of the
+  application configuration directory, under a key such as "commands" or
+  "modes".
+*/
+class CommandCache
+{
+public:
+    //! Cached list of a model and firmware, empty when unknown
+    static QStringList lookup(const QString &product, const QString &firmware,
+                              const QString &key);
+
+    static void store(const QString &product, const QString &firmware,
+                      const QString &key, const QStringList &values);
+
+    static void remove(const QString &product, const QString &firmware);
+
+
+    //! Ini file holding the cache, for tests
+    static void setFileName(const QString &file_name);
+    static QString fileName(void);
+
+private:
+    CommandCache(void);
+};
+}
+
+#endif /* !QRK_COMMAND_CACHE_H */
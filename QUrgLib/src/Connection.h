@@ -79,6 +79,11 @@ public:
 
     virtual ConnectionType connectionType() = 0;
 
+    //! File descriptor to wait on for received data, -1 when not available
+    virtual int nativeHandle(void) const {
+        return -1;
+    }
+
     bool startRecording(const QString &locationPart = QCoreApplication::applicationFilePath(),
                         const QString &sendFilePart = "SendFile",
                         const QString &receiveFilePart = "ReceiveFile");
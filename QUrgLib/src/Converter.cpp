@@ -19,6 +19,7 @@
 */
 
 #include "Converter.h"
+#include "ScanData.h"
 #include <QDebug>
 #include <QLineF>
 #include <cmath>
@@ -173,6 +174,33 @@ QVector<QVector<QPointF> > Converter::getPoints(const QVector<QVector<long> > &s
 
     return points;
 }
+
+QVector<QVector<QPointF> > Converter::getPoints(const ScanData &scan
+                                                , const QPointF &offset
+                                                , qreal rotation
+                                                , int max_length) const
+{
+    int steps = scan.steps();
+    QVector<QVector<QPointF> > points(steps);
+
+    for (int i = 0; i < steps; ++i) {
+        int first = scan.echoOffsets[i];
+        int echoes = scan.echoes(i);
+        int step = index2Step(i);
+
+        QVector<QPointF> &point = points[i];
+        point.reserve(echoes);
+        for (int j = 0; j < echoes; ++j) {
+            point << range2point(step
+                                 , scan.ranges[first + j]
+                                 , rotation
+                                 , offset
+                                 , max_length);
+        }
+    }
+
+    return points;
+}
 int Converter::index2Step(int index) const
 {
     return m_firstStep + (index * m_grouping);
@@ -22,6 +22,9 @@
 #define CONVERTER_H
 
 #include <QPointF>
+#include <QVector>
+
+class ScanData;
 
 class Converter
 {
@@ -78,6 +81,10 @@ public:
                                          , const QPointF &offset = QPointF(0, 0)
                                          , qreal rotation = 0
                                          , int max_length = -1) const;
+    QVector<QVector<QPointF> > getPoints(const ScanData &scan
+                                         , const QPointF &offset = QPointF(0, 0)
+                                         , qreal rotation = 0
+                                         , int max_length = -1) const;
 
 private:
     int m_frontStep;
@@ -0,0 +1,278 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "LineReader.h"
+#include "ConnectionUtils.h"
+#include "Connection.h"
+#include <cstring>
+
+using namespace qrk;
+using namespace std;
+
+
+namespace
+{
+enum {
+    MinimumBufferSize = 64,
+};
+}
+
+
+LineReader::LineReader(Connection* con, size_t buffer_size)
+    : con_(con),
+      buffer_(qMax(buffer_size, static_cast<size_t>(MinimumBufferSize)) + 1),
+      first_(0), last_(0), scanned_(0),
+      held_index_(NoHeldChar), held_ch_('\0')
+{
+}
+
+
+LineReader::~LineReader(void)
+{
+}
+
+
+void LineReader::setConnection(Connection* con)
+{
+    con_ = con;
+    reset();
+}
+
+
+Connection* LineReader::connection(void) const
+{
+    return con_;
+}
+
+
+int LineReader::readline(const char** line, int timeout)
+{
+    return readView(line, capacity() - 1, timeout);
+}
+
+
+int LineReader::readline(char* buf, const size_t count, int timeout)
+{
+    if (count == 0) {
+        return -1;
+    }
+
+    const char* line = NULL;
+    int n = readView(&line, count - 1, timeout);
+    if (n < 0) {
+        buf[0] = '\0';
+        return n;
+    }
+    memcpy(buf, line, n);
+    buf[n] = '\0';
+    return n;
+}
+
+
+int LineReader::receive(char* data, size_t count, int timeout)
+{
+    restoreHeldChar();
+
+    size_t n = qMin(count, last_ - first_);
+    if (n > 0) {
+        memcpy(data, &buffer_[first_], n);
+        first_ += n;
+        scanned_ = qMax(scanned_, first_);
+    }
+    if (n == count) {
+        return static_cast<int>(n);
+    }
+
+    if (! con_) {
+        return (n > 0) ? static_cast<int>(n) : -1;
+    }
+    int received = con_->receive(&data[n], count - n, timeout);
+    if (received <= 0) {
+        return (n > 0) ? static_cast<int>(n) : received;
+    }
+    received_.fetchAndAddRelaxed(received);
+    return static_cast<int>(n) + received;
+}
+
+
+quint64 LineReader::receivedBytes(void) const
+{
+    return received_.load();
+}
+
+
+void LineReader::resetReceivedBytes(void)
+{
+    received_.store(0);
+}
+
+
+size_t LineReader::buffered(void) const
+{
+    return last_ - first_;
+}
+
+
+size_t LineReader::skip(int total_timeout, int each_timeout)
+{
+    if (each_timeout <= 0) {
+        each_timeout = total_timeout;
+    }
+
+    size_t skipped = 0;
+    const char* line = NULL;
+    int n;
+    while ((n = readline(&line, each_timeout)) > 0) {
+        skipped += n + 1;
+    }
+    return skipped;
+}
+
+
+void LineReader::clear(void)
+{
+    reset();
+    if (con_) {
+        con_->clear();
+    }
+}
+
+
+void LineReader::reset(void)
+{
+    first_ = 0;
+    last_ = 0;
+    scanned_ = 0;
+    held_index_ = NoHeldChar;
+}
+
+
+size_t LineReader::capacity(void) const
+{
+    return buffer_.size() - 1;
+}
+
+
+void LineReader::restoreHeldChar(void)
+{
+    if (held_index_ != NoHeldChar) {
+        buffer_[held_index_] = held_ch_;
+        held_index_ = NoHeldChar;
+    }
+}
+
+
+int LineReader::readView(const char** line, size_t max_length, int timeout)
+{
+    restoreHeldChar();
+    max_length = qMin(max_length, capacity() - 1);
+
+    while (1) {
+        // 既に受信済みのデータから改行を探す
+        size_t limit = qMin(last_, first_ + max_length);
+        for (size_t i = scanned_; i < limit; ++i) {
+            if (isLF(buffer_[i])) {
+                buffer_[i] = '\0';
+                *line = &buffer_[first_];
+                int n = static_cast<int>(i - first_);
+                first_ = i + 1;
+                scanned_ = first_;
+                return n;
+            }
+        }
+        scanned_ = limit;
+
+        if ((last_ - first_) >= max_length) {
+            // 行がバッファに収まらないので、途中で区切って返す
+            return takeLine(line, first_ + max_length);
+        }
+
+        if (! fill(timeout)) {
+            if (last_ == first_) {
+                *line = &buffer_[first_];
+                buffer_[first_] = '\0';
+                return -1;
+            }
+            return takeLine(line, last_);
+        }
+    }
+}
+
+
+int LineReader::takeLine(const char** line, size_t end)
+{
+    if (end < last_) {
+        held_index_ = end;
+        held_ch_ = buffer_[end];
+    }
+    buffer_[end] = '\0';
+    *line = &buffer_[first_];
+
+    int n = static_cast<int>(end - first_);
+    first_ = end;
+    scanned_ = end;
+    return n;
+}
+
+
+bool LineReader::fill(int timeout)
+{
+    if (! con_) {
+        return false;
+    }
+
+    if (first_ == last_) {
+        first_ = last_ = scanned_ = 0;
+    }
+    else if ((first_ > 0) && (last_ == capacity())) {
+        memmove(&buffer_[0], &buffer_[first_], last_ - first_);
+        last_ -= first_;
+        scanned_ -= first_;
+        first_ = 0;
+    }
+
+    size_t space = capacity() - last_;
+    if (space == 0) {
+        return false;
+    }
+
+    // 受信済みのデータがなければ、最初の 1 byte だけをタイムアウト付きで待つ
+    size_t available = con_->size();
+    if (available == 0) {
+        int n = con_->receive(&buffer_[last_], 1, timeout);
+        if (n <= 0) {
+            return false;
+        }
+        last_ += n;
+        received_.fetchAndAddRelaxed(n);
+        --space;
+        available = con_->size();
+    }
+
+    // 残りは届いている分をまとめて取り出す
+    if ((available > 0) && (space > 0)) {
+        int n = con_->receive(&buffer_[last_], qMin(available, space), timeout);
+        if (n > 0) {
+            last_ += n;
+            received_.fetchAndAddRelaxed(n);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,147 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef QRK_LINE_READER_H
+#define QRK_LINE_READER_H
+
+/*!
+  \file
+  \brief Buffered line reader on top of Connection
+*/
+
+#include <QAtomicInteger>
+#include <cstddef>
+#include <vector>
+
+
+namespace qrk
+{
+class Connection;
+
+
+/*!
+  \brief Buffered line reader
+
+  Pulls whole chunks from the connection instead of one byte per
+  Connection::receive() call and returns lines as views into its own
+  buffer.
+
+  Bytes pulled from the connection but not yet consumed stay in the
+  reader, so every read on a connection shared with a LineReader must go
+  through receive(), skip() and clear() of the reader.
+*/
+class LineReader
+{
+public:
+    enum {
+        DefaultBufferSize = 8192,
+    };
+
+    explicit LineReader(Connection* con = NULL,
+                        size_t buffer_size = DefaultBufferSize);
+    ~LineReader(void);
+
+    void setConnection(Connection* con);
+    Connection* connection(void) const;
+
+
+    /*!
+      \brief Read one line without copying
+
+      The line terminator is replaced by \\0. The returned pointer stays
+      valid until the next call on the reader. Lines longer than the
+      buffer are returned in several pieces.
+
+      \param[out] line Pointer to the line in the internal buffer
+      \param[in] timeout Timeout to wait for each chunk [msec]
+
+      \return Line length (-1 if nothing was received before the timeout)
+    */
+    int readline(const char** line, int timeout);
+
+
+    /*!
+      \brief Read one line into a caller buffer
+
+      Same contract as qrk::readline().
+    */
+    int readline(char* buf, size_t count, int timeout);
+
+
+    /*!
+      \brief Receive raw bytes, buffered ones first
+    */
+    int receive(char* data, size_t count, int timeout);
+
+
+    //! Number of bytes buffered in the reader
+    size_t buffered(void) const;
+
+
+    /*!
+      \brief Discard lines until the connection stays silent
+
+      \return Number of bytes discarded, line terminators included
+
+      \see qrk::skip()
+    */
+    size_t skip(int total_timeout, int each_timeout = 0);
+
+
+    //! Drop buffered bytes and clear the connection
+    void clear(void);
+
+
+    //! Drop buffered bytes only
+    void reset(void);
+
+
+    /*!
+      \brief Bytes received from the connection
+
+      May be read from any thread while another one reads lines.
+    */
+    quint64 receivedBytes(void) const;
+    void resetReceivedBytes(void);
+
+private:
+    LineReader(const LineReader &rhs);
+    LineReader &operator = (const LineReader &rhs);
+
+    static const size_t NoHeldChar = static_cast<size_t>(-1);
+
+    size_t capacity(void) const;
+    void restoreHeldChar(void);
+    int readView(const char** line, size_t max_length, int timeout);
+    int takeLine(const char** line, size_t end);
+    bool fill(int timeout);
+
+    Connection* con_;
+    std::vector<char> buffer_;
+    size_t first_;              //!< First byte not yet consumed
+    size_t last_;               //!< End of received bytes
+    size_t scanned_;            //!< Bytes already searched for a line end
+    size_t held_index_;         //!< Byte overwritten by a truncated line end
+    char held_ch_;
+    QAtomicInteger<quint64> received_;
+};
+}
+
+#endif /* !QRK_LINE_READER_H */
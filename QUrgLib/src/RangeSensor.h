@@ -34,6 +34,7 @@
 #include "RangeSensorInformation.h"
 #include "RangeSensorInternalInformation.h"
 #include "RangeSensorParameter.h"
+#include "CaptureStatistics.h"
 
 #include "RangeCaptureMode.h"
 #include <qmath.h>
@@ -42,6 +43,8 @@
 #include <QMap>
 #include "Converter.h"
 
+class QMutex;
+
 typedef struct {
     QVector<QVector<long > > steps;
     Converter converter;
@@ -346,6 +349,22 @@ public:
     virtual bool changeBaurate(long baud) = 0;
 
     virtual Converter getConverter() = 0;
+
+    //! Counters of the capture, readable while another thread captures
+    virtual CaptureStatistics captureStatistics(void) const {
+        return CaptureStatistics();
+    }
+
+    /*!
+      \brief Lock held around every command exchanged with the sensor
+
+      Recursive: hold it across several queries to keep a check of
+      isWorking() valid while they are sent. NULL when the sensor does not
+      serialize its commands; QMutexLocker accepts it either way.
+    */
+    virtual QMutex* commandMutex(void) const {
+        return NULL;
+    }
 };
 }
 
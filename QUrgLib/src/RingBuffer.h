@@ -17,7 +17,6 @@
 	Please contact kristou@hokuyo-aut.jp for more details.
 
 */
-
 #ifndef QRK_RING_BUFFER_H
 #define QRK_RING_BUFFER_H
 
@@ -30,17 +29,53 @@
   $Id: RingBuffer.h 131 2012-09-11 06:23:04Z kristou $
 */
 
-#include <deque>
-#include <QMutex>
+#include <QAtomicInt>
+#include <QtGlobal>
+#include <algorithm>
+#include <vector>
 
 namespace qrk
 {
-//! リングバッファ
+/*!
+  \brief リングバッファ
+
+  容量固定、ロックなしのリングバッファ。書き込み (put(), writeSpan(),
+  commit()) は 1 つのスレッドから、読み出し (get(), peek(), readSpan(),
+  consume(), ungetc(), clear()) は別の 1 つのスレッドから行う。
+
+  読み書き位置は単調に増加する 32 bit の値で、バッファの添字はその下位
+  ビットから求める。
+*/
 template <class T>
 class RingBuffer
 {
 public:
-    explicit RingBuffer(void) {
+    enum {
+        DefaultCapacity = 65536,
+    };
+
+
+    /*!
+      \brief コンストラクタ
+
+      \param[in] capacity 領域の大きさ。2 のべき乗に切り上げられ、格納できるのは 1 つ少ない個数
+    */
+    explicit RingBuffer(size_t capacity = DefaultCapacity)
+        : head_(0), unget_floor_(0), tail_(0) {
+        size_t allocated = 2;
+        while (allocated < capacity) {
+            allocated <<= 1;
+        }
+        buffer_.resize(allocated);
+        mask_ = static_cast<quint32>(allocated - 1);
+    }
+
+
+    /*!
+      \brief 格納できるデータの最大個数
+    */
+    size_t capacity(void) const {
+        return mask_;
     }
 
 
@@ -48,7 +83,9 @@ public:
       \brief バッファサイズの取得
     */
     size_t size(void) const {
-        return ring_buffer_.size();
+        quint32 tail = tail_.loadAcquire();
+        quint32 head = head_.loadAcquire();
+        return tail - head;
     }
 
 
@@ -58,21 +95,97 @@ public:
       \retval true データなし
       \retval false データあり
     */
-    bool empty(void) {
-        return ring_buffer_.empty();
+    bool empty(void) const {
+        return size() == 0;
     }
 
 
     /*!
       \brief データの格納
 
+      空き領域に収まらないデータは格納しない。戻り値が size より小さいときは、
+      読み出しを待つか、reserve() で容量を広げてから残りを格納する。
+
       \param[in] data データ
       \param[in] size データ個数
+
+      \return 格納したデータ個数
+    */
+    size_t put(const T* data, size_t size) {
+        size_t filled = 0;
+        while (filled < size) {
+            T* span;
+            size_t n = qMin(writeSpan(&span), size - filled);
+            if (n == 0) {
+                break;
+            }
+            std::copy(data + filled, data + filled + n, span);
+            commit(n);
+            filled += n;
+        }
+        return filled;
+    }
+
+
+    /*!
+      \brief 容量を広げる
+
+      格納済みのデータは残す。読み書きどちらのスレッドも動いていないときに呼ぶ。
+
+      \param[in] capacity 格納したいデータの個数
+    */
+    void reserve(size_t capacity) {
+        if (capacity <= this->capacity()) {
+            return;
+        }
+
+        size_t allocated = buffer_.size();
+        while ((allocated - 1) < capacity) {
+            allocated <<= 1;
+        }
+        std::vector<T> larger(allocated);
+        size_t n = peek(&larger[0], size());
+        bool can_unget = (static_cast<quint32>(head_.loadAcquire()) == unget_floor_);
+
+        buffer_.swap(larger);
+        mask_ = static_cast<quint32>(allocated - 1);
+        head_.storeRelease(0);
+        tail_.storeRelease(static_cast<int>(n));
+        unget_floor_ = can_unget ? 0 : 1;
+    }
+
+
+    /*!
+      \brief 連続した書き込み領域の取得
+
+      書き込んだ個数を commit() で確定させる。
+
+      \param[out] data 書き込み領域の先頭
+
+      \return 書き込める個数
     */
-    void put(const T* data, size_t size) {
-        QMutexLocker locker(&mutex);
-        const T* last_p = data + size;
-        ring_buffer_.insert(ring_buffer_.end(), data, last_p);
+    size_t writeSpan(T** data) {
+        quint32 tail = tail_.loadAcquire();
+        quint32 head = head_.loadAcquire();
+
+        // ungetc() 用に 1 つ空けておく
+        quint32 used = tail - head;
+        size_t free_size = (used < mask_) ? (mask_ - used) : 0;
+        size_t index = tail & mask_;
+        *data = &buffer_[index];
+        return qMin(free_size, buffer_.size() - index);
+    }
+
+
+    /*!
+      \brief writeSpan() に書き込んだデータの確定
+
+      \param[in] size 書き込んだ個数
+    */
+    void commit(size_t size) {
+        quint32 tail = static_cast<quint32>(tail_.loadAcquire()) +
+                static_cast<quint32>(size);
+        tail_.storeRelease(static_cast<int>(tail));
     }
 
 
@@ -85,21 +198,83 @@ public:
       \return 取り出したデータ個数
     */
     size_t get(T* data, size_t size) {
-        QMutexLocker locker(&mutex);
-        size_t n = qMin(size, ring_buffer_.size());
-        std::copy(ring_buffer_.begin(), ring_buffer_.begin() + n, data);
-        ring_buffer_.erase(ring_buffer_.begin(), ring_buffer_.begin() + n);
+        size_t n = peek(data, size);
+        consume(n);
         return n;
     }
 
 
+    /*!
+      \brief データを取り出さずに読み出す
+
+      \param[out] data データ読み出し用バッファ
+      \param[in] size 読み出すデータの最大個数
+
+      \return 読み出したデータ個数
+    */
+    size_t peek(T* data, size_t size) const {
+        quint32 head = head_.loadAcquire();
+        size_t n = qMin(size, this->size());
+        size_t index = head & mask_;
+        size_t first = qMin(n, buffer_.size() - index);
+        std::copy(buffer_.begin() + index, buffer_.begin() + index + first, data);
+        std::copy(buffer_.begin(), buffer_.begin() + (n - first), data + first);
+        return n;
+    }
+
+
+    /*!
+      \brief 連続した読み出し領域の取得
+
+      読み終えた個数を consume() で取り除く。
+
+      \param[out] data 読み出し領域の先頭
+
+      \return 読み出せる個数
+    */
+    size_t readSpan(const T** data) const {
+        quint32 head = head_.loadAcquire();
+        size_t index = head & mask_;
+        *data = &buffer_[index];
+        return qMin(size(), buffer_.size() - index);
+    }
+
+
+    /*!
+      \brief 先頭のデータを取り除く
+
+      \param[in] size 取り除く個数
+    */
+    void consume(size_t size) {
+        if (size == 0) {
+            return;
+        }
+        quint32 head = static_cast<quint32>(head_.loadAcquire()) +
+                static_cast<quint32>(size);
+        head_.storeRelease(static_cast<int>(head));
+        unget_floor_ = head;
+    }
+
+
     /*!
       \brief データの書き戻し
 
+      直前に取り出したデータの位置に書き戻す。続けて書き戻せるのは 1 個まで。
+
       \param[in] ch 書き戻すデータ
+
+      \retval true 書き戻した
+      \retval false 書き戻せなかった
     */
-    void ungetc(const T ch) {
-        ring_buffer_.push_front(ch);
+    bool ungetc(const T ch) {
+        quint32 head = head_.loadAcquire();
+        if (head != unget_floor_) {
+            return false;
+        }
+        --head;
+        buffer_[head & mask_] = ch;
+        head_.storeRelease(static_cast<int>(head));
+        return true;
     }
 
 
@@ -107,7 +282,7 @@ public:
       \brief 格納データのクリア
     */
     void clear(void) {
-        ring_buffer_.clear();
+        consume(size());
     }
 
 
@@ -115,10 +290,21 @@ private:
     RingBuffer(const RingBuffer &rhs);
     RingBuffer &operator = (const RingBuffer &rhs);
 
-    std::deque<T> ring_buffer_;
-    QMutex mutex;
+    enum {
+        CacheLineSize = 64,
+    };
+
+    std::vector<T> buffer_;
+    quint32 mask_;
+
+    // 読み出し側と書き込み側の位置は、別のキャッシュラインに置く
+    char head_padding_[CacheLineSize];
+    QAtomicInt head_;           //!< 読み出し位置、読み出し側のみが更新する
+    quint32 unget_floor_;       //!< 最後に取り除いた後の読み出し位置
+    char tail_padding_[CacheLineSize];
+    QAtomicInt tail_;           //!< 書き込み位置、書き込み側のみが更新する
+    char end_padding_[CacheLineSize];
 };
 }
 
 #endif /* !QRK_RING_BUFFER_H */
-
@@ -0,0 +1,108 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "ScanBufferPool.h"
+
+using namespace qrk;
+
+
+ScanBufferPool::ScanBufferPool(size_t max_pooled)
+    : max_pooled_(max_pooled), steps_(0), echoes_per_step_(1)
+{
+}
+
+
+ScanBufferPool::~ScanBufferPool(void)
+{
+    qDeleteAll(free_);
+}
+
+
+void ScanBufferPool::setCapacity(int steps, int echoes_per_step)
+{
+    QMutexLocker locker(&mutex_);
+    steps_ = steps;
+    echoes_per_step_ = echoes_per_step;
+}
+
+
+ScanData* ScanBufferPool::acquire(void)
+{
+    QMutexLocker locker(&mutex_);
+
+    ScanData* scan = NULL;
+    if (! free_.isEmpty()) {
+        scan = free_.last();
+        free_.pop_back();
+        ++statistics_.hits;
+    }
+    else {
+        scan = new ScanData;
+        ++statistics_.misses;
+    }
+
+    // Does nothing once the buffer is large enough
+    scan->reserve(steps_, echoes_per_step_);
+
+    ++statistics_.leased;
+    statistics_.high_water = qMax(statistics_.high_water, statistics_.leased);
+    statistics_.pooled = free_.size();
+
+    return scan;
+}
+
+
+void ScanBufferPool::release(ScanData* scan)
+{
+    if (! scan) {
+        return;
+    }
+    scan->clear();
+
+    QMutexLocker locker(&mutex_);
+    if (statistics_.leased > 0) {
+        --statistics_.leased;
+    }
+
+    if (static_cast<size_t>(free_.size()) < max_pooled_) {
+        free_.push_back(scan);
+        scan = NULL;
+    }
+    statistics_.pooled = free_.size();
+    locker.unlock();
+
+    delete scan;
+}
+
+
+ScanBufferPool::Statistics ScanBufferPool::statistics(void) const
+{
+    QMutexLocker locker(&mutex_);
+    return statistics_;
+}
+
+
+void ScanBufferPool::resetStatistics(void)
+{
+    QMutexLocker locker(&mutex_);
+    statistics_.hits = 0;
+    statistics_.misses = 0;
+    statistics_.high_water = statistics_.leased;
+}
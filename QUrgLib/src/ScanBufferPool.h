@@ -0,0 +1,106 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef QRK_SCAN_BUFFER_POOL_H
+#define QRK_SCAN_BUFFER_POOL_H
+
+/*!
+  \file
+  \brief Recycling pool of scan buffers
+*/
+
+#include "ScanData.h"
+#include <QMutex>
+#include <QVector>
+
+
+namespace qrk
+{
+/*!
+  \brief Recycling pool of scan buffers
+
+  Leases ScanData buffers reserved for a whole scan, and takes them back
+  once the consumer is done, so that continuous capture does not go
+  through the heap at scan rate. acquire() and release() can be called
+  from different threads.
+*/
+class ScanBufferPool
+{
+public:
+    enum {
+        DefaultMaxPooled = 8,
+    };
+
+    //! Pool usage counters
+    class Statistics
+    {
+    public:
+        size_t hits;            //!< acquire() served by a pooled buffer
+        size_t misses;          //!< acquire() that had to allocate
+        size_t leased;          //!< Buffers currently leased
+        size_t high_water;      //!< Highest number of buffers leased at once
+        size_t pooled;          //!< Buffers waiting in the pool
+
+        Statistics(void)
+            : hits(0), misses(0), leased(0), high_water(0), pooled(0) {
+        }
+    };
+
+
+    /*!
+      \param[in] max_pooled Buffers kept for reuse, extra released buffers are freed
+    */
+    explicit ScanBufferPool(size_t max_pooled = DefaultMaxPooled);
+    ~ScanBufferPool(void);
+
+
+    /*!
+      \brief Capacity reserved in every leased buffer
+
+      \param[in] steps Number of steps, area_max + 1 for a full scan
+      \param[in] echoes_per_step Echoes reserved per step
+    */
+    void setCapacity(int steps, int echoes_per_step = 1);
+
+
+    //! Lease an empty buffer, never NULL
+    ScanData* acquire(void);
+
+    //! Give a leased buffer back
+    void release(ScanData* scan);
+
+
+    Statistics statistics(void) const;
+    void resetStatistics(void);
+
+private:
+    ScanBufferPool(const ScanBufferPool &rhs);
+    ScanBufferPool &operator = (const ScanBufferPool &rhs);
+
+    mutable QMutex mutex_;
+    QVector<ScanData*> free_;
+    size_t max_pooled_;
+    int steps_;
+    int echoes_per_step_;
+    Statistics statistics_;
+};
+}
+
+#endif /* !QRK_SCAN_BUFFER_POOL_H */
@@ -0,0 +1,167 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "ScanData.h"
+
+
+ScanData::ScanData(void)
+    : timestamp(0)
+{
+}
+
+
+void ScanData::clear(void)
+{
+    // resize() keeps the capacity, unlike clear() on older Qt
+    ranges.resize(0);
+    levels.resize(0);
+    echoOffsets.resize(0);
+}
+
+
+void ScanData::reserve(int steps, int echoes_per_step)
+{
+    echoOffsets.reserve(steps);
+    ranges.reserve(steps * echoes_per_step);
+    levels.reserve(steps * echoes_per_step);
+}
+
+
+int ScanData::steps(void) const
+{
+    return echoOffsets.size();
+}
+
+
+bool ScanData::isEmpty(void) const
+{
+    return echoOffsets.isEmpty();
+}
+
+
+int ScanData::echoes(int step) const
+{
+    int last = (step + 1 < echoOffsets.size()) ? echoOffsets[step + 1] : ranges.size();
+    return last - echoOffsets[step];
+}
+
+
+bool ScanData::hasLevels(void) const
+{
+    return ! levels.isEmpty();
+}
+
+
+quint32 ScanData::range(int step, int echo) const
+{
+    return ranges[echoOffsets[step] + echo];
+}
+
+
+quint32 ScanData::level(int step, int echo) const
+{
+    return hasLevels() ? levels[echoOffsets[step] + echo] : 0;
+}
+
+
+void ScanData::addStep(void)
+{
+    echoOffsets.append(ranges.size());
+}
+
+
+void ScanData::addEcho(quint32 range)
+{
+    ranges.append(range);
+}
+
+
+void ScanData::addEcho(quint32 range, quint32 level)
+{
+    ranges.append(range);
+    levels.append(level);
+}
+
+
+void ScanData::copyTo(QVector<QVector<long> > &range_steps,
+                      QVector<QVector<long> > &level_steps) const
+{
+    int n = steps();
+    bool has_levels = hasLevels();
+
+    range_steps.resize(n);
+    level_steps.resize(has_levels ? n : 0);
+
+    for (int i = 0; i < n; ++i) {
+        int first = echoOffsets[i];
+        int echo_count = echoes(i);
+
+        QVector<long> &step_ranges = range_steps[i];
+        step_ranges.resize(echo_count);
+        for (int j = 0; j < echo_count; ++j) {
+            step_ranges[j] = ranges[first + j];
+        }
+
+        if (has_levels) {
+            QVector<long> &step_levels = level_steps[i];
+            step_levels.resize(echo_count);
+            for (int j = 0; j < echo_count; ++j) {
+                step_levels[j] = levels[first + j];
+            }
+        }
+    }
+}
+
+
+void ScanData::fromSensorDataArray(const SensorDataArray &range_data,
+                                   const SensorDataArray &level_data)
+{
+    clear();
+    converter = range_data.converter;
+    timestamp = range_data.timestamp;
+
+    bool has_levels = ! level_data.steps.isEmpty();
+    for (int i = 0; i < range_data.steps.size(); ++i) {
+        const QVector<long> &step_ranges = range_data.steps[i];
+        addStep();
+        for (int j = 0; j < step_ranges.size(); ++j) {
+            if (has_levels) {
+                bool exists = (i < level_data.steps.size()) &&
+                        (j < level_data.steps[i].size());
+                addEcho(step_ranges[j], exists ? level_data.steps[i][j] : 0);
+            }
+            else {
+                addEcho(step_ranges[j]);
+            }
+        }
+    }
+}
+
+
+void ScanData::toSensorDataArray(SensorDataArray &range_data,
+                                 SensorDataArray &level_data) const
+{
+    copyTo(range_data.steps, level_data.steps);
+
+    range_data.converter = converter;
+    range_data.timestamp = timestamp;
+    level_data.converter = converter;
+    level_data.timestamp = timestamp;
+}
@@ -0,0 +1,99 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef SCAN_DATA_H
+#define SCAN_DATA_H
+
+/*!
+  \file
+  \brief Scan data stored in flat arrays
+*/
+
+#include "RangeSensor.h"
+#include <QVector>
+
+
+/*!
+  \brief Scan data stored in flat arrays
+
+  The echoes of every step are stored one after the other in #ranges,
+  and in #levels when intensity is captured. #echoOffsets holds, for
+  each step, the index in #ranges of its first echo. A scan then costs
+  three allocations whatever its number of steps and echoes, and
+  clear() keeps them for the next scan.
+
+  \code
+  for (int step = 0; step < scan.steps(); ++step) {
+      for (int echo = 0; echo < scan.echoes(step); ++echo) {
+          quint32 range = scan.range(step, echo);
+      }
+  } \endcode
+*/
+class ScanData
+{
+public:
+    QVector<quint32> ranges;        //!< Range of each echo [mm]
+    QVector<quint32> levels;        //!< Intensity of each echo, empty without intensity
+    QVector<quint32> echoOffsets;   //!< Index in ranges of the first echo of each step
+    Converter converter;
+    qint64 timestamp;
+
+    ScanData(void);
+
+
+    //! Remove every step, allocated memory is kept
+    void clear(void);
+
+    void reserve(int steps, int echoes_per_step = 1);
+
+    int steps(void) const;
+    bool isEmpty(void) const;
+
+    //! Number of echoes of a step
+    int echoes(int step) const;
+
+    bool hasLevels(void) const;
+
+    quint32 range(int step, int echo = 0) const;
+
+    //! Intensity of an echo, 0 without intensity
+    quint32 level(int step, int echo = 0) const;
+
+
+    //! Start a new step, following echoes belong to it
+    void addStep(void);
+    void addEcho(quint32 range);
+    void addEcho(quint32 range, quint32 level);
+
+
+    //! Copy into per step vectors
+    void copyTo(QVector<QVector<long> > &range_steps,
+                QVector<QVector<long> > &level_steps) const;
+
+    //! Conversion from and to SensorDataArray, for existing plugins
+    void fromSensorDataArray(const SensorDataArray &range_data,
+                             const SensorDataArray &level_data);
+    void toSensorDataArray(SensorDataArray &range_data,
+                           SensorDataArray &level_data) const;
+};
+
+Q_DECLARE_METATYPE(ScanData)
+
+#endif // SCAN_DATA_H
@@ -0,0 +1,497 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#include "ScanReactor.h"
+#include "Connection.h"
+#include "RingBuffer.h"
+#include "ScanBufferPool.h"
+#include "ScipFrameParser.h"
+#include "SpscQueue.h"
+#include "Thread.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QVector>
+#include <cstring>
+#include <string>
+
+#if defined(Q_OS_LINUX)
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace qrk;
+using namespace std;
+
+
+namespace
+{
+enum {
+    RingSize = 256 * 1024,      // [byte]
+    MaxEvents = 32,
+    PollTimeoutMsec = 100,      // [msec]
+    DiscardSize = 4096,         // [byte]
+};
+
+
+class Channel
+{
+public:
+    Connection* con_;
+    int fd_;
+    int saved_flags_;
+    string start_command_;
+    int max_steps_;
+
+    RingBuffer<char> ring_;     //!< Written by the I/O thread, read by the parse task
+    ScipFrameParser parser_;
+    ScanData* current_;
+    bool failed_;
+    ScanBufferPool pool_;
+    SpscQueue<ScanData*> queue_;
+
+    QAtomicInt scheduled_;      //!< A parse task is queued or running
+    QAtomicInt frames_;
+    QAtomicInt dropped_;
+    QAtomicInt errors_;
+    QAtomicInt overflow_bytes_;
+    QAtomicInt closed_;
+
+
+    Channel(Connection* con, const char* start_command, int max_steps,
+            size_t queue_size)
+        : con_(con), fd_(-1), saved_flags_(0), start_command_(start_command),
+          max_steps_(max_steps), ring_(RingSize), current_(NULL),
+          failed_(false), queue_(qMax(queue_size, static_cast<size_t>(1))),
+          scheduled_(0), frames_(0), dropped_(0), errors_(0),
+          overflow_bytes_(0), closed_(0) {
+        pool_.setCapacity(max_steps);
+    }
+
+
+    ~Channel(void) {
+        ScanData* scan = NULL;
+        while (queue_.pop(scan)) {
+            pool_.release(scan);
+        }
+        pool_.release(current_);
+    }
+
+
+    void prepareOutput(void) {
+        if (! current_) {
+            current_ = pool_.acquire();
+        }
+        failed_ = false;
+
+        int values = max_steps_ *
+                (parser_.isMultiEcho() ? int(ScipFrameParser::MaxEchoes) : 1);
+        current_->echoOffsets.resize(max_steps_);
+        current_->ranges.resize(values);
+        current_->levels.resize(parser_.hasIntensity() ? values : 0);
+
+        ScipFrameParser::Output output;
+        output.ranges = current_->ranges.data();
+        output.levels = parser_.hasIntensity() ? current_->levels.data() : NULL;
+        output.step_offsets = current_->echoOffsets.data();
+        output.value_capacity = current_->ranges.size();
+        output.step_capacity = current_->echoOffsets.size();
+        parser_.setOutput(output);
+    }
+
+
+    void finishFrame(void) {
+        // 距離データを含むのは、ステータスが "99" でタイムスタンプのあるフレームのみ
+        bool valid = current_ && ! failed_ && (parser_.lineCount() > 2) &&
+                ! strcmp(parser_.status(), "99");
+        parser_.setOutput(ScipFrameParser::Output());
+        failed_ = false;
+        if (! valid) {
+            if (current_) {
+                current_->clear();
+            }
+            return;
+        }
+
+        int values = static_cast<int>(parser_.values());
+        current_->echoOffsets.resize(static_cast<int>(parser_.steps()));
+        current_->ranges.resize(values);
+        if (current_->hasLevels()) {
+            current_->levels.resize(values);
+        }
+        current_->timestamp = parser_.timestamp();
+
+        if (queue_.push(current_)) {
+            frames_.ref();
+        }
+        else {
+            pool_.release(current_);
+            dropped_.ref();
+        }
+        current_ = NULL;
+    }
+
+
+    void parse(void) {
+        do {
+            const char* data;
+            size_t size;
+            while ((size = ring_.readSpan(&data)) > 0) {
+                size_t consumed = 0;
+                ScipFrameParser::Event event = parser_.feed(data, size, &consumed);
+                ring_.consume(consumed);
+
+                if (event == ScipFrameParser::EchobackReceived) {
+                    prepareOutput();
+                }
+                else if (event == ScipFrameParser::ChecksumError) {
+                    // 壊れたフレームは、終端の空行までパーサが読み捨てる
+                    failed_ = true;
+                    errors_.ref();
+                }
+                else if (event == ScipFrameParser::FrameComplete) {
+                    finishFrame();
+                }
+            }
+            scheduled_.storeRelease(0);
+
+            // 解放した直後に受信したデータは、このタスクで続けて処理する
+        } while (! ring_.empty() && scheduled_.testAndSetOrdered(0, 1));
+    }
+};
+
+
+class ParseTask : public QRunnable
+{
+    Channel* channel_;
+
+public:
+    explicit ParseTask(Channel* channel) : channel_(channel) {
+    }
+
+
+    void run(void) {
+        channel_->parse();
+    }
+};
+}
+
+
+struct ScanReactor::pImpl
+{
+    string error_message_;
+    QVector<Channel*> channels_;
+    Thread io_thread_;
+    QThreadPool parse_pool_;
+    int epoll_fd_;
+    bool running_;
+
+
+    pImpl(void)
+        : error_message_("no error."), io_thread_(&ioProcess, this),
+          epoll_fd_(-1), running_(false) {
+    }
+
+
+    ~pImpl(void) {
+        stop();
+        qDeleteAll(channels_);
+    }
+
+
+    static int ioProcess(void* args) {
+#if defined(Q_OS_LINUX)
+        pImpl* obj = static_cast<pImpl*>(args);
+
+        struct epoll_event events[MaxEvents];
+        while (! obj->io_thread_.exitThread) {
+            int n = epoll_wait(obj->epoll_fd_, events, MaxEvents, PollTimeoutMsec);
+            for (int i = 0; i < n; ++i) {
+                obj->readChannel(obj->channels_[events[i].data.u32], events[i].events);
+            }
+        }
+#else
+        Q_UNUSED(args);
+#endif
+        return 0;
+    }
+
+
+    void readChannel(Channel* channel, quint32 events) {
+#if defined(Q_OS_LINUX)
+        // 空き領域が折り返している場合は 2 回に分けて読み込む
+        bool drained = false;
+        for (int i = 0; i < 2; ++i) {
+            char* span;
+            size_t free_size = channel->ring_.writeSpan(&span);
+            if (free_size == 0) {
+                // 解析が追いつかないときは、受信データを捨てる
+                char discard[DiscardSize];
+                ssize_t n = ::read(channel->fd_, discard, sizeof(discard));
+                if (n > 0) {
+                    channel->overflow_bytes_.fetchAndAddOrdered(static_cast<int>(n));
+                }
+                else {
+                    drained = handleReadEnd(channel, n);
+                }
+                break;
+            }
+
+            ssize_t n = ::read(channel->fd_, span, free_size);
+            if (n <= 0) {
+                drained = handleReadEnd(channel, n);
+                break;
+            }
+            channel->ring_.commit(n);
+            if (static_cast<size_t>(n) < free_size) {
+                break;
+            }
+        }
+
+        // 読むデータが残っていないのにエラーや切断が通知され続けると、
+        // レベルトリガの epoll_wait() が空回りする
+        if (drained && (events & (EPOLLERR | EPOLLHUP))) {
+            closeChannel(channel);
+        }
+
+        if (! channel->ring_.empty() && channel->scheduled_.testAndSetOrdered(0, 1)) {
+            parse_pool_.start(new ParseTask(channel));
+        }
+#else
+        Q_UNUSED(channel);
+        Q_UNUSED(events);
+#endif
+    }
+
+
+    // read() が 0 以下を返したときの処理。読むデータがないだけなら true を返す
+    bool handleReadEnd(Channel* channel, long n) {
+#if defined(Q_OS_LINUX)
+        if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            return true;
+        }
+        if ((n < 0) && (errno == EINTR)) {
+            return false;
+        }
+
+        // 接続が閉じられたか、EIO (USB の抜去) や ECONNRESET などのエラー
+        closeChannel(channel);
+#else
+        Q_UNUSED(channel);
+        Q_UNUSED(n);
+#endif
+        return false;
+    }
+
+
+    void closeChannel(Channel* channel) {
+#if defined(Q_OS_LINUX)
+        if (channel->closed_.loadAcquire()) {
+            return;
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, channel->fd_, NULL);
+        channel->closed_.storeRelease(1);
+#else
+        Q_UNUSED(channel);
+#endif
+    }
+
+
+    int addChannel(Connection* con, const char* start_command,
+                   int max_steps, size_t queue_size) {
+        if (running_) {
+            error_message_ = "Reactor is running.";
+            return -1;
+        }
+        if (! con || ! con->isConnected() || (con->nativeHandle() < 0)) {
+            error_message_ = "Connection has no handle to wait on.";
+            return -1;
+        }
+
+        channels_.push_back(new Channel(con, start_command, max_steps, queue_size));
+        return channels_.size() - 1;
+    }
+
+
+    bool start(int parse_threads) {
+        if (running_) {
+            return true;
+        }
+#if defined(Q_OS_LINUX)
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            error_message_ = "epoll_create1 failed.";
+            return false;
+        }
+        parse_pool_.setMaxThreadCount(qMax(parse_threads, 1));
+
+        for (int i = 0; i < channels_.size(); ++i) {
+            Channel* channel = channels_[i];
+            channel->fd_ = channel->con_->nativeHandle();
+            channel->ring_.clear();
+            channel->parser_.reset();
+            channel->closed_.storeRelease(0);
+
+            // 読み込みで待たないように、登録中はノンブロッキングにする
+            channel->saved_flags_ = fcntl(channel->fd_, F_GETFL, 0);
+            fcntl(channel->fd_, F_SETFL, channel->saved_flags_ | O_NONBLOCK);
+
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.u32 = static_cast<quint32>(i);
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, channel->fd_, &event) < 0) {
+                error_message_ = "epoll_ctl failed.";
+                stopChannels(i + 1);
+                return false;
+            }
+
+            channel->con_->clear();
+            channel->con_->send(channel->start_command_.c_str(),
+                                channel->start_command_.size());
+        }
+
+        running_ = true;
+        io_thread_.run();
+        return true;
+#else
+        Q_UNUSED(parse_threads);
+        error_message_ = "Not supported on this platform.";
+        return false;
+#endif
+    }
+
+
+    void stop(void) {
+        if (! running_) {
+            return;
+        }
+        io_thread_.stop();
+        parse_pool_.waitForDone();
+        stopChannels(channels_.size());
+        running_ = false;
+    }
+
+
+    void stopChannels(int count) {
+#if defined(Q_OS_LINUX)
+        for (int i = 0; i < count; ++i) {
+            Channel* channel = channels_[i];
+            fcntl(channel->fd_, F_SETFL, channel->saved_flags_);
+
+            // 切れた接続に送ると、SIGPIPE で止まることがある
+            if (channel->closed_.loadAcquire()) {
+                continue;
+            }
+            const char quit[] = "QT\n";
+            channel->con_->send(quit, sizeof(quit) - 1);
+            channel->con_->clear();
+        }
+        close(epoll_fd_);
+        epoll_fd_ = -1;
+#else
+        Q_UNUSED(count);
+#endif
+    }
+};
+
+
+ScanReactor::ScanReactor(void) : pimpl(new pImpl)
+{
+}
+
+
+ScanReactor::~ScanReactor(void)
+{
+}
+
+
+const char* ScanReactor::what(void) const
+{
+    return pimpl->error_message_.c_str();
+}
+
+
+int ScanReactor::addChannel(Connection* con, const char* start_command,
+                            int max_steps, size_t queue_size)
+{
+    return pimpl->addChannel(con, start_command, max_steps, queue_size);
+}
+
+
+size_t ScanReactor::channels(void) const
+{
+    return pimpl->channels_.size();
+}
+
+
+bool ScanReactor::start(int parse_threads)
+{
+    return pimpl->start(parse_threads);
+}
+
+
+void ScanReactor::stop(void)
+{
+    pimpl->stop();
+}
+
+
+bool ScanReactor::isRunning(void) const
+{
+    return pimpl->running_;
+}
+
+
+ScanData* ScanReactor::takeScan(int channel)
+{
+    if ((channel < 0) || (channel >= pimpl->channels_.size())) {
+        return NULL;
+    }
+    ScanData* scan = NULL;
+    pimpl->channels_[channel]->queue_.pop(scan);
+    return scan;
+}
+
+
+void ScanReactor::releaseScan(int channel, ScanData* scan)
+{
+    if ((channel < 0) || (channel >= pimpl->channels_.size())) {
+        return;
+    }
+    pimpl->channels_[channel]->pool_.release(scan);
+}
+
+
+ScanReactor::Statistics ScanReactor::statistics(int channel) const
+{
+    Statistics statistics;
+    if ((channel < 0) || (channel >= pimpl->channels_.size())) {
+        return statistics;
+    }
+
+    const Channel* target = pimpl->channels_[channel];
+    statistics.frames = target->frames_.loadAcquire();
+    statistics.dropped = target->dropped_.loadAcquire();
+    statistics.errors = target->errors_.loadAcquire();
+    statistics.overflow_bytes = target->overflow_bytes_.loadAcquire();
+    statistics.closed = target->closed_.loadAcquire() != 0;
+    return statistics;
+}
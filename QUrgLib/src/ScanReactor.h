@@ -0,0 +1,135 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_SCAN_REACTOR_H
+#define QRK_SCAN_REACTOR_H
+
+/*!
+  \file
+  \brief Serves many streaming sensors from one I/O thread
+*/
+
+#include "ScanData.h"
+#include <memory>
+
+
+namespace qrk
+{
+class Connection;
+
+
+/*!
+  \brief Serves many streaming sensors from one I/O thread
+
+  Every channel is a connected sensor streaming continuous scans (MD,
+  ME, ND, ...). One thread waits on all the connection handles with
+  epoll and reads whatever arrived into a per-channel ring buffer. A
+  small thread pool then feeds the bytes to the channel's
+  ScipFrameParser. Complete scans are pushed into a per-channel queue
+  and taken with takeScan().
+
+  While the reactor runs, it owns the connections: nothing else may
+  send or receive on them.
+
+  \attention epoll is only available on Linux, start() fails elsewhere.
+*/
+class ScanReactor
+{
+public:
+    enum {
+        DefaultQueueSize = 8,
+        DefaultParseThreads = 2,
+    };
+
+    //! Per-channel counters
+    class Statistics
+    {
+    public:
+        size_t frames;          //!< Scans queued
+        size_t dropped;         //!< Scans dropped because the queue was full
+        size_t errors;          //!< Frames failed on a checksum error
+        size_t overflow_bytes;  //!< Bytes dropped because parsing fell behind
+        bool closed;            //!< The connection was closed or failed, the channel is no longer served
+
+        Statistics(void)
+            : frames(0), dropped(0), errors(0), overflow_bytes(0),
+              closed(false) {
+        }
+    };
+
+
+    ScanReactor(void);
+    ~ScanReactor(void);
+
+    const char* what(void) const;
+
+
+    /*!
+      \brief Register a sensor, before start()
+
+      \param[in] con Connected sensor, with a handle given by Connection::nativeHandle()
+      \param[in] start_command Command starting the stream, sent by start(), e.g. "MD0000108001000\n"
+      \param[in] max_steps Steps of a full scan, area_max + 1
+      \param[in] queue_size Number of scans queued for this channel
+
+      \return Channel index, -1 on error
+    */
+    int addChannel(Connection* con, const char* start_command,
+                   int max_steps, size_t queue_size = DefaultQueueSize);
+
+    size_t channels(void) const;
+
+
+    /*!
+      \brief Send the start commands and serve every channel
+
+      \param[in] parse_threads Threads parsing the received bytes
+    */
+    bool start(int parse_threads = DefaultParseThreads);
+
+    //! Stop serving and send QT to every sensor
+    void stop(void);
+
+    bool isRunning(void) const;
+
+
+    /*!
+      \brief Take the oldest scan of a channel
+
+      Call from a single consumer thread per channel.
+
+      \return Scan to give back with releaseScan(), NULL if none arrived
+    */
+    ScanData* takeScan(int channel);
+
+    void releaseScan(int channel, ScanData* scan);
+
+
+    Statistics statistics(int channel) const;
+
+private:
+    ScanReactor(const ScanReactor &rhs);
+    ScanReactor &operator = (const ScanReactor &rhs);
+
+    struct pImpl;
+    const std::auto_ptr<pImpl> pimpl;
+};
+}
+
+#endif /* !QRK_SCAN_REACTOR_H */
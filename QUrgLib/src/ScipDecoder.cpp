@@ -0,0 +1,594 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "ScipDecoder.h"
+#include <QAtomicPointer>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define QRK_SCIP_DECODER_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define QRK_TARGET(name)
+#else
+#define QRK_TARGET(name) __attribute__((target(name)))
+#endif
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define QRK_SCIP_DECODER_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace qrk;
+
+
+namespace
+{
+typedef void (*DecodeFunction)(quint32* values, const char* data,
+                               size_t count, int width);
+typedef quint32 (*SumFunction)(const char* data, size_t size);
+
+
+inline quint32 sixBits(char ch)
+{
+    return (static_cast<quint32>(ch) - 0x30) & 0x3f;
+}
+
+
+void decodeScalar(quint32* values, const char* data, size_t count, int width)
+{
+    const char* p = data;
+    switch (width) {
+    case 2:
+        for (size_t i = 0; i < count; ++i, p += 2) {
+            values[i] = (sixBits(p[0]) << 6) | sixBits(p[1]);
+        }
+        break;
+
+    case 3:
+        for (size_t i = 0; i < count; ++i, p += 3) {
+            values[i] = (sixBits(p[0]) << 12) | (sixBits(p[1]) << 6) |
+                    sixBits(p[2]);
+        }
+        break;
+
+    case 4:
+        for (size_t i = 0; i < count; ++i, p += 4) {
+            values[i] = (sixBits(p[0]) << 18) | (sixBits(p[1]) << 12) |
+                    (sixBits(p[2]) << 6) | sixBits(p[3]);
+        }
+        break;
+
+    default:
+        for (size_t i = 0; i < count; ++i) {
+            quint32 value = 0;
+            for (int j = 0; j < width; ++j) {
+                value = (value << 6) | sixBits(*p++);
+            }
+            values[i] = value;
+        }
+        break;
+    }
+}
+
+
+quint32 sumScalar(const char* data, size_t size)
+{
+    quint32 sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+        sum += static_cast<unsigned char>(data[i]);
+    }
+    return sum;
+}
+
+
+#if defined(QRK_SCIP_DECODER_X86)
+QRK_TARGET("sse2")
+void decodeSse2(quint32* values, const char* data, size_t count, int width)
+{
+    const __m128i offset = _mm_set1_epi8(0x30);
+    const __m128i mask = _mm_set1_epi8(0x3f);
+    const __m128i low_bytes = _mm_set1_epi16(0x00ff);
+    const __m128i low_words = _mm_set1_epi32(0x0000ffff);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    if ((width == 2) || (width == 4)) {
+        // 隣り合う 2 文字を 16 bit レーンの 12 bit 値にまとめる
+        size_t values_per_load = 16 / width;
+        for (; i + values_per_load <= count; i += values_per_load) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i * width]));
+            v = _mm_and_si128(_mm_sub_epi8(v, offset), mask);
+            __m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, low_bytes), 6),
+                                         _mm_srli_epi16(v, 8));
+            if (width == 2) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i]),
+                                 _mm_unpacklo_epi16(pairs, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i + 4]),
+                                 _mm_unpackhi_epi16(pairs, zero));
+            }
+            else {
+                __m128i quads = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, low_words), 12),
+                                             _mm_srli_epi32(pairs, 16));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i]), quads);
+            }
+        }
+    }
+    decodeScalar(&values[i], &data[i * width], count - i, width);
+}
+
+
+QRK_TARGET("sse2")
+quint32 sumSse2(const char* data, size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i]));
+        total = _mm_add_epi64(total, _mm_sad_epu8(v, zero));
+    }
+    quint32 sum = _mm_cvtsi128_si32(total) +
+            _mm_cvtsi128_si32(_mm_unpackhi_epi64(total, total));
+    return sum + sumScalar(&data[i], size - i);
+}
+
+
+QRK_TARGET("ssse3")
+void decodeSsse3(quint32* values, const char* data, size_t count, int width)
+{
+    const __m128i offset = _mm_set1_epi8(0x30);
+    const __m128i mask = _mm_set1_epi8(0x3f);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    if (width == 2) {
+        const __m128i weights = _mm_set1_epi16(0x0140);
+        for (; i + 8 <= count; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i * 2]));
+            v = _mm_and_si128(_mm_sub_epi8(v, offset), mask);
+            __m128i pairs = _mm_maddubs_epi16(v, weights);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i]),
+                             _mm_unpacklo_epi16(pairs, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i + 4]),
+                             _mm_unpackhi_epi16(pairs, zero));
+        }
+    }
+    else if (width == 3) {
+        // 3 文字ずつを 32 bit レーンに並べ直す。16 byte 読んで 12 byte 使う
+        const __m128i spread = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                             6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i weights = _mm_setr_epi8(64, 1, 1, 0, 64, 1, 1, 0,
+                                              64, 1, 1, 0, 64, 1, 1, 0);
+        const __m128i pair_weights = _mm_set1_epi32(0x00010040);
+        for (; i + 6 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i * 3]));
+            v = _mm_and_si128(_mm_sub_epi8(v, offset), mask);
+            v = _mm_shuffle_epi8(v, spread);
+            __m128i quads = _mm_madd_epi16(_mm_maddubs_epi16(v, weights), pair_weights);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i]), quads);
+        }
+    }
+    else if (width == 4) {
+        const __m128i weights = _mm_set1_epi16(0x0140);
+        const __m128i pair_weights = _mm_set1_epi32(0x00011000);
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&data[i * 4]));
+            v = _mm_and_si128(_mm_sub_epi8(v, offset), mask);
+            __m128i quads = _mm_madd_epi16(_mm_maddubs_epi16(v, weights), pair_weights);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&values[i]), quads);
+        }
+    }
+    decodeScalar(&values[i], &data[i * width], count - i, width);
+}
+
+
+QRK_TARGET("avx2")
+void decodeAvx2(quint32* values, const char* data, size_t count, int width)
+{
+    const __m256i offset = _mm256_set1_epi8(0x30);
+    const __m256i mask = _mm256_set1_epi8(0x3f);
+
+    size_t i = 0;
+    if (width == 2) {
+        const __m256i weights = _mm256_set1_epi16(0x0140);
+        for (; i + 16 <= count; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&data[i * 2]));
+            v = _mm256_and_si256(_mm256_sub_epi8(v, offset), mask);
+            __m256i pairs = _mm256_maddubs_epi16(v, weights);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&values[i]),
+                                _mm256_cvtepu16_epi32(_mm256_castsi256_si128(pairs)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&values[i + 8]),
+                                _mm256_cvtepu16_epi32(_mm256_extracti128_si256(pairs, 1)));
+        }
+    }
+    else if (width == 3) {
+        // 128 bit レーンごとに 12 文字を読み込む。最後の読み込みは 28 byte 先まで
+        const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+                                                6, 7, 8, -1, 9, 10, 11, -1,
+                                                0, 1, 2, -1, 3, 4, 5, -1,
+                                                6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i weights = _mm256_set1_epi32(0x00010140);
+        const __m256i pair_weights = _mm256_set1_epi32(0x00010040);
+        for (; i + 10 <= count; i += 8) {
+            const char* p = &data[i * 3];
+            __m256i v = _mm256_inserti128_si256(
+                        _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+            v = _mm256_and_si256(_mm256_sub_epi8(v, offset), mask);
+            v = _mm256_shuffle_epi8(v, spread);
+            __m256i octets = _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), pair_weights);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&values[i]), octets);
+        }
+    }
+    else if (width == 4) {
+        const __m256i weights = _mm256_set1_epi16(0x0140);
+        const __m256i pair_weights = _mm256_set1_epi32(0x00011000);
+        for (; i + 8 <= count; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&data[i * 4]));
+            v = _mm256_and_si256(_mm256_sub_epi8(v, offset), mask);
+            __m256i octets = _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), pair_weights);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(&values[i]), octets);
+        }
+    }
+    decodeScalar(&values[i], &data[i * width], count - i, width);
+}
+
+
+QRK_TARGET("avx2")
+quint32 sumAvx2(const char* data, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&data[i]));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(v, zero));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(total),
+                                 _mm256_extracti128_si256(total, 1));
+    quint32 sum = _mm_cvtsi128_si32(half) +
+            _mm_cvtsi128_si32(_mm_unpackhi_epi64(half, half));
+    return sum + sumScalar(&data[i], size - i);
+}
+
+
+bool cpuSupports(ScipDecoder::Implementation implementation)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    switch (implementation) {
+    case ScipDecoder::Sse2:
+        return (info[3] & (1 << 26)) != 0;
+
+    case ScipDecoder::Ssse3:
+        return (info[2] & (1 << 9)) != 0;
+
+    case ScipDecoder::Avx2: {
+        // OS が YMM レジスタを保存することも確認する
+        bool os_saves_ymm = ((info[2] & (1 << 27)) != 0) &&
+                ((_xgetbv(0) & 0x6) == 0x6);
+        __cpuidex(info, 7, 0);
+        return os_saves_ymm && ((info[1] & (1 << 5)) != 0);
+    }
+
+    default:
+        return false;
+    }
+#else
+    switch (implementation) {
+    case ScipDecoder::Sse2:
+        return __builtin_cpu_supports("sse2");
+
+    case ScipDecoder::Ssse3:
+        return __builtin_cpu_supports("ssse3");
+
+    case ScipDecoder::Avx2:
+        return __builtin_cpu_supports("avx2");
+
+    default:
+        return false;
+    }
+#endif
+}
+#endif
+
+
+#if defined(QRK_SCIP_DECODER_NEON)
+inline void storeWidened(quint32* values, uint16x8_t v)
+{
+    vst1q_u32(values, vmovl_u16(vget_low_u16(v)));
+    vst1q_u32(values + 4, vmovl_u16(vget_high_u16(v)));
+}
+
+
+inline uint16x8_t combine(uint8x8_t high, uint8x8_t low)
+{
+    return vaddw_u8(vshll_n_u8(high, 6), low);
+}
+
+
+inline void storeCombined(quint32* values, uint16x8_t high, uint16x8_t low,
+                          int shift)
+{
+    if (shift == 6) {
+        vst1q_u32(values, vaddw_u16(vshll_n_u16(vget_low_u16(high), 6),
+                                    vget_low_u16(low)));
+        vst1q_u32(values + 4, vaddw_u16(vshll_n_u16(vget_high_u16(high), 6),
+                                        vget_high_u16(low)));
+    }
+    else {
+        vst1q_u32(values, vaddw_u16(vshll_n_u16(vget_low_u16(high), 12),
+                                    vget_low_u16(low)));
+        vst1q_u32(values + 4, vaddw_u16(vshll_n_u16(vget_high_u16(high), 12),
+                                        vget_high_u16(low)));
+    }
+}
+
+
+void decodeNeon(quint32* values, const char* data, size_t count, int width)
+{
+    const uint8x16_t offset = vdupq_n_u8(0x30);
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+
+    size_t i = 0;
+    if (width == 2) {
+        for (; i + 16 <= count; i += 16) {
+            uint8x16x2_t v = vld2q_u8(&p[i * 2]);
+            uint8x16_t a = vandq_u8(vsubq_u8(v.val[0], offset), mask);
+            uint8x16_t b = vandq_u8(vsubq_u8(v.val[1], offset), mask);
+            storeWidened(&values[i], combine(vget_low_u8(a), vget_low_u8(b)));
+            storeWidened(&values[i + 8], combine(vget_high_u8(a), vget_high_u8(b)));
+        }
+    }
+    else if (width == 3) {
+        for (; i + 16 <= count; i += 16) {
+            uint8x16x3_t v = vld3q_u8(&p[i * 3]);
+            uint8x16_t a = vandq_u8(vsubq_u8(v.val[0], offset), mask);
+            uint8x16_t b = vandq_u8(vsubq_u8(v.val[1], offset), mask);
+            uint8x16_t c = vandq_u8(vsubq_u8(v.val[2], offset), mask);
+            storeCombined(&values[i], combine(vget_low_u8(a), vget_low_u8(b)),
+                          vmovl_u8(vget_low_u8(c)), 6);
+            storeCombined(&values[i + 8], combine(vget_high_u8(a), vget_high_u8(b)),
+                          vmovl_u8(vget_high_u8(c)), 6);
+        }
+    }
+    else if (width == 4) {
+        for (; i + 16 <= count; i += 16) {
+            uint8x16x4_t v = vld4q_u8(&p[i * 4]);
+            uint8x16_t a = vandq_u8(vsubq_u8(v.val[0], offset), mask);
+            uint8x16_t b = vandq_u8(vsubq_u8(v.val[1], offset), mask);
+            uint8x16_t c = vandq_u8(vsubq_u8(v.val[2], offset), mask);
+            uint8x16_t d = vandq_u8(vsubq_u8(v.val[3], offset), mask);
+            storeCombined(&values[i], combine(vget_low_u8(a), vget_low_u8(b)),
+                          combine(vget_low_u8(c), vget_low_u8(d)), 12);
+            storeCombined(&values[i + 8], combine(vget_high_u8(a), vget_high_u8(b)),
+                          combine(vget_high_u8(c), vget_high_u8(d)), 12);
+        }
+    }
+    decodeScalar(&values[i], &data[i * width], count - i, width);
+}
+
+
+quint32 sumNeon(const char* data, size_t size)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    uint32x4_t total = vdupq_n_u32(0);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        total = vpadalq_u16(total, vpaddlq_u8(vld1q_u8(&p[i])));
+    }
+    uint32x2_t half = vadd_u32(vget_low_u32(total), vget_high_u32(total));
+    quint32 sum = vget_lane_u32(vpadd_u32(half, half), 0);
+    return sum + sumScalar(&data[i], size - i);
+}
+#endif
+
+
+DecodeFunction functionOf(ScipDecoder::Implementation implementation)
+{
+    switch (implementation) {
+#if defined(QRK_SCIP_DECODER_X86)
+    case ScipDecoder::Sse2:
+        return decodeSse2;
+
+    case ScipDecoder::Ssse3:
+        return decodeSsse3;
+
+    case ScipDecoder::Avx2:
+        return decodeAvx2;
+#endif
+
+#if defined(QRK_SCIP_DECODER_NEON)
+    case ScipDecoder::Neon:
+        return decodeNeon;
+#endif
+
+    case ScipDecoder::Scalar:
+        return decodeScalar;
+
+    default:
+        return NULL;
+    }
+}
+
+
+SumFunction sumFunctionOf(ScipDecoder::Implementation implementation)
+{
+    switch (implementation) {
+#if defined(QRK_SCIP_DECODER_X86)
+    case ScipDecoder::Sse2:
+    case ScipDecoder::Ssse3:
+        return sumSse2;
+
+    case ScipDecoder::Avx2:
+        return sumAvx2;
+#endif
+
+#if defined(QRK_SCIP_DECODER_NEON)
+    case ScipDecoder::Neon:
+        return sumNeon;
+#endif
+
+    default:
+        return sumScalar;
+    }
+}
+
+
+// 実装ごとの関数の組
+class Dispatch
+{
+public:
+    ScipDecoder::Implementation implementation;
+    DecodeFunction decode;
+    SumFunction sum;
+};
+
+
+Dispatch dispatchOf(ScipDecoder::Implementation implementation)
+{
+    Dispatch dispatch = {
+        implementation, functionOf(implementation), sumFunctionOf(implementation),
+    };
+    return dispatch;
+}
+
+
+// 静的初期化で作り、あとは読むだけ。ScipDecoder::Implementation の順に並べる
+const Dispatch dispatch_table[] = {
+    dispatchOf(ScipDecoder::Scalar),
+    dispatchOf(ScipDecoder::Sse2),
+    dispatchOf(ScipDecoder::Ssse3),
+    dispatchOf(ScipDecoder::Avx2),
+    dispatchOf(ScipDecoder::Neon),
+};
+
+
+// 解析用のスレッドからも呼ばれるので、使う組はポインタ 1 つで切り替える
+QAtomicPointer<const Dispatch> current_dispatch;
+
+
+void selectImplementation(void)
+{
+    static const ScipDecoder::Implementation candidates[] = {
+        ScipDecoder::Avx2,
+        ScipDecoder::Ssse3,
+        ScipDecoder::Sse2,
+        ScipDecoder::Neon,
+    };
+    size_t n = sizeof(candidates) / sizeof(candidates[0]);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (ScipDecoder::setImplementation(candidates[i])) {
+            return;
+        }
+    }
+    ScipDecoder::setImplementation(ScipDecoder::Scalar);
+}
+
+
+const Dispatch* currentDispatch(void)
+{
+    const Dispatch* dispatch = current_dispatch.loadAcquire();
+    if (! dispatch) {
+        // 同時に選んでも、同じ組が書かれるだけ
+        selectImplementation();
+        dispatch = current_dispatch.loadAcquire();
+    }
+    return dispatch;
+}
+}
+
+
+void ScipDecoder::decode(quint32* values, const char* data, size_t count,
+                         int width)
+{
+    currentDispatch()->decode(values, data, count, width);
+}
+
+
+void ScipDecoder::decodePairs(quint32* first, quint32* second,
+                              const char* data, size_t count, int width)
+{
+    enum { ChunkPairs = 64 };
+    quint32 buffer[ChunkPairs * 2];
+
+    while (count > 0) {
+        size_t n = qMin(count, static_cast<size_t>(ChunkPairs));
+        decode(buffer, data, n * 2, width);
+        for (size_t i = 0; i < n; ++i) {
+            first[i] = buffer[i * 2];
+        }
+        if (second) {
+            for (size_t i = 0; i < n; ++i) {
+                second[i] = buffer[(i * 2) + 1];
+            }
+            second += n;
+        }
+        first += n;
+        data += n * 2 * width;
+        count -= n;
+    }
+}
+
+
+char ScipDecoder::checkSum(const char* data, size_t size)
+{
+    return static_cast<char>((currentDispatch()->sum(data, size) & 0x3f) + 0x30);
+}
+
+
+ScipDecoder::Implementation ScipDecoder::implementation(void)
+{
+    return currentDispatch()->implementation;
+}
+
+
+bool ScipDecoder::setImplementation(Implementation implementation)
+{
+    if (! isSupported(implementation)) {
+        return false;
+    }
+    current_dispatch.storeRelease(&dispatch_table[implementation]);
+    return true;
+}
+
+
+bool ScipDecoder::isSupported(Implementation implementation)
+{
+    if (! functionOf(implementation)) {
+        return false;
+    }
+
+#if defined(QRK_SCIP_DECODER_X86)
+    if (implementation != Scalar) {
+        return cpuSupports(implementation);
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef QRK_SCIP_DECODER_H
+#define QRK_SCIP_DECODER_H
+
+/*!
+  \file
+  \brief Batch decoder of SCIP encoded values
+*/
+
+#include <QtGlobal>
+#include <cstddef>
+
+
+namespace qrk
+{
+/*!
+  \brief Batch decoder of SCIP encoded values
+
+  Decodes runs of 2, 3 or 4 character values as ScipHandler::decode()
+  does, and sums SCIP lines for their checksum, several characters per
+  instruction where the CPU allows it. The
+  implementation is selected on first use from the features of the
+  running CPU. Only valid SCIP characters (0x30 - 0x6f) are expected.
+*/
+class ScipDecoder
+{
+public:
+    typedef enum {
+        Scalar,
+        Sse2,
+        Ssse3,
+        Avx2,
+        Neon,
+    } Implementation;
+
+
+    /*!
+      \brief Decode consecutive values
+
+      \param[out] values Decoded values
+      \param[in] data Encoded characters (count * width bytes)
+      \param[in] count Number of values
+      \param[in] width Characters of one value
+    */
+    static void decode(quint32* values, const char* data, size_t count,
+                       int width);
+
+
+    /*!
+      \brief Decode range and intensity pairs of GE/HE/ME/NE data
+
+      \param[out] first Decoded first value of each pair
+      \param[out] second Decoded second value of each pair (may be NULL)
+      \param[in] data Encoded characters (count * 2 * width bytes)
+      \param[in] count Number of pairs
+      \param[in] width Characters of one value
+    */
+    static void decodePairs(quint32* first, quint32* second,
+                            const char* data, size_t count, int width);
+
+
+    /*!
+      \brief Checksum character of a SCIP line
+
+      \param[in] data Line without the checksum character
+      \param[in] size Number of bytes
+
+      \return Expected checksum character
+    */
+    static char checkSum(const char* data, size_t size);
+
+
+    //! Implementation in use
+    static Implementation implementation(void);
+
+
+    /*!
+      \brief Force an implementation
+
+      \retval true Selected
+      \retval false Not supported by this CPU or build
+    */
+    static bool setImplementation(Implementation implementation);
+
+
+    static bool isSupported(Implementation implementation);
+
+private:
+    ScipDecoder(void);
+};
+}
+
+#endif /* !QRK_SCIP_DECODER_H */
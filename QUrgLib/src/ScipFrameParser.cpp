@@ -0,0 +1,467 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "ScipFrameParser.h"
+#include "ScipHandler.h"
+#include "ScipDecoder.h"
+#include "ConnectionUtils.h"
+#include <cstring>
+
+using namespace qrk;
+
+
+namespace
+{
+CaptureType captureType(char command, char kind)
+{
+    static const CaptureType types[][3] = {
+        { GD, GS, GE },
+        { HD, HS, HE },
+        { MD, MS, ME },
+        { ND, NS, NE },
+    };
+    static const char commands[] = "GHMN";
+    static const char kinds[] = "DSE";
+
+    const char* command_p = (command != '\0') ? strchr(commands, command) : NULL;
+    const char* kind_p = (kind != '\0') ? strchr(kinds, kind) : NULL;
+    if (! command_p || ! kind_p) {
+        return TypeUnknown;
+    }
+    return types[command_p - commands][kind_p - kinds];
+}
+}
+
+
+ScipFrameParser::ScipFrameParser(void) : lazy_checksum_(false)
+{
+    reset();
+}
+
+
+void ScipFrameParser::reset(void)
+{
+    state_ = Receiving;
+    line_count_ = 0;
+    type_ = TypeUnknown;
+    data_byte_ = 3;
+    has_intensity_ = false;
+    multi_echo_ = false;
+
+    echoback_[0] = '\0';
+    status_[0] = '\0';
+    timestamp_ = 0;
+
+    steps_ = 0;
+    values_ = 0;
+    overflow_ = false;
+
+    invalid_ranges_ = 0;
+    invalid_values_ = 0;
+    short_line_ = false;
+
+    carry_size_ = 0;
+    next_is_echo_ = false;
+    line_size_ = 0;
+}
+
+
+void ScipFrameParser::setOutput(const Output &output)
+{
+    output_ = output;
+}
+
+
+void ScipFrameParser::setLazyChecksum(bool on)
+{
+    lazy_checksum_ = on;
+}
+
+
+bool ScipFrameParser::isLazyChecksum(void) const
+{
+    return lazy_checksum_;
+}
+
+
+ScipFrameParser::Event ScipFrameParser::feed(const char* data, size_t size,
+                                             size_t* consumed)
+{
+    size_t first = 0;
+    while (first < size) {
+        size_t last = first;
+        while ((last < size) && ! isLF(data[last])) {
+            ++last;
+        }
+
+        if (last == size) {
+            // 改行が届くまで、行の途中を保持しておく
+            size_t n = qMin(size - first, LineBufferSize - line_size_);
+            memcpy(&line_[line_size_], &data[first], n);
+            line_size_ += n;
+            break;
+        }
+
+        Event event;
+        if (line_size_ > 0) {
+            size_t n = qMin(last - first, LineBufferSize - line_size_);
+            memcpy(&line_[line_size_], &data[first], n);
+            size_t line_size = line_size_ + n;
+            line_size_ = 0;
+            event = parseLine(line_, line_size);
+        }
+        else {
+            event = parseLine(&data[first], last - first);
+        }
+        first = last + 1;
+
+        if (event != NeedMoreData) {
+            if (consumed) {
+                *consumed = first;
+            }
+            return event;
+        }
+    }
+
+    if (consumed) {
+        *consumed = size;
+    }
+    return NeedMoreData;
+}
+
+
+ScipFrameParser::Event ScipFrameParser::parseLine(const char* line, size_t size)
+{
+    if (state_ == Complete) {
+        reset();
+    }
+
+    if (size == 0) {
+        if (state_ == Receiving) {
+            invalidateValues();
+        }
+        state_ = Complete;
+        return FrameComplete;
+    }
+
+    if (state_ == Failed) {
+        // 壊れたフレームは、終端の空行まで読み捨てる
+        ++line_count_;
+        return NeedMoreData;
+    }
+
+    if (line_count_ == 0) {
+        // エコーバックにはチェックサムがない
+        parseEchoback(line, size);
+        ++line_count_;
+        return EchobackReceived;
+    }
+
+    if (lazy_checksum_ && (line_count_ >= 3)) {
+        ++line_count_;
+        if (! parseLazyPayload(line, size - 1, line[size - 1])) {
+            state_ = Failed;
+            return ChecksumError;
+        }
+        return NeedMoreData;
+    }
+
+    if (! ScipHandler::checkSum(line, static_cast<int>(size) - 1, line[size - 1])) {
+        state_ = Failed;
+        ++line_count_;
+        return ChecksumError;
+    }
+
+    if (line_count_ == 1) {
+        size_t n = qMin(size - 1, static_cast<size_t>(2));
+        memcpy(status_, line, n);
+        status_[n] = '\0';
+    }
+    else if (line_count_ == 2) {
+        timestamp_ = ScipHandler::decode(line, qMin(size - 1, static_cast<size_t>(4)));
+    }
+    else {
+        parsePayload(line, size - 1);
+    }
+    ++line_count_;
+
+    return NeedMoreData;
+}
+
+
+int ScipFrameParser::lineCount(void) const
+{
+    return line_count_;
+}
+
+
+bool ScipFrameParser::isComplete(void) const
+{
+    return state_ == Complete;
+}
+
+
+bool ScipFrameParser::isFailed(void) const
+{
+    return state_ == Failed;
+}
+
+
+CaptureType ScipFrameParser::type(void) const
+{
+    return type_;
+}
+
+
+int ScipFrameParser::dataByte(void) const
+{
+    return data_byte_;
+}
+
+
+bool ScipFrameParser::hasIntensity(void) const
+{
+    return has_intensity_;
+}
+
+
+bool ScipFrameParser::isMultiEcho(void) const
+{
+    return multi_echo_;
+}
+
+
+const char* ScipFrameParser::echoback(void) const
+{
+    return echoback_;
+}
+
+
+const char* ScipFrameParser::status(void) const
+{
+    return status_;
+}
+
+
+long ScipFrameParser::timestamp(void) const
+{
+    return timestamp_;
+}
+
+
+size_t ScipFrameParser::steps(void) const
+{
+    return steps_;
+}
+
+
+size_t ScipFrameParser::values(void) const
+{
+    return values_;
+}
+
+
+bool ScipFrameParser::isOverflow(void) const
+{
+    return overflow_;
+}
+
+
+size_t ScipFrameParser::invalidValues(void) const
+{
+    return invalid_values_;
+}
+
+
+void ScipFrameParser::parseEchoback(const char* line, size_t size)
+{
+    size_t n = qMin(size, static_cast<size_t>(EchobackSize));
+    memcpy(echoback_, line, n);
+    echoback_[n] = '\0';
+
+    type_ = (size >= 2) ? captureType(line[0], line[1]) : TypeUnknown;
+    data_byte_ = ((size >= 2) && (line[1] == 'S')) ? 2 : 3;
+    has_intensity_ = (size >= 2) && (line[1] == 'E');
+    multi_echo_ = (line[0] == 'H') || (line[0] == 'N');
+}
+
+
+void ScipFrameParser::parsePayload(const char* data, size_t size)
+{
+    if (type_ == TypeUnknown) {
+        return;
+    }
+
+    const size_t group_size = data_byte_ * (has_intensity_ ? 2 : 1);
+    const char* p = data;
+    const char* last_p = data + size;
+
+    // 前の行から続いている値を完成させる
+    while ((carry_size_ > 0) && (p < last_p)) {
+        carry_[carry_size_++] = *p++;
+        if (carry_size_ == group_size) {
+            storeValue(carry_);
+            carry_size_ = 0;
+        }
+    }
+
+    while (p < last_p) {
+        if (*p == '&') {
+            next_is_echo_ = true;
+            ++p;
+            continue;
+        }
+
+        size_t left = last_p - p;
+        if (left < group_size) {
+            // 次の行に続く
+            memcpy(carry_, p, left);
+            carry_size_ = left;
+            break;
+        }
+
+        // 次の '&' までの値をまとめてデコードする
+        const char* run_last_p = last_p;
+        if (multi_echo_) {
+            const char* found = static_cast<const char*>(memchr(p, '&', left));
+            if (found) {
+                run_last_p = found;
+            }
+        }
+        size_t count = (run_last_p - p) / group_size;
+        if (count == 0) {
+            storeValue(p);
+            p += group_size;
+            continue;
+        }
+        storeValues(p, count);
+        p += count * group_size;
+    }
+}
+
+
+bool ScipFrameParser::parseLazyPayload(const char* data, size_t size,
+                                       char actual_sum)
+{
+    // 前の行が欠けていると、以降の値の区切りがずれている
+    if (short_line_) {
+        return false;
+    }
+    short_line_ = (size != DataLineSize);
+
+    size_t first_value = values_;
+    parsePayload(data, size);
+
+    if (ScipDecoder::checkSum(data, size) == actual_sum) {
+        return true;
+    }
+
+    // 次の行に続く値も、この行の文字を含んでいる
+    size_t last_value = values_ + ((carry_size_ > 0) ? 1 : 0);
+    if ((invalid_ranges_ > 0) &&
+            (invalid_last_[invalid_ranges_ - 1] >= first_value)) {
+        invalid_last_[invalid_ranges_ - 1] = last_value;
+        return true;
+    }
+    if (invalid_ranges_ >= MaxInvalidRanges) {
+        return false;
+    }
+    invalid_first_[invalid_ranges_] = first_value;
+    invalid_last_[invalid_ranges_] = last_value;
+    ++invalid_ranges_;
+
+    return true;
+}
+
+
+void ScipFrameParser::invalidateValues(void)
+{
+    for (size_t i = 0; i < invalid_ranges_; ++i) {
+        size_t first = qMin(invalid_first_[i], values_);
+        size_t last = qMin(invalid_last_[i], values_);
+        for (size_t j = first; j < last; ++j) {
+            output_.ranges[j] = 0;
+            if (has_intensity_ && output_.levels) {
+                output_.levels[j] = 0;
+            }
+        }
+        invalid_values_ += last - first;
+    }
+}
+
+
+void ScipFrameParser::storeValues(const char* data, size_t count)
+{
+    // 先頭の値だけは '&' の後の値でありうる
+    storeValue(data);
+    if (--count == 0) {
+        return;
+    }
+    data += data_byte_ * (has_intensity_ ? 2 : 1);
+
+    if (! output_.step_offsets || ! output_.ranges) {
+        overflow_ = true;
+        return;
+    }
+    size_t step_space = output_.step_capacity - qMin(steps_, output_.step_capacity);
+    size_t value_space = output_.value_capacity - qMin(values_, output_.value_capacity);
+    size_t n = qMin(count, qMin(step_space, value_space));
+    if (n < count) {
+        overflow_ = true;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        output_.step_offsets[steps_ + i] = static_cast<quint32>(values_ + i);
+    }
+    if (has_intensity_) {
+        ScipDecoder::decodePairs(&output_.ranges[values_],
+                                 output_.levels ? &output_.levels[values_] : NULL,
+                                 data, n, data_byte_);
+    }
+    else {
+        ScipDecoder::decode(&output_.ranges[values_], data, n, data_byte_);
+    }
+    steps_ += n;
+    values_ += n;
+}
+
+
+void ScipFrameParser::storeValue(const char* data)
+{
+    if (! next_is_echo_ || (steps_ == 0)) {
+        if (! output_.step_offsets || (steps_ >= output_.step_capacity)) {
+            overflow_ = true;
+            next_is_echo_ = false;
+            return;
+        }
+        output_.step_offsets[steps_++] = static_cast<quint32>(values_);
+    }
+    next_is_echo_ = false;
+
+    if (! output_.ranges || (values_ >= output_.value_capacity)) {
+        overflow_ = true;
+        return;
+    }
+    output_.ranges[values_] = ScipHandler::decode(data, data_byte_);
+    if (has_intensity_ && output_.levels) {
+        output_.levels[values_] = ScipHandler::decode(&data[data_byte_], data_byte_);
+    }
+    ++values_;
+}
@@ -0,0 +1,215 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef QRK_SCIP_FRAME_PARSER_H
+#define QRK_SCIP_FRAME_PARSER_H
+
+/*!
+  \file
+  \brief Incremental parser of SCIP range data frames
+*/
+
+#include "CaptureSettings.h"
+#include <QtGlobal>
+#include <cstddef>
+
+
+namespace qrk
+{
+/*!
+  \brief Incremental parser of SCIP range data frames
+
+  Parses one GD/GS/GE, HD/HS/HE, MD/MS/ME or ND/NS/NE frame: echoback,
+  status, timestamp and encoded data lines, up to the empty line that
+  terminates the frame. Bytes can be given as they arrive from the
+  connection with feed(), or line by line with parseLine(). Checksums
+  are verified on every line after the echoback, and decoded values are
+  written straight into caller-owned buffers set by setOutput().
+
+  With setLazyChecksum(), a data line with a bad checksum does not fail
+  the frame: its values are decoded anyway and set to 0 when the frame
+  completes.
+
+  The parser can be resumed at any byte boundary and never allocates.
+*/
+class ScipFrameParser
+{
+public:
+    enum {
+        MaxEchoes = 5,          //!< Echoes per step reserved by ND/NE
+        EchobackSize = 64,
+        LineBufferSize = 4096,
+        DataLineSize = 64,      //!< Encoded characters of a full data line
+        MaxInvalidRanges = 32,
+    };
+
+    typedef enum {
+        NeedMoreData,           //!< Every given byte is consumed
+        EchobackReceived,       //!< Echoback parsed, setOutput() can be called
+        FrameComplete,          //!< The empty line ending the frame arrived
+        ChecksumError,          //!< A line with a bad checksum arrived
+    } Event;
+
+
+    //! Caller-owned destination of the decoded values
+    class Output
+    {
+    public:
+        quint32* ranges;        //!< Range of each echo
+        quint32* levels;        //!< Intensity of each echo (may be NULL)
+        quint32* step_offsets;  //!< Index in ranges of the first echo of each step
+        size_t value_capacity;
+        size_t step_capacity;
+
+        Output(void)
+            : ranges(NULL), levels(NULL), step_offsets(NULL),
+              value_capacity(0), step_capacity(0) {
+        }
+    };
+
+
+    ScipFrameParser(void);
+
+
+    //! Start a new frame, output is kept
+    void reset(void);
+
+
+    void setOutput(const Output &output);
+
+
+    /*!
+      \brief Verify data lines after decoding them
+
+      A bad data line then invalidates only the values it carries. The
+      status and timestamp lines, or a data line following a truncated
+      one, still fail the whole frame.
+
+      \param[in] on true to verify lazily
+    */
+    void setLazyChecksum(bool on);
+    bool isLazyChecksum(void) const;
+
+
+    /*!
+      \brief Parse bytes as they arrive
+
+      Stops after the line raising an event other than NeedMoreData.
+
+      \param[in] data Received bytes
+      \param[in] size Number of bytes
+      \param[out] consumed Number of bytes parsed
+
+      \return Event raised by the last parsed line
+    */
+    Event feed(const char* data, size_t size, size_t* consumed);
+
+
+    /*!
+      \brief Parse one line without its terminator
+    */
+    Event parseLine(const char* line, size_t size);
+
+
+    //! Number of lines parsed in the current frame
+    int lineCount(void) const;
+
+    //! Whether the frame ended or failed
+    bool isComplete(void) const;
+    bool isFailed(void) const;
+
+    //! Receive type detected from the echoback
+    CaptureType type(void) const;
+
+    //! Number of characters of one encoded value
+    int dataByte(void) const;
+
+    //! Whether an intensity value follows every range value
+    bool hasIntensity(void) const;
+
+    //! Whether several echoes per step can be received
+    bool isMultiEcho(void) const;
+
+    const char* echoback(void) const;
+
+    //! Two status characters, \\0 terminated
+    const char* status(void) const;
+
+    long timestamp(void) const;
+
+    //! Number of steps decoded so far
+    size_t steps(void) const;
+
+    //! Number of echoes decoded so far
+    size_t values(void) const;
+
+    //! Whether values were dropped because the output was too small
+    bool isOverflow(void) const;
+
+    //! Number of values set to 0 because of a bad data line
+    size_t invalidValues(void) const;
+
+private:
+    typedef enum {
+        Receiving,
+        Complete,
+        Failed,
+    } State;
+
+    void parseEchoback(const char* line, size_t size);
+    void parsePayload(const char* data, size_t size);
+    void storeValue(const char* data);
+    void storeValues(const char* data, size_t count);
+    bool parseLazyPayload(const char* data, size_t size, char actual_sum);
+    void invalidateValues(void);
+
+    State state_;
+    int line_count_;
+    CaptureType type_;
+    int data_byte_;
+    bool has_intensity_;
+    bool multi_echo_;
+
+    char echoback_[EchobackSize + 1];
+    char status_[3];
+    long timestamp_;
+
+    Output output_;
+    size_t steps_;
+    size_t values_;
+    bool overflow_;
+
+    bool lazy_checksum_;
+    size_t invalid_first_[MaxInvalidRanges];
+    size_t invalid_last_[MaxInvalidRanges];
+    size_t invalid_ranges_;
+    size_t invalid_values_;
+    bool short_line_;           //!< The previous data line was not full
+
+    char carry_[8];             //!< Value split between two lines
+    size_t carry_size_;
+    bool next_is_echo_;         //!< '&' seen, next value belongs to the same step
+
+    char line_[LineBufferSize]; //!< Line split between two feed() calls
+    size_t line_size_;
+};
+}
+
+#endif /* !QRK_SCIP_FRAME_PARSER_H */
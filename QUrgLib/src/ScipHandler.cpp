@@ -24,14 +24,24 @@
 #include "RangeSensorInternalInformation.h"
 #include "Connection.h"
 #include "ConnectionUtils.h"
+#include "LineReader.h"
+#include "ScipFrameParser.h"
+#include "ScipDecoder.h"
+#include "ScanData.h"
+#include "BaudrateCache.h"
 #include "ticks.h"
 #include "delay.h"
 #include "log_printf.h"
 #include <cstring>
 #include <cstdio>
 #include <iostream>
+#include <algorithm>
+#include <set>
+#include <cmath>
 
 #include <QVector>
+#include <QList>
+#include <QElapsedTimer>
 #include <QDebug>
 #include <QTime>
 
@@ -51,6 +61,45 @@ typedef enum {
     ProcessNormal,
 } LoopProcess;
 
+
+//! 見積もったボーレートに近い順に並べる
+class CloserBaudrate
+{
+    double estimate_;
+
+public:
+    explicit CloserBaudrate(long estimate) : estimate_(log(double(estimate))) {
+    }
+
+    bool operator () (long lhs, long rhs) const {
+        return fabs(log(double(lhs)) - estimate_) <
+                fabs(log(double(rhs)) - estimate_);
+    }
+};
+
+
+void moveToFront(long* baudrates, size_t size, long baudrate)
+{
+    long* found = std::find(baudrates, baudrates + size, baudrate);
+    if (found != baudrates + size) {
+        std::rotate(baudrates, found, found + 1);
+    }
+}
+
+
+bool isPrintable(const char* data, int size)
+{
+    if (size <= 0) {
+        return false;
+    }
+    for (int i = 0; i < size; ++i) {
+        if ((data[i] < 0x20) || (data[i] > 0x7e)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void clearReceived(QVector<long> &ranges, CaptureType &type,
                    int &line_count, int &timeout,
                    string &remain_string,
@@ -71,6 +120,9 @@ struct ScipHandler::pImpl {
         TotalTimeout = 1000,        // [msec]
         ContinuousTimeout = 1000,    // [msec] <<- changed
         FirstTimeout = 1000,        // [msec]
+        ProbeResponseTimeout = 200, // [msec]
+        ProbeWindow = 16,           // 応答を待たずに送るコマンド数
+        QtResponseSize = 8,         // "QT\n00P\n\n" [byte]
 
         BufferSize = 4096 + 1, //64 + 1 + 1,    // データ長 + チェックサム + 改行 4096 + 1, //
 
@@ -89,22 +141,45 @@ struct ScipHandler::pImpl {
         LaserOff,
     } LaserState;
 
+    typedef enum {
+        ProbeConnected,
+        ProbeNoResponse,
+        ProbeMismatch,
+        ProbeError,
+    } ProbeResult;
+
     string error_message_;
     Connection* con_;
+    LineReader reader_;
+    ScipFrameParser parser_;
+    ScanData scan_;
     LaserState laser_state_;
     bool mx_capturing_;
     bool nx_capturing_;
 
     bool isPreCommand_QT_;
 
+    bool probing_;              //!< Short timeouts while matching the baudrate
+    size_t mismatch_bytes_;     //!< Bytes received with the last mismatching response
+    bool mismatch_printable_;
+
+    QList<ScipReply> in_flight_; //!< Posted commands waiting for their reply
+
+    // 取得スレッド以外からも読まれる
+    CaptureCounters counters_;
+
 
     pImpl(void)
         : error_message_("no error."), con_(NULL), laser_state_(LaserUnknown),
-          mx_capturing_(false), nx_capturing_(false), isPreCommand_QT_(false) {
+          mx_capturing_(false), nx_capturing_(false), isPreCommand_QT_(false),
+          probing_(false), mismatch_bytes_(0), mismatch_printable_(false) {
     }
 
 
     bool connect(const char* device, long baudrate) {
+        // 前の接続で送ったコマンドの応答は、もう返らない
+        failInFlight(ResponseTimeout);
+
         if (! con_->connect(device, baudrate)) {
             error_message_ = con_->what();
             return false;
@@ -115,57 +190,50 @@ struct ScipHandler::pImpl {
                                  921600, 1000000, 1500000};
         size_t try_size = sizeof(try_baudrates) / sizeof(try_baudrates[0]);
 
+        bool serial = (con_->connectionType() == Connection::SERIAL_TYPE);
 
-        for (size_t i = 1; i < try_size; ++i) {
-            if (baudrate == try_baudrates[i]) {
-                qSwap(try_baudrates[0], try_baudrates[i]);
-                break;
-            }
+        // 前回応答したボーレート、指定されたボーレートの順に試す
+        moveToFront(try_baudrates, try_size, baudrate);
+        if (serial) {
+            moveToFront(try_baudrates, try_size,
+                        BaudrateCache::lookup(QString::fromLocal8Bit(device)));
         }
 
+        // シリアル接続では、応答のないボーレートに長く留まらない
+        probing_ = serial;
         for (size_t i = 0; i < try_size; ++i) {
 
-            if (con_->connectionType() == Connection::SERIAL_TYPE &&
-                    ! con_->setBaudrate(try_baudrates[i])) {
+            if (serial && ! con_->setBaudrate(try_baudrates[i])) {
+                probing_ = false;
                 error_message_ = con_->what();
                 return false;
             }
 
-            con_->clear();
+            ProbeResult result = probe();
+            if ((result == ProbeMismatch) && serial && mismatch_printable_) {
+                // 文字化けしていない応答はボーレートが合っているので
+                // (計測中のデータなど)、もう一度だけ試す
+                result = probe();
+            }
 
-            int return_code = -1;
-            char qt_expected_response[] = { 0, 19, 0x10, -1 };
-            if (response(return_code, qt_expected_response, "QT\n")) {
-                laser_state_ = LaserOff;
+            if (result == ProbeConnected) {
+                probing_ = false;
                 return true;
             }
-            else if (return_code == ResponseTimeout) {
-                error_message_ = "Connection time out.";
-                continue;
-            }
-            else if (return_code == MismatchResponse) {
-//                con_->clear();
-//                skip(con_, ContinuousTimeout);
-                continue;
-            }
-            else if (return_code == Scip11Response) {
-                char scip20_expected_response[] = { 0, -1 };
-                if (! response(return_code, scip20_expected_response, "SCIP2.0\n")) {
-                    error_message_ =
-                            "SCIP1.1 protocol is not supported. Please update URG firmware, or reconnect after a few seconds because sensor is booting.";
-                    return false;
-                }
-                laser_state_ = LaserOff;
-                return true;
+            else if (result == ProbeError) {
+                probing_ = false;
+                return false;
             }
-            else if (return_code == 0xE) {
-                char tm2_expected_response[] = { 0, -1 };
-                if (response(return_code, tm2_expected_response, "TM2\n")) {
-                    laser_state_ = LaserOff;
-                    return true;
-                }
+            else if ((result == ProbeMismatch) && serial && (mismatch_bytes_ > 0)) {
+                // 文字化けした応答のバイト数はボーレートの比に応じて変わるので、
+                // センサのボーレートを見積もって、残りを近い順に試す
+                long estimate = try_baudrates[i] * QtResponseSize /
+                        static_cast<long>(mismatch_bytes_);
+                std::stable_sort(&try_baudrates[i + 1], &try_baudrates[try_size],
+                                 CloserBaudrate(estimate));
             }
         }
+        probing_ = false;
         con_->disconnect();
 
         error_message_ = "Could not connect to sensor with supported speeds.";
@@ -173,6 +241,43 @@ struct ScipHandler::pImpl {
     }
 
 
+    ProbeResult probe(void) {
+        reader_.clear();
+
+        int return_code = -1;
+        char qt_expected_response[] = { 0, 19, 0x10, -1 };
+        if (response(return_code, qt_expected_response, "QT\n")) {
+            laser_state_ = LaserOff;
+            return ProbeConnected;
+        }
+        else if (return_code == ResponseTimeout) {
+            error_message_ = "Connection time out.";
+            return ProbeNoResponse;
+        }
+        else if (return_code == MismatchResponse) {
+            return ProbeMismatch;
+        }
+        else if (return_code == Scip11Response) {
+            char scip20_expected_response[] = { 0, -1 };
+            if (! response(return_code, scip20_expected_response, "SCIP2.0\n")) {
+                error_message_ =
+                        "SCIP1.1 protocol is not supported. Please update URG firmware, or reconnect after a few seconds because sensor is booting.";
+                return ProbeError;
+            }
+            laser_state_ = LaserOff;
+            return ProbeConnected;
+        }
+        else if (return_code == 0xE) {
+            char tm2_expected_response[] = { 0, -1 };
+            if (response(return_code, tm2_expected_response, "TM2\n")) {
+                laser_state_ = LaserOff;
+                return ProbeConnected;
+            }
+        }
+        return ProbeNoResponse;
+    }
+
+
     bool changeBothBaudrate(long baudrate) {
         if (con_->connectionType() == Connection::SERIAL_TYPE) {
             // 既に目標対象のボーレート値ならば、成功とみなす
@@ -226,13 +331,17 @@ struct ScipHandler::pImpl {
 
     bool loadParameter(RangeSensorParameter &parameters) {
         // PP の送信とデータの受信
-        int return_code = -1;
-        char pp_expected_response[] = { 0, -1 };
-        QVector<string> lines;
-        if (! response(return_code, pp_expected_response, "PP\n", &lines)) {
+        ScipReply reply = post("PP");
+        return loadParameter(reply, parameters);
+    }
+
+
+    bool loadParameter(ScipReply &reply, RangeSensorParameter &parameters) {
+        if (! wait(reply) || (reply.status() != 0)) {
             error_message_ = "Getting sensor information failed.";
             return false;
         }
+        const QVector<string> &lines = reply.lines();
 
         // PP 応答内容の格納
         if (lines.size() != 8) {
@@ -263,14 +372,18 @@ struct ScipHandler::pImpl {
 
 
     bool loadInformation(RangeSensorInformation &informations) {
-        // PP の送信とデータの受信
-        int return_code = -1;
-        char vv_expected_response[] = { 0, -1 };
-        QVector<string> lines;
-        if (! response(return_code, vv_expected_response, "VV\n", &lines)) {
+        // VV の送信とデータの受信
+        ScipReply reply = post("VV");
+        return loadInformation(reply, informations);
+    }
+
+
+    bool loadInformation(ScipReply &reply, RangeSensorInformation &informations) {
+        if (! wait(reply) || (reply.status() != 0)) {
             error_message_ = "VV fail.";
             return false;
         }
+        const QVector<string> &lines = reply.lines();
 
         // PP 応答内容の格納
         if (lines.size() != 5) {
@@ -294,13 +407,18 @@ struct ScipHandler::pImpl {
     }
 
     bool loadInternalInformation(RangeSensorInternalInformation &informations) {
-        int return_code = -1;
-        char ii_expected_response[] = { 0, -1 };
-        QVector<string> lines;
-        if (! response(return_code, ii_expected_response, "II\n", &lines)) {
+        ScipReply reply = post("II");
+        return loadInternalInformation(reply, informations);
+    }
+
+
+    bool loadInternalInformation(ScipReply &reply,
+                                 RangeSensorInternalInformation &informations) {
+        if (! wait(reply) || (reply.status() != 0)) {
             error_message_ = "II fail.";
             return false;
         }
+        const QVector<string> &lines = reply.lines();
 
         if (lines.size() == 7) {
 
@@ -332,76 +450,331 @@ struct ScipHandler::pImpl {
         return true;
     }
 
-    QVector<string> supportedCommands() {
-        string firstChar = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-        string secondChar = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    QVector<string> supportedCommands(bool* complete) {
+        static const char prefixes[] = { '\0', '%', '$', '#' };
+
+        QVector<string> commands;
+        commands.reserve(static_cast<int>(26 * 26 * sizeof(prefixes)));
+        for (char first = 'A'; first <= 'Z'; ++first) {
+            for (char second = 'A'; second <= 'Z'; ++second) {
+                for (size_t i = 0; i < sizeof(prefixes); ++i) {
+                    string command;
+                    if (prefixes[i] != '\0') {
+                        command += prefixes[i];
+                    }
+                    command += first;
+                    command += second;
+                    if (! changesState(command)) {
+                        commands.push_back(command);
+                    }
+                }
+            }
+        }
+        return probeCommands(commands, complete);
+    }
 
-        QVector<string> result;
+    QStringList supportedModes(bool* complete) {
+        static const char* modes[] = {
+            "GD", "MD", "GE", "ME", "HD", "ND", "HE", "NE",
+        };
 
-        int return_code = -1;
-        char expected_response[] = {0x0E, 0x0F, -1 }; // -1 is a list terminator
+        QVector<string> commands;
+        for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i) {
+            commands.push_back(modes[i]);
+        }
+
+        QStringList result;
+        QVector<string> supported = probeCommands(commands, complete);
+        for (int i = 0; i < supported.size(); ++i) {
+            result << QString::fromStdString(supported[i]);
+        }
+        return result;
+    }
 
-        for (unsigned int i = 0; i < firstChar.length(); ++i) {
-            for (unsigned int j = 0; j < secondChar.length(); ++j) {
-                string command = string(1, firstChar[i]) + string(1, secondChar[j]);
 
-                string commandToSend = command + "\n";
-                QVector<string> lines;
-                if (response(return_code, expected_response, commandToSend.c_str(), &lines)) {
-                    result.push_back(command);
-                    //                    printf("Command [%s]\n", command.c_str());
-                }
+    // 再起動、設定の書き換えなど、試しに送るとセンサの状態を変えるコマンド
+    static bool changesState(const string &command) {
+        static const char* commands[] = { "RB", "RS", "RT", "BM", "%ST", };
+        if (command[0] == '$') {
+            return true;
+        }
+        for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+            if (command == commands[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-                //                _sleep(1000);
 
-                commandToSend = "%" + command + "\n";
-                if (response(return_code, expected_response, commandToSend.c_str(), &lines)) {
-                    result.push_back("%" + command);
-                    //                    printf("Command [%%%s]\n", command.c_str());
-                }
+    // 応答を待たずに ProbeWindow 個までのコマンドを送り、
+    // エコーバックで応答とコマンドを対応付ける
+    // 0E, 0F (未定義, 拒否) 以外のステータスを返したコマンドを対応とみなす
+    // タイムアウトしたコマンドは 1 つずつ送り直し、それでも応答がなければ
+    // *complete を false にする
+    QVector<string> probeCommands(const QVector<string> &commands, bool* complete) {
+        QVector<string> supported;
+        if (complete) {
+            *complete = false;
+        }
+        if (! con_) {
+            error_message_ = "No connection defined.";
+            return supported;
+        }
 
-                //                _sleep(1000);
+        if (! con_->isConnected()) {
+            error_message_ = "Sensor not connected.";
+            return supported;
+        }
 
-                commandToSend = "$" + command + "\n";
-                if (response(return_code, expected_response, commandToSend.c_str(), &lines)) {
-                    result.push_back("$" + command);
-                    //                    printf("Command [%%%s]\n", command.c_str());
+        reader_.clear();
+
+        std::set<string> pending;
+        QVector<string> timed_out;
+        int next = 0;
+        while ((next < commands.size()) || ! pending.empty()) {
+            while ((next < commands.size()) && (pending.size() < static_cast<size_t>(ProbeWindow))) {
+                const string &command = commands[next++];
+                if (! sendProbe(command)) {
+                    return supported;
                 }
+                pending.insert(command);
+            }
 
-                //                _sleep(1000);
+            if (! readProbeReply(pending, supported, ContinuousTimeout)) {
+                // 応答のなかったコマンドは、後で 1 つずつ確かめる
+                std::set<string>::const_iterator it;
+                for (it = pending.begin(); it != pending.end(); ++it) {
+                    timed_out.push_back(*it);
+                }
+                pending.clear();
+            }
+        }
 
-                commandToSend = "#" + command + "\n";
-                if (response(return_code, expected_response, commandToSend.c_str(), &lines)) {
-                    result.push_back("#" + command);
-                    //                    printf("Command [%%%s]\n", command.c_str());
+        bool answered = true;
+        for (int i = 0; i < timed_out.size(); ++i) {
+            reader_.clear();
+            if (! sendProbe(timed_out[i])) {
+                return supported;
+            }
+            pending.insert(timed_out[i]);
+            while (! pending.empty()) {
+                if (! readProbeReply(pending, supported, FirstTimeout)) {
+                    pending.clear();
+                    answered = false;
                 }
-                //                //_sleep(1000);
             }
         }
 
-        return result;
+        // QT なども送っているので、センサの状態は分からない
+        laser_state_ = LaserUnknown;
+        isPreCommand_QT_ = false;
+        mx_capturing_ = false;
+        nx_capturing_ = false;
+
+        if (! answered) {
+            error_message_ = "Response timeout.";
+        }
+        if (complete) {
+            *complete = answered;
+        }
+        return supported;
     }
 
-    QStringList supportedModes() {
-        QStringList result;
-        QVector<string> commandsList;
-        commandsList.push_back("GD\n");
-        commandsList.push_back("MD\n");
-        commandsList.push_back("GE\n");
-        commandsList.push_back("ME\n");
-        commandsList.push_back("HD\n");
-        commandsList.push_back("ND\n");
-        commandsList.push_back("HE\n");
-        commandsList.push_back("NE\n");
 
-        int return_code = -1;
-        char expected_response[] = {0x0E, 0X0F, -1 }; // -1 is a list terminator
-        for (int i = 0; i < commandsList.size(); ++i) {
-            if (!response(return_code, expected_response, commandsList[i].c_str())) {
-                result << QString::fromStdString(commandsList[i].substr(0, 2));
+    bool sendProbe(const string &command) {
+        string send_command = command + "\n";
+        int send_size = static_cast<int>(send_command.size());
+        if (sendCommand(send_command.c_str(), send_size) != send_size) {
+            error_message_ = "Sending command failed.";
+            return false;
+        }
+        return true;
+    }
+
+
+    // 応答を 1 つ読み、pending のコマンドへの応答なら取り除く
+    // 何も届かずにタイムアウトしたときは false を返す
+    bool readProbeReply(std::set<string> &pending, QVector<string> &supported,
+                        int timeout) {
+        char buffer[BufferSize + 1];
+        int recv_size = reader_.readline(buffer, BufferSize, timeout);
+        if (recv_size < 0) {
+            return false;
+        }
+        if (recv_size == 0) {
+            return true;
+        }
+        string echoback(buffer, recv_size);
+
+        recv_size = reader_.readline(buffer, BufferSize, ContinuousTimeout);
+        bool accepted = (recv_size == 3) &&
+                checkSum(buffer, 2, buffer[2]) &&
+                strncmp(buffer, "0E", 2) && strncmp(buffer, "0F", 2);
+        while (recv_size > 0) {
+            recv_size = reader_.readline(buffer, BufferSize, ContinuousTimeout);
+        }
+
+        // タイムアウトの後に届いた応答は読み捨てる
+        std::set<string>::iterator it = pending.find(echoback);
+        if (it == pending.end()) {
+            return true;
+        }
+        pending.erase(it);
+        if (accepted) {
+            supported.push_back(echoback);
+        }
+        return true;
+    }
+
+
+    int sendCommand(const char* data, int size) {
+        int n = con_->send(data, size);
+        counters_.addBytesSent(n);
+        return n;
+    }
+
+
+    ScipReply post(const string &command) {
+        ScipReply reply;
+        reply.data_->command = command;
+        if (! con_) {
+            error_message_ = "No connection defined.";
+            return finish(reply, SendFail);
+        }
+
+        if (! con_->isConnected()) {
+            error_message_ = "Sensor not connected.";
+            return finish(reply, SendFail);
+        }
+
+        string send_command = command + "\n";
+        int send_size = static_cast<int>(send_command.size());
+        if (sendCommand(send_command.c_str(), send_size) != send_size) {
+            error_message_ = "Sending command failed.";
+            return finish(reply, SendFail);
+        }
+        if (command == "QT") {
+            isPreCommand_QT_ = false;
+            mx_capturing_ = false;
+            nx_capturing_ = false;
+        }
+
+        in_flight_.append(reply);
+        return reply;
+    }
+
+
+    bool wait(ScipReply &reply) {
+        while (! reply.isReady()) {
+            if (in_flight_.isEmpty()) {
+                error_message_ = "Command not posted.";
+                return false;
+            }
+
+            if (! readReply()) {
+                // 応答が途絶えたら、送信済みのコマンドはすべて失敗とする
+                error_message_ = "Response timeout.";
+                counters_.addTimeout();
+                failInFlight(ResponseTimeout);
             }
         }
-        return result;
+        return reply.status() >= 0;
+    }
+
+
+    // 送信済みのコマンドへの応答を 1 つ読み出す
+    bool readReply(void) {
+        char buffer[BufferSize + 1];
+        int recv_size = reader_.readline(buffer, BufferSize, FirstTimeout);
+        if (recv_size < 0) {
+            return false;
+        }
+        if (recv_size == 0) {
+            return true;
+        }
+        string echoback(buffer, recv_size);
+
+        recv_size = reader_.readline(buffer, BufferSize, ContinuousTimeout);
+        if (recv_size < 0) {
+            return false;
+        }
+
+        int status = -1;
+        QVector<string> lines;
+        if (recv_size > 0) {
+            status = statusCode(buffer, recv_size);
+            while ((recv_size =
+                    reader_.readline(buffer, BufferSize, ContinuousTimeout)) > 0) {
+                lines.push_back(string(buffer, recv_size));
+            }
+        }
+
+        // 応答は送信した順に返るので、先に送ったコマンドの応答は失われている
+        for (int i = 0; i < in_flight_.size(); ++i) {
+            if (in_flight_[i].command() != echoback) {
+                continue;
+            }
+            counters_.addEchobackMismatch(i);
+            for (int j = 0; j < i; ++j) {
+                finish(in_flight_.takeFirst(), MismatchResponse);
+            }
+            ScipReply reply = in_flight_.takeFirst();
+            reply.data_->lines = lines;
+            finish(reply, status);
+            return true;
+        }
+
+        // 対応するコマンドのない応答は読み捨てる
+        counters_.addEchobackMismatch();
+        return true;
+    }
+
+
+    ScipReply finish(ScipReply reply, int status) {
+        reply.data_->status = status;
+        reply.data_->ready = true;
+        return reply;
+    }
+
+
+    void failInFlight(int status) {
+        while (! in_flight_.isEmpty()) {
+            finish(in_flight_.takeFirst(), status);
+        }
+    }
+
+
+    // ステータス行をステータスの値に変換する
+    int statusCode(char* buffer, int recv_size) {
+        if (recv_size == 3) {
+            if (! checkSum(buffer, recv_size - 1, buffer[recv_size - 1])) {
+                error_message_ = "Checksum failed.";
+                if (! probing_) {
+                    counters_.addChecksumError();
+                }
+                return ChecksumFail;
+            }
+            buffer[2] = '\0';
+            if (!strcmp(buffer, "0G")) {
+                return 16;
+            }
+            if (!strcmp(buffer, "0H")) {
+                return 17;
+            }
+            if (!strcmp(buffer, "0I")) {
+                return 18;
+            }
+            if (!strcmp(buffer, "0L")) {
+                return 19;
+            }
+            return strtol(buffer, NULL, 16);
+        }
+        else if (recv_size == 1) {
+            error_message_ = "SCIP 1 response";
+            return Scip11Response;
+        }
+        return -1;
     }
 
 
@@ -429,7 +802,7 @@ struct ScipHandler::pImpl {
         size_t send_size;// = strlen(send_command);
         if(send_command){
             send_size = strlen(send_command);
-            int actual_send_size = con_->send(send_command, send_size);
+            int actual_send_size = sendCommand(send_command, static_cast<int>(send_size));
             if (!strncmp(send_command, "QT\n", send_size)) {
                 isPreCommand_QT_ = false;
                 mx_capturing_ = false;
@@ -442,11 +815,18 @@ struct ScipHandler::pImpl {
             }
         }
 
+        int first_timeout = probing_ ? int(ProbeResponseTimeout) : int(FirstTimeout);
+        int continuous_timeout =
+                probing_ ? int(ProbeResponseTimeout) : int(ContinuousTimeout);
+
         char buffer[BufferSize +1];
-        int recv_size = readline(con_, buffer, BufferSize, FirstTimeout);
+        int recv_size = reader_.readline(buffer, BufferSize, first_timeout);
         if (recv_size < 0) {
             error_message_ = "Sesponse timeout.";
             return_code = ResponseTimeout;
+            if (! probing_) {
+                counters_.addTimeout();
+            }
             return false;
         }
 
@@ -460,54 +840,40 @@ struct ScipHandler::pImpl {
                         (strncmp(buffer, send_command, recv_size))) {
                     error_message_ = "mismatch response: " + string(buffer);
                     return_code = MismatchResponse;
+                    if (! probing_) {
+                        counters_.addEchobackMismatch();
+                    }
                     std::cerr << "Error: " <<  error_message_.c_str() << " command: " << send_command << endl;
-                    con_->clear();
-                    skip(con_, ContinuousTimeout);
-                    skip(con_, ContinuousTimeout);
+                    mismatch_bytes_ = recv_size + 1;
+                    mismatch_printable_ = isPrintable(buffer, recv_size);
+                    reader_.clear();
+                    mismatch_bytes_ += reader_.skip(continuous_timeout);
+                    mismatch_bytes_ += reader_.skip(continuous_timeout);
                     return false;
                 }
             }
         }
 
-        recv_size = readline(con_, buffer, BufferSize, ContinuousTimeout);
+        recv_size = reader_.readline(buffer, BufferSize, continuous_timeout);
         if (recv_size < 0) {
             error_message_ = "Response timeout.";
             return_code = ResponseTimeout;
+            if (! probing_) {
+                counters_.addTimeout();
+            }
             return false;
         }
 
         buffer[recv_size] = '\0';
         if(return_all) lines->push_back(buffer);
 
-        if (recv_size == 3) {
-            if (! checkSum(buffer, recv_size - 1, buffer[recv_size - 1])) {
-                return_code = ChecksumFail;
-                error_message_ = "Checksum failed.";
-                return false;
-            }
-            buffer[2] = '\0';
-            return_code = strtol(buffer, NULL, 16);
-            if (!strcmp(buffer, "0G")) {
-                return_code = 16;
-            }
-            if (!strcmp(buffer, "0H")) {
-                return_code = 17;
-            }
-            if (!strcmp(buffer, "0I")) {
-                return_code = 18;
-            }
-            if (!strcmp(buffer, "0L")) {
-                return_code = 19;
-            }
-
-        }
-        else if (recv_size == 1) {
-            return_code = Scip11Response;
-            error_message_ = "SCIP 1 response";
+        return_code = statusCode(buffer, recv_size);
+        if (return_code == ChecksumFail) {
+            return false;
         }
 
         do {
-            recv_size = readline(con_, buffer, BufferSize, ContinuousTimeout);
+            recv_size = reader_.readline(buffer, BufferSize, continuous_timeout);
             if (lines && (recv_size > 0)) {
                 lines->push_back(buffer);
             }
@@ -565,21 +931,6 @@ struct ScipHandler::pImpl {
     }
 
 
-    bool testChecksum(const char* buffer, int line_size) {
-        if (! checkSum(buffer, line_size - 1, buffer[line_size - 1])) {
-            //log_printf("checksum error: %s\n", buffer);
-            // return InvalidData;
-            // !!! URG のパケットエラーがなくなったら、この実装に戻す
-
-            // !!! 存在するだけのパケットを読み飛ばす
-            error_message_ = "invalid packet.";
-            return false;
-        }
-
-        return true;
-    }
-
-
     LoopProcess handleEchoback(const char* buffer, CaptureSettings &settings,
                                CaptureType &type) {
         string line = buffer;
@@ -666,11 +1017,9 @@ struct ScipHandler::pImpl {
     }
 
 
-    void handleReturnCode(char* buffer, CaptureSettings &settings, int timeout,
+    void handleReturnCode(const char* status, CaptureSettings &settings, int timeout,
                           CaptureType &type, int* total_times) {
-        // !!! 長さが 2 + 1 かのチェックをすべき
-        buffer[2] = '\0';
-        settings.error_code = atoi(buffer);
+        settings.error_code = atoi(status);
 
         if (settings.error_code == 10) {
             // レーザ消灯を検出
@@ -681,8 +1030,8 @@ struct ScipHandler::pImpl {
 
         // "0B" が返された場合、センサとホストの応答がずれている可能性があるので
         // 続く応答を読み捨てる
-        if (! strncmp(buffer, "0B", 2)) {
-            skip(con_, TotalTimeout, timeout);
+        if (! strncmp(status, "0B", 2)) {
+            reader_.skip(TotalTimeout, timeout);
         }
 
         // !!! "00P" との比較をすべき
@@ -704,47 +1053,43 @@ struct ScipHandler::pImpl {
     }
 
 
-    CaptureType receiveCaptureData(QVector<QVector<long> > &ranges
-                                   , QVector<QVector<long> > &levels
+    CaptureType receiveCaptureData(ScanData &scan
                                    , CaptureSettings &settings
                                    , long &timestamp
                                    , int *remain_times
                                    , int *total_times) {
-        int line_count = 0;
-        string left_packet_data;
-        char buffer[BufferSize];
+        const char* line = NULL;
 
-        ranges.clear();
-        levels.clear();
+        scan.clear();
+        parser_.reset();
+        parser_.setOutput(ScipFrameParser::Output());
 
         error_message_ = "no response.";
 
         CaptureType type = TypeUnknown;
         int timeout = FirstTimeout;
         int line_size = 0;
-
-//        QTime timer;
-//        timer.start();
-        while ((line_size = readline(con_, buffer, BufferSize, timeout)) > 0) {
-            //            fprintf(stderr, "%d: %3d: %s\n", ticks(), line_count, buffer);
-
-            //log_printf("%d: %3d: %s\n",  ticks(), line_count, buffer);
-
-            if (line_count != 0) {
-                // エコーバックにはチェックサム文字列がないので、無視
-                if (! testChecksum(buffer, line_size)) {
-                    error_message_ = "Checksum error";
-                    skip(con_, 25);
-                    ranges.clear();
-                    levels.clear();
-                    break;
-                }
+        bool checksum_error = false;
+
+        // 受信待ちを除いた、デコードだけの時間も測る
+        // 受信時間は最初の行が届いてからで、連続取得での次のスキャン待ちは含めない
+        QElapsedTimer timer;
+        timer.start();
+        qint64 parse_nsec = 0;
+        qint64 first_line_nsec = -1;
+
+        while ((line_size = reader_.readline(&line, timeout)) > 0) {
+            qint64 parse_start = timer.nsecsElapsed();
+            if (first_line_nsec < 0) {
+                first_line_nsec = parse_start;
             }
+            ScipFrameParser::Event event = parser_.parseLine(line, line_size);
+            parse_nsec += timer.nsecsElapsed() - parse_start;
+            timeout = ContinuousTimeout;
 
-            if (line_count == 0) {
-                // エコーバック
+            if (event == ScipFrameParser::EchobackReceived) {
                 LoopProcess loop_process =
-                        handleEchoback(buffer, settings, type);
+                        handleEchoback(line, settings, type);
 
                 if (loop_process == ProcessContinue) {
                     error_message_ = "Not range command";
@@ -753,32 +1098,45 @@ struct ScipHandler::pImpl {
                 }
                 else if (loop_process == ProcessBreak) {
                     error_message_ = "Echo back error.";
+                    counters_.addEchobackMismatch();
                     break;
                 }
+                prepareOutput(settings, scan);
 
             }
-            else if (line_count == 1) {
-                handleReturnCode(buffer, settings, timeout, type, total_times);
-            }
-            else if (line_count == 2) {
-                timestamp = decode(buffer, 4);
+            else if (event == ScipFrameParser::ChecksumError) {
+                // 壊れたフレームは、終端の空行までパーサが読み捨てる
+                error_message_ = "Checksum error";
+                checksum_error = true;
+
             }
-            else {
-                left_packet_data =
-                        addLengthData(ranges, levels, string(buffer), left_packet_data, type,
-                                      settings.data_byte);
+            else if ((parser_.lineCount() == 2) && ! parser_.isFailed()) {
+                handleReturnCode(parser_.status(), settings, timeout, type, total_times);
             }
-            ++line_count;
-            timeout = ContinuousTimeout;
         } // Loop end
 
-//        std::cerr << "receiveCaptureData time: " << timer.elapsed() << "ms" << endl;
+        if (line_size == 0) {
+            // 終端の空行もパーサに渡す。遅延検証で壊れた行の値は、ここで 0 になる
+            parser_.parseLine(line, 0);
+        }
+        if (parser_.invalidValues() > 0) {
+            error_message_ = "Checksum error";
+        }
 
-        if(line_count == 0){
+        if (parser_.lineCount() == 0) {
             settings.error_code = -1;
+            counters_.addTimeout();
         }
-
-        //log_printf("receiveCaptureData_size[%d]\n", data.size());
+        if (parser_.lineCount() > 2) {
+            timestamp = parser_.timestamp();
+            counters_.addFrame();
+            counters_.addParseTime(parse_nsec / 1000);
+            counters_.addReceiveLatency((timer.nsecsElapsed() - first_line_nsec) / 1000);
+        }
+        if (checksum_error || (parser_.invalidValues() > 0)) {
+            counters_.addChecksumError();
+        }
+        finishOutput(scan, checksum_error);
 
         // !!! type が距離データ取得のときは、正常に受信が完了したか、を確認すべき
 
@@ -799,6 +1157,42 @@ struct ScipHandler::pImpl {
     }
 
 
+    void prepareOutput(const CaptureSettings &settings, ScanData &scan) {
+        int group_steps = qMax(settings.group_steps, 1);
+        int steps = qMax(settings.capture_last - settings.capture_first, 0)
+                / group_steps + 1;
+        int values = steps * (parser_.isMultiEcho() ? int(ScipFrameParser::MaxEchoes) : 1);
+
+        // 縮めても容量は残るので、連続取得では確保し直さない
+        scan.echoOffsets.resize(steps);
+        scan.ranges.resize(values);
+        scan.levels.resize(parser_.hasIntensity() ? values : 0);
+
+        ScipFrameParser::Output output;
+        output.ranges = scan.ranges.data();
+        output.levels = parser_.hasIntensity() ? scan.levels.data() : NULL;
+        output.step_offsets = scan.echoOffsets.data();
+        output.value_capacity = scan.ranges.size();
+        output.step_capacity = scan.echoOffsets.size();
+        parser_.setOutput(output);
+    }
+
+
+    void finishOutput(ScanData &scan, bool discard) {
+        if (discard) {
+            scan.clear();
+            return;
+        }
+
+        int values = static_cast<int>(parser_.values());
+        scan.echoOffsets.resize(static_cast<int>(parser_.steps()));
+        scan.ranges.resize(values);
+        if (scan.hasLevels()) {
+            scan.levels.resize(values);
+        }
+    }
+
+
     bool parseGdEchoback(CaptureSettings &settings, const string &line) {
         if (line.size() != 12) {
             error_message_ = "Invalid GD packet has arrived.";
@@ -985,86 +1379,6 @@ struct ScipHandler::pImpl {
             printf("%ld | ", ranges[i]);
         }
     }
-
-    string addLengthData(QVector<QVector<long> > &ranges
-                          , QVector<QVector<long> > &levels
-                          , const string &line
-                          , const string &left_packet_data
-                          , CaptureType type
-                          , const size_t data_byte) {
-        if (line.empty()) {
-            return left_packet_data;
-        }
-
-        string left_byte = left_packet_data;
-
-        //size_t data_size = (left_byte.size() + (line.size() - 1)) / data_byte;
-        size_t double_data_byte = data_byte * 2;
-        //size_t n = data_size * data_byte - left_byte.size();
-        size_t n = line.size() - 1;
-        for (size_t i = 0; i < n; ++i) {
-            left_byte.push_back(line[i]);
-
-            if (type == GE || type == HE || type == ME || type == NE) {
-                if (left_byte.size() >= double_data_byte) {
-                    size_t found = left_byte.find('&');
-                    if (found == string::npos) {
-                        ranges.push_back(QVector<long>());
-                        levels.push_back(QVector<long>());
-                    }
-                    else {
-                        if (left_byte.size() == double_data_byte) {
-                            continue;
-                        }
-
-                        if (found == 0) {
-                            left_byte.erase(0, 1);
-                        }
-                    }
-
-                    if(ranges.isEmpty()){
-                        ranges.push_back(QVector<long>());
-                    }
-                    long length = decode(&left_byte[0], data_byte);
-                    ranges.last().push_back(length);
-
-                    if(levels.isEmpty()){
-                        levels.push_back(QVector<long>());
-                    }
-                    length = decode(&left_byte[data_byte], data_byte);
-                    levels.last().push_back(length);
-
-                    left_byte.erase(0, double_data_byte);
-                }
-            }
-            else {
-                if (left_byte.size() >= data_byte) {
-                    size_t found = left_byte.find('&');
-                    if (found == string::npos) {
-                        ranges.push_back(QVector<long>());
-                    }
-                    else {
-                        if (left_byte.size() == data_byte) {
-                            continue;
-                        }
-
-                        if (found == 0) {
-                            left_byte.erase(0, 1);
-                        }
-                    }
-
-                    if(ranges.isEmpty()){
-                        ranges.push_back(QVector<long>());
-                    }
-                    long length = decode(&left_byte[0], data_byte);
-                    ranges.last().push_back(length);
-                    left_byte.erase(0, data_byte);
-                }
-            }
-
-        }
-        return left_byte;
-    }
 };
 
 
@@ -1105,15 +1419,7 @@ bool ScipHandler::checkSum(const char* buffer, int size, char actual_sum)
         return false;
     }
 
-    const char* p = buffer;
-    const char* last_p = p + size;
-
-    char expected_sum = 0x00;
-    while (p < last_p) {
-        expected_sum += *p++;
-    }
-
-    expected_sum = (expected_sum & 0x3f) + 0x30;
+    char expected_sum = ScipDecoder::checkSum(buffer, size);
 
     return (expected_sum == actual_sum) ? true : false;
 }
@@ -1122,6 +1428,7 @@ bool ScipHandler::checkSum(const char* buffer, int size, char actual_sum)
 void ScipHandler::setConnection(Connection* con)
 {
     pimpl->con_ = con;
+    pimpl->reader_.setConnection(con);
 }
 
 
@@ -1152,13 +1459,13 @@ int ScipHandler::send(const char data[], int size)
             pimpl->isPreCommand_QT_ = false;
         }
     }
-    return pimpl->con_->send(data, size);
+    return pimpl->sendCommand(data, size);
 }
 
 
 int ScipHandler::recv(char data[], int size, int timeout)
 {
-    return pimpl->con_->receive(data, size, timeout);
+    return pimpl->reader_.receive(data, size, timeout);
 }
 
 
@@ -1177,14 +1484,51 @@ bool ScipHandler::loadInternalInformation(RangeSensorInternalInformation &intern
     return pimpl->loadInternalInformation(internalInformations);
 }
 
-QVector<string> ScipHandler::supportedCommands()
+
+bool ScipHandler::loadParameter(ScipReply &reply, RangeSensorParameter &parameters)
+{
+    return pimpl->loadParameter(reply, parameters);
+}
+
+
+bool ScipHandler::loadInformation(ScipReply &reply, RangeSensorInformation &informations)
+{
+    return pimpl->loadInformation(reply, informations);
+}
+
+
+bool ScipHandler::loadInternalInformation(ScipReply &reply,
+                                          RangeSensorInternalInformation &internalInformations)
+{
+    return pimpl->loadInternalInformation(reply, internalInformations);
+}
+
+
+ScipReply ScipHandler::post(const string &command)
+{
+    return pimpl->post(command);
+}
+
+
+bool ScipHandler::wait(ScipReply &reply)
+{
+    return pimpl->wait(reply);
+}
+
+
+int ScipHandler::pendingReplies(void) const
+{
+    return pimpl->in_flight_.size();
+}
+
+QVector<string> ScipHandler::supportedCommands(bool* complete)
 {
-    return pimpl->supportedCommands();
+    return pimpl->supportedCommands(complete);
 }
 
-QStringList ScipHandler::supportedModes()
+QStringList ScipHandler::supportedModes(bool* complete)
 {
-    return pimpl->supportedModes();
+    return pimpl->supportedModes(complete);
 }
 
 bool ScipHandler::commandLines(string &cmd, QVector<string >* lines, bool all)
@@ -1324,7 +1668,20 @@ CaptureType ScipHandler::receiveCaptureData(QVector<QVector<long> > &ranges
                                             , int* remain_times
                                             , int* total_times)
 {
-    CaptureType result = pimpl->receiveCaptureData(ranges, levels, settings,
+    CaptureType result = pimpl->receiveCaptureData(pimpl->scan_, settings,
+                                                   timestamp, remain_times, total_times);
+    pimpl->scan_.copyTo(ranges, levels);
+    return result;
+}
+
+
+CaptureType ScipHandler::receiveCaptureData(ScanData &scan
+                                            , CaptureSettings &settings
+                                            , long &timestamp
+                                            , int* remain_times
+                                            , int* total_times)
+{
+    CaptureType result = pimpl->receiveCaptureData(scan, settings,
                                                    timestamp, remain_times, total_times);
     return result;
 }
@@ -1334,3 +1691,36 @@ bool ScipHandler::isContiniousMode()
     return pimpl->mx_capturing_ || pimpl->nx_capturing_;
 }
 
+
+CaptureStatistics ScipHandler::captureStatistics(void) const
+{
+    CaptureStatistics statistics = pimpl->counters_.snapshot();
+    statistics.bytes_received = pimpl->reader_.receivedBytes();
+    return statistics;
+}
+
+
+void ScipHandler::resetCaptureStatistics(void)
+{
+    pimpl->counters_.reset();
+    pimpl->reader_.resetReceivedBytes();
+}
+
+
+CaptureCounters &ScipHandler::captureCounters(void)
+{
+    return pimpl->counters_;
+}
+
+
+void ScipHandler::setLazyChecksum(bool on)
+{
+    pimpl->parser_.setLazyChecksum(on);
+}
+
+
+bool ScipHandler::isLazyChecksum(void) const
+{
+    return pimpl->parser_.isLazyChecksum();
+}
+
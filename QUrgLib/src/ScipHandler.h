@@ -31,12 +31,16 @@
 */
 
 #include "CaptureSettings.h"
+#include "ScipReply.h"
+#include "CaptureStatistics.h"
 #include <memory>
 #include <QVector>
 #include <QStringList>
 
 using namespace std;
 
+class ScanData;
+
 
 namespace qrk
 {
@@ -76,8 +80,43 @@ public:
     bool loadInformation(RangeSensorInformation &informations);
     bool loadInternalInformation(RangeSensorInternalInformation &internalInformations);
 
-    QVector<string> supportedCommands();
-    QStringList supportedModes();
+    //! Wait for and parse the reply of a posted PP, VV or II command
+    bool loadParameter(ScipReply &reply, RangeSensorParameter &parameters);
+    bool loadInformation(ScipReply &reply, RangeSensorInformation &informations);
+    bool loadInternalInformation(ScipReply &reply,
+                                 RangeSensorInternalInformation &internalInformations);
+
+    /*!
+      \brief Send a command without waiting for its reply
+
+      Several commands can be in flight at once. Their replies are read
+      in order by wait() and matched to the commands by echoback.
+
+      \param[in] command Command without its line feed
+    */
+    ScipReply post(const string &command);
+
+    /*!
+      \brief Read replies until \p reply is ready
+
+      \return false when the reply timed out or could not be sent. A
+      timeout fails every command still in flight.
+    */
+    bool wait(ScipReply &reply);
+
+    //! Number of posted commands whose reply was not read yet
+    int pendingReplies(void) const;
+
+    /*!
+      \brief Commands the sensor answers with a status other than 0E/0F
+
+      Commands that reboot the sensor or rewrite its settings (RB, RS, RT,
+      BM, %ST and the $ commands) are never sent, so they are not listed.
+      \p complete is set to false when some command got no answer even
+      when sent alone; the result should not be remembered then.
+    */
+    QVector<string> supportedCommands(bool* complete = NULL);
+    QStringList supportedModes(bool* complete = NULL);
 
     bool commandLines(string &cmd, int &status, QVector<string>* lines = NULL, bool all = false);
     bool commandLines(string &cmd, QVector<string >* lines = NULL, bool all = false);
@@ -98,8 +137,30 @@ public:
                                    CaptureSettings &settings, long &timestamp,
                                    int* remain_times = NULL,
                                    int* total_times = NULL);
+
+    //! Receive a scan straight into the flat arrays of \p scan
+    CaptureType receiveCaptureData(ScanData &scan,
+                                   CaptureSettings &settings, long &timestamp,
+                                   int* remain_times = NULL,
+                                   int* total_times = NULL);
     bool isContiniousMode();
 
+    //! Counters of the link and the capture, safe to read from another thread
+    CaptureStatistics captureStatistics(void) const;
+    void resetCaptureStatistics(void);
+
+    //! Lets the capture queue above the handler record its own events
+    CaptureCounters &captureCounters(void);
+
+    /*!
+      \brief Verify data line checksums after decoding
+
+      A data line with a bad checksum then sets only its own values to 0
+      instead of discarding the whole scan.
+    */
+    void setLazyChecksum(bool on);
+    bool isLazyChecksum(void) const;
+
 private:
     ScipHandler(const ScipHandler &rhs);
     ScipHandler &operator = (const ScipHandler &rhs);
@@ -0,0 +1,93 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef QRK_SCIP_REPLY_H
+#define QRK_SCIP_REPLY_H
+
+/*!
+  \file
+  \brief Pending reply of a pipelined SCIP command
+*/
+
+#include <QSharedPointer>
+#include <QVector>
+#include <string>
+
+
+namespace qrk
+{
+class ScipHandler;
+
+
+/*!
+  \brief Pending reply of a pipelined SCIP command
+
+  Returned by ScipHandler::post() as soon as the command is sent. Copies
+  share the same reply, which becomes ready once ScipHandler::wait()
+  reads the response with the matching echoback.
+*/
+class ScipReply
+{
+public:
+    ScipReply(void) : data_(new Data) {
+    }
+
+    //! Command without its line feed
+    const std::string &command(void) const {
+        return data_->command;
+    }
+
+    bool isReady(void) const {
+        return data_->ready;
+    }
+
+    /*!
+      \brief Status of the reply
+
+      -1 until the reply is ready, then the status of the response, or a
+      negative error code when it timed out or could not be sent.
+    */
+    int status(void) const {
+        return data_->status;
+    }
+
+    //! Lines following the status, without the trailing empty line
+    const QVector<std::string> &lines(void) const {
+        return data_->lines;
+    }
+
+private:
+    friend class ScipHandler;
+
+    struct Data {
+        std::string command;
+        bool ready;
+        int status;
+        QVector<std::string> lines;
+
+        Data(void) : ready(false), status(-1) {
+        }
+    };
+
+    QSharedPointer<Data> data_;
+};
+}
+
+#endif /* !QRK_SCIP_REPLY_H */
@@ -0,0 +1,60 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#include "SerialBaudrate.h"
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+using namespace qrk;
+
+
+namespace
+{
+enum {
+    TolerancePercent = 2,
+};
+}
+
+
+bool qrk::setCustomBaudrate(int fd, long baudrate)
+{
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) < 0) {
+        return false;
+    }
+
+    // 入力側、出力側とも同じボーレートにする
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = baudrate;
+    tio.c_ospeed = baudrate;
+    if (ioctl(fd, TCSETS2, &tio) < 0) {
+        return false;
+    }
+
+    // ドライバが近い値に丸めることがあるので、設定された値を確認する
+    if (ioctl(fd, TCGETS2, &tio) < 0) {
+        return false;
+    }
+    long difference = static_cast<long>(tio.c_ospeed) - baudrate;
+    if (difference < 0) {
+        difference = -difference;
+    }
+    return difference * 100 <= baudrate * TolerancePercent;
+}
@@ -47,17 +47,22 @@ struct SerialDevice::pImpl {
 
 
     void updateRingBuffer(void) {
-        enum { BufferSize = 65535 };
-        char buffer[BufferSize];
-
-        unsigned long maxLength = raw_.receivedSize();
-        if(maxLength > BufferSize) maxLength = BufferSize;
+        // 受信済みのデータを、リングバッファの空き領域に直接読み込む
+        // 空き領域が折り返している場合は 2 回に分けて読み込む
+        for (int i = 0; i < 2; ++i) {
+            unsigned long maxLength = raw_.receivedSize();
+            char* span;
+            size_t free_size = ring_buffer_.writeSpan(&span);
+            if(maxLength > free_size) maxLength = free_size;
+            if(maxLength == 0){
+                break;
+            }
 
-        if(maxLength > 0){
-            int n = raw_.receive(buffer, maxLength, 1);
-            if (n > 0) {
-                ring_buffer_.put(buffer, n);
+            int n = raw_.receive(span, maxLength, 1);
+            if (n <= 0) {
+                break;
             }
+            ring_buffer_.commit(n);
         }
     }
 
@@ -79,12 +84,10 @@ struct SerialDevice::pImpl {
         }
 
         // バッファにデータがある場合、バッファからデータを格納する
-        size_t read_size = qMin(count, ring_buffer_.size());
-        ring_buffer_.get(data, read_size);
-        filled += read_size;
+        filled += ring_buffer_.get(data, count);
 
         // バッファが空の場合、残りのデータはシステムから直接読み込む
-        read_size = qMax(0, static_cast<int>(count - filled));
+        size_t read_size = qMax(0, static_cast<int>(count - filled));
         if (read_size > 0) {
             int n = raw_.receive(&data[filled],
                                  static_cast<int>(read_size), timeout);
@@ -236,6 +239,11 @@ void SerialDevice::ungetc(const char ch)
     pimpl->ring_buffer_.ungetc(ch);
 }
 
+int SerialDevice::nativeHandle(void) const
+{
+    return pimpl->raw_.handle();
+}
+
 QString SerialDevice::getDevice()
 {
     return m_device;
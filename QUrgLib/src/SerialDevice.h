@@ -59,6 +59,7 @@ public:
     void clear(void);
     void ungetc(const char ch);
     ConnectionType connectionType() {return SERIAL_TYPE;}
+    int nativeHandle(void) const;
 
     QString getDevice();
 
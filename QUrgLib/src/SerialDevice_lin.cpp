@@ -27,6 +27,9 @@
 #include <cerrno>
 #include <cstring>
 #include <cstdio>
+#if defined(Q_OS_LINUX)
+#include "SerialBaudrate.h"
+#endif
 
 
 class RawSerialDevice
@@ -114,6 +117,11 @@ public:
     }
 
 
+    int handle(void) const {
+        return fd_;
+    }
+
+
     bool setBaudrate(long baudrate) {
         long baudrate_value = -1;
         enum { ErrorMessageSize = 256 };
@@ -145,7 +153,59 @@ public:
             baudrate_value = B115200;
             break;
 
+#ifdef B230400
+        case 230400:
+            baudrate_value = B230400;
+            break;
+#endif
+
+#ifdef B460800
+        case 460800:
+            baudrate_value = B460800;
+            break;
+#endif
+
+#ifdef B500000
+        case 500000:
+            baudrate_value = B500000;
+            break;
+#endif
+
+#ifdef B921600
+        case 921600:
+            baudrate_value = B921600;
+            break;
+#endif
+
+#ifdef B1000000
+        case 1000000:
+            baudrate_value = B1000000;
+            break;
+#endif
+
+#ifdef B1500000
+        case 1500000:
+            baudrate_value = B1500000;
+            break;
+#endif
+
+#ifdef B2000000
+        case 2000000:
+            baudrate_value = B2000000;
+            break;
+#endif
+
         default:
+#if defined(Q_OS_LINUX)
+            // 定数のないボーレートは termios2 で設定する
+            if (baudrate > 0) {
+                tcsetattr(fd_, TCSANOW, &sio_);
+                if (qrk::setCustomBaudrate(fd_, baudrate)) {
+                    flush();
+                    return true;
+                }
+            }
+#endif
             sprintf(error_message, "No handle baudrate value: %ld", baudrate);
             error_message_ = string(error_message);
             return false;
@@ -110,6 +110,12 @@ public:
         return (hCom_ == INVALID_HANDLE_VALUE) ? false : true;
     }
 
+
+    int handle(void) const {
+        // HANDLE は select() や poll() で待てない
+        return -1;
+    }
+
     bool setBaudrate(long baudrate) {
         DCB dcb;
         GetCommState(hCom_, &dcb);
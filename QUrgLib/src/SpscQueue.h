@@ -0,0 +1,127 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef QRK_SPSC_QUEUE_H
+#define QRK_SPSC_QUEUE_H
+
+/*!
+  \file
+  \brief Lock-free single-producer/single-consumer queue
+*/
+
+#include <QAtomicInt>
+#include <QVector>
+#include <cstddef>
+
+
+namespace qrk
+{
+/*!
+  \brief Lock-free single-producer/single-consumer queue
+
+  Bounded queue where push() is called from one thread only and pop()
+  from one other thread only. Neither side takes a lock nor allocates.
+*/
+template <class T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+        : buffer_(static_cast<int>(capacity) + 1), head_(0), tail_(0) {
+    }
+
+
+    //! Queue capacity
+    size_t capacity(void) const {
+        return buffer_.size() - 1;
+    }
+
+
+    //! Number of queued items, approximate while the other side works
+    size_t size(void) const {
+        int head = head_.loadAcquire();
+        int tail = tail_.loadAcquire();
+        return (tail >= head) ? (tail - head) : (tail + buffer_.size() - head);
+    }
+
+
+    bool empty(void) const {
+        return head_.loadAcquire() == tail_.loadAcquire();
+    }
+
+
+    /*!
+      \brief Add an item, producer side
+
+      \retval true Queued
+      \retval false The queue is full
+    */
+    bool push(const T &value) {
+        int tail = tail_.loadAcquire();
+        int next = increment(tail);
+        if (next == head_.loadAcquire()) {
+            return false;
+        }
+        buffer_[tail] = value;
+        tail_.storeRelease(next);
+        return true;
+    }
+
+
+    /*!
+      \brief Take the oldest item, consumer side
+
+      \retval true An item was taken
+      \retval false The queue is empty
+    */
+    bool pop(T &value) {
+        int head = head_.loadAcquire();
+        if (head == tail_.loadAcquire()) {
+            return false;
+        }
+        value = buffer_[head];
+        head_.storeRelease(increment(head));
+        return true;
+    }
+
+private:
+    SpscQueue(const SpscQueue &rhs);
+    SpscQueue &operator = (const SpscQueue &rhs);
+
+    enum {
+        CacheLineSize = 64,
+    };
+
+    int increment(int index) const {
+        return (index + 1 == buffer_.size()) ? 0 : (index + 1);
+    }
+
+    QVector<T> buffer_;
+
+    // Indexes written by different threads are kept on different cache lines
+    char head_padding_[CacheLineSize];
+    QAtomicInt head_;               //!< Next item to pop, written by the consumer
+    char tail_padding_[CacheLineSize];
+    QAtomicInt tail_;               //!< Next slot to push, written by the producer
+    char end_padding_[CacheLineSize];
+};
+}
+
+#endif /* !QRK_SPSC_QUEUE_H */
@@ -25,6 +25,7 @@
 #include <fcntl.h>
 #include <cerrno>
 #include <sys/ioctl.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 #include <stdio.h>
@@ -34,11 +35,22 @@
 using namespace std;
 using namespace qrk;
 
+namespace
+{
+#if defined(MSG_NOSIGNAL)
+// 相手が切断した後に送っても、SIGPIPE でプロセスを止めない
+const int SendFlags = MSG_NOSIGNAL;
+#else
+const int SendFlags = 0;
+#endif
+}
+
 TcpDevice::TcpDevice()
     : is_connected(false)
     , error_message("No errors.")
     , sock_desc(Invalid_desc)
     , recieveBufferSize(65535)
+    , recv_timeout(Unset_timeout)
     , m_baudrate(10940)
 {
 }
@@ -156,17 +168,23 @@ bool TcpDevice::connect(const char* host, long port)
         }
     }
     set_block_mode();
-
-    ::setsockopt(sock_desc, SOL_SOCKET, SO_RCVBUF,
-                 (const char*)&recieveBufferSize, sizeof(int));
+    set_recieve_buffer_size();
 
 #ifdef DEBUG
     cout << "Socket connect: " << timer.elapsed() << "ms" << endl;
 #endif
 
 #else
+#if defined(SO_NOSIGPIPE)
+    // MSG_NOSIGNAL のない macOS では、ソケットに設定する
+    int no_sigpipe = 1;
+    setsockopt(sock_desc, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+    // 受信は poll() で待つので、ソケットはノンブロッキングのまま使う
     flag = fcntl(sock_desc, F_GETFL, 0);
     fcntl(sock_desc, F_SETFL, flag | O_NONBLOCK);
+    set_recieve_buffer_size();
     //    //TODO: check this
     //    setsockopt(sock_desc, SOL_SOCKET, SO_REUSEADDR, NULL, 1);
 
@@ -200,11 +218,10 @@ bool TcpDevice::connect(const char* host, long port)
             error_message = "Connection to socket failed.";
             return false;
         }
-
-        set_block_mode();
     }
 #endif
 
+    recv_timeout = Unset_timeout;
     is_connected = true;
     m_device = QString::fromLatin1(host);
     m_baudrate = port;
@@ -248,14 +265,51 @@ bool TcpDevice::isConnected() const
     return is_connected;
 }
 
+int TcpDevice::nativeHandle() const
+{
+    return sock_desc;
+}
+
 int TcpDevice::send(const char* data, size_t count)
 {
+#if defined(Q_OS_WIN)
     /////////////////// To change
     // blocking if data size is larger than system's buffer.
     int sent = ::send(sock_desc, data, count, 0);  //4th arg 0: no flag
     /////////////////////////////////////////
+#else
+    // ノンブロッキングなので、送信バッファが空くのを待って残りを送る
+    int sent = 0;
+    while (sent < static_cast<int>(count)) {
+        int n = ::send(sock_desc, data + sent, count - sent, SendFlags);
+        if (n >= 0) {
+            sent += n;
+            continue;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            break;
+        }
+
+        struct pollfd fds;
+        fds.fd = sock_desc;
+        fds.events = POLLOUT;
+        fds.revents = 0;
+        if (::poll(&fds, 1, Send_timeout_msec) <= 0) {
+            break;
+        }
+    }
+    if ((sent == 0) && (count > 0)) {
+        error_message = "Send failed.";
+        return -1;
+    }
+#endif
 
-    dataSent(QByteArray(data, sent));
+    if (sent > 0) {
+        dataSent(QByteArray(data, sent));
+    }
 
     return sent;
 }
@@ -277,12 +331,10 @@ int TcpDevice::receive(char* data, size_t count, int timeout)
     }
 
     // バッファにデータがある場合、バッファからデータを格納する
-    size_t read_size = qMin(count, ring_buffer_.size());
-    ring_buffer_.get(data, read_size);
-    filled += read_size;
+    filled += ring_buffer_.get(data, count);
 
     // バッファが空の場合、残りのデータはシステムから直接読み込む
-    read_size = qMax(0, static_cast<int>(count - filled));
+    size_t read_size = qMax(0, static_cast<int>(count - filled));
     if (read_size > 0) {
         int n = rawReceive(&data[filled],
                            static_cast<int>(read_size), timeout);
@@ -296,34 +348,57 @@ int TcpDevice::receive(char* data, size_t count, int timeout)
 
 int TcpDevice::rawReceive(char* data, size_t count, int timeout)
 {
-
-#if defined(Q_OS_WIN)
-    DWORD tv = timeout;
-#else
-    struct timeval tv;
-    tv.tv_sec = timeout / 1000; // millisecond to seccond
-    tv.tv_usec = (timeout % 1000) * 1000; // millisecond to microsecond
-#endif
-    if (setsockopt(sock_desc, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv,  sizeof(tv))) {
-        perror("setsockopt");
-    }
-
     if (count == 0) {
         return 0;
     }
 
-    int result = ::recv(sock_desc, data, count, 0);
+#if defined(Q_OS_WIN)
+    // タイムアウトが前回と同じときは設定し直さない
+    if (timeout != recv_timeout) {
+        DWORD tv = timeout;
+        if (setsockopt(sock_desc, SOL_SOCKET, SO_RCVTIMEO, (char*)&tv,  sizeof(tv))) {
+            perror("setsockopt");
+        }
+        recv_timeout = timeout;
+    }
 
+    return ::recv(sock_desc, data, count, 0);
+#else
+    // 受信済みのデータがなければ poll() で待ってから読み込む
+    int result = ::recv(sock_desc, data, count, 0);
+    if ((result < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) &&
+        (timeout != 0)) {
+        struct pollfd fds;
+        fds.fd = sock_desc;
+        fds.events = POLLIN;
+        fds.revents = 0;
+
+        int ret;
+        do {
+            ret = ::poll(&fds, 1, timeout);
+        } while ((ret < 0) && (errno == EINTR));
+
+        if (ret > 0) {
+            result = ::recv(sock_desc, data, count, 0);
+        }
+    }
     return result;
+#endif
 }
 
 unsigned long TcpDevice::rawLength()
 {
-    unsigned long length = 4094;
 #if defined(Q_OS_WIN)
+    unsigned long length = 0;
     ::ioctlsocket(sock_desc, FIONREAD, &length);
-#endif
     return length;
+#else
+    int length = 0;
+    if (::ioctl(sock_desc, FIONREAD, &length) < 0) {
+        return 0;
+    }
+    return length;
+#endif
 }
 
 size_t TcpDevice::size() const
@@ -374,19 +449,46 @@ int TcpDevice::getRecieveBufferSize() const
 void TcpDevice::setRecieveBufferSize(int value)
 {
     recieveBufferSize = value;
+    if (sock_desc != Invalid_desc) {
+        set_recieve_buffer_size();
+    }
 }
 
-void TcpDevice::updateRingBuffer(void) {
-    enum { BufferSize = 65535 };
-    char buffer[BufferSize];
+void TcpDevice::set_recieve_buffer_size()
+{
+    if (::setsockopt(sock_desc, SOL_SOCKET, SO_RCVBUF,
+                     (const char*)&recieveBufferSize, sizeof(int))) {
+        perror("setsockopt");
+    }
+}
 
-    unsigned long maxLength = rawLength();
-    if(maxLength > BufferSize) maxLength = BufferSize;
+void TcpDevice::updateRingBuffer(void) {
+    // 受信済みのデータを、リングバッファの空き領域に直接読み込む
+    // 空き領域が折り返している場合は 2 回に分けて読み込む
+    for (int i = 0; i < 2; ++i) {
+        char* span;
+        size_t free_size = ring_buffer_.writeSpan(&span);
+        if (free_size == 0) {
+            break;
+        }
 
-    if(maxLength > 0){
-        int n = rawReceive(buffer, maxLength, 1);
-        if (n > 0) {
-            ring_buffer_.put(buffer, n);
+#if defined(Q_OS_WIN)
+        unsigned long maxLength = rawLength();
+        if(maxLength > free_size) maxLength = free_size;
+        if(maxLength == 0){
+            break;
+        }
+        int n = rawReceive(span, maxLength, 1);
+#else
+        // ノンブロッキングなので、待たずに受信済みの分をまとめて読み込む
+        int n = rawReceive(span, free_size, 0);
+#endif
+        if (n <= 0) {
+            break;
+        }
+        ring_buffer_.commit(n);
+        if (static_cast<size_t>(n) < free_size) {
+            break;
         }
     }
 }
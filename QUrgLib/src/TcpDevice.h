@@ -65,6 +65,7 @@ public:
     void ungetc(const char ch);
 
     ConnectionType connectionType() { return ETHERNET_TYPE;}
+    int nativeHandle(void) const;
 
     QString getDevice();
 
@@ -82,13 +83,17 @@ private:
     ///////////////////////To change
     enum {
         Invalid_desc = -1,
+        Unset_timeout = -2,
+        Send_timeout_msec = 1000,
     };
     struct sockaddr_in server_addr;
     int sock_desc;
     int recieveBufferSize;
+    int recv_timeout;
 
 
     void set_block_mode();
+    void set_recieve_buffer_size();
     //////////////////////////////////////////////
     int rawReceive(char *data, size_t count, int timeout);
     unsigned long rawLength();
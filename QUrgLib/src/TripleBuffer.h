@@ -0,0 +1,121 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_TRIPLE_BUFFER_H
+#define QRK_TRIPLE_BUFFER_H
+
+/*!
+  \file
+  \brief Latest-value-wins triple buffer
+*/
+
+#include <QAtomicInt>
+#include <cstddef>
+
+
+namespace qrk
+{
+/*!
+  \brief Latest-value-wins triple buffer
+
+  One producer fills back() and publishes it, one consumer takes the
+  newest published value with update() and reads front(). Values the
+  consumer never took are overwritten and counted as superseded, so
+  memory stays at three values and the consumer is at most one value
+  behind.
+*/
+template <class T>
+class TripleBuffer
+{
+public:
+    TripleBuffer(void)
+        : back_(0), middle_(1), front_(2), superseded_(0) {
+    }
+
+
+    //! Buffer by index, only while neither side is running
+    T &slot(size_t index) {
+        return buffers_[index];
+    }
+
+
+    //! Buffer being filled, producer side
+    T &back(void) {
+        return buffers_[back_];
+    }
+
+
+    //! Hand back() over to the consumer, producer side
+    void publish(void) {
+        int previous = middle_.fetchAndStoreOrdered(back_ | FreshBit);
+        if (previous & FreshBit) {
+            superseded_.ref();
+        }
+        back_ = previous & IndexMask;
+    }
+
+
+    /*!
+      \brief Take the newest published value into front(), consumer side
+
+      \retval true front() was replaced
+      \retval false Nothing was published since the last update
+    */
+    bool update(void) {
+        if (! (middle_.loadAcquire() & FreshBit)) {
+            return false;
+        }
+        front_ = middle_.fetchAndStoreOrdered(front_) & IndexMask;
+        return true;
+    }
+
+
+    //! Value taken by the last update(), consumer side
+    const T &front(void) const {
+        return buffers_[front_];
+    }
+
+
+    //! Published values overwritten before the consumer took them
+    size_t superseded(void) const {
+        return superseded_.loadAcquire();
+    }
+
+private:
+    TripleBuffer(const TripleBuffer &rhs);
+    TripleBuffer &operator = (const TripleBuffer &rhs);
+
+    enum {
+        IndexMask = 0x3,
+        FreshBit = 0x4,
+        CacheLineSize = 64,
+    };
+
+    T buffers_[3];
+
+    int back_;                  //!< Written by the producer only
+    char middle_padding_[CacheLineSize];
+    QAtomicInt middle_;         //!< Shared index, FreshBit set until taken
+    char front_padding_[CacheLineSize];
+    int front_;                 //!< Written by the consumer only
+    QAtomicInt superseded_;
+};
+}
+
+#endif /* !QRK_TRIPLE_BUFFER_H */
@@ -0,0 +1,356 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#include "UbhIndex.h"
+#include <QFileInfo>
+#include <QtEndian>
+#include <climits>
+#include <cstring>
+
+using namespace qrk;
+
+
+namespace
+{
+const char Magic[8] = { 'U', 'B', 'H', 'I', 'D', 'X', '0', '1' };
+const char TimestampKey[] = "[timestamp]";
+
+enum {
+    Version = 1,
+    HeaderSize = 64,
+    EntrySize = 16,
+
+    VersionOffset = 8,
+    EntrySizeOffset = 12,
+    CountOffset = 16,
+    LogSizeOffset = 24,
+    HeaderSizeOffset = 32,
+    ChecksumOffset = 40,
+};
+
+
+quint64 read64(const uchar* data)
+{
+    return qFromLittleEndian<quint64>(data);
+}
+
+
+void write64(uchar* data, quint64 value)
+{
+    qToLittleEndian<quint64>(value, data);
+}
+}
+
+
+UbhIndex::UbhIndex(void)
+    : mapped_(NULL), mapped_size_(0), written_(0), header_size_(0),
+      header_checksum_(0), header_known_(false)
+{
+}
+
+
+UbhIndex::~UbhIndex(void)
+{
+    clear();
+    finish();
+}
+
+
+QString UbhIndex::fileName(const QString &log_file)
+{
+    return log_file + ".idx";
+}
+
+
+quint64 UbhIndex::checksum(const char* data, qint64 size)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (qint64 i = 0; i < size; ++i) {
+        hash ^= static_cast<uchar>(data[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+
+int UbhIndex::size(void) const
+{
+    return mapped_ ? mapped_size_ : entries_.size();
+}
+
+
+bool UbhIndex::isEmpty(void) const
+{
+    return size() == 0;
+}
+
+
+qint64 UbhIndex::offset(int index) const
+{
+    if (mapped_) {
+        return static_cast<qint64>(read64(&mapped_[index * EntrySize]));
+    }
+    return entries_[index].offset;
+}
+
+
+long UbhIndex::timestamp(int index) const
+{
+    if (mapped_) {
+        return static_cast<long>(read64(&mapped_[index * EntrySize + 8]));
+    }
+    return static_cast<long>(entries_[index].timestamp);
+}
+
+
+bool UbhIndex::isMapped(void) const
+{
+    return mapped_ != NULL;
+}
+
+
+void UbhIndex::clear(void)
+{
+    entries_.clear();
+    if (mapped_) {
+        file_.unmap(const_cast<uchar*>(mapped_) - HeaderSize);
+        file_.close();
+        mapped_ = NULL;
+        mapped_size_ = 0;
+    }
+}
+
+
+void UbhIndex::append(qint64 offset, long timestamp)
+{
+    Entry entry;
+    entry.offset = offset;
+    entry.timestamp = timestamp;
+    entries_.append(entry);
+}
+
+
+void UbhIndex::reserve(int size)
+{
+    entries_.reserve(size);
+}
+
+
+bool UbhIndex::load(const QString &log_file)
+{
+    clear();
+    finish();
+
+    file_.setFileName(fileName(log_file));
+    if (! file_.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    qint64 file_size = file_.size();
+    uchar header[HeaderSize];
+    if ((file_size < HeaderSize) ||
+            (file_.read(reinterpret_cast<char*>(header), HeaderSize) != HeaderSize) ||
+            memcmp(header, Magic, sizeof(Magic)) ||
+            (qFromLittleEndian<quint32>(&header[VersionOffset]) != Version) ||
+            (qFromLittleEndian<quint32>(&header[EntrySizeOffset]) != EntrySize)) {
+        file_.close();
+        return false;
+    }
+
+    // 書き込み途中で終わった索引は、件数とファイルサイズが合わない
+    quint64 count = read64(&header[CountOffset]);
+    qint64 log_size = static_cast<qint64>(read64(&header[LogSizeOffset]));
+    qint64 header_size = static_cast<qint64>(read64(&header[HeaderSizeOffset]));
+    quint64 header_checksum = 0;
+    if ((count > static_cast<quint64>(INT_MAX / EntrySize)) ||
+            (static_cast<quint64>(file_size) != HeaderSize + count * EntrySize) ||
+            (QFileInfo(log_file).size() != log_size) ||
+            ! readHeader(log_file, header_size, header_checksum) ||
+            (header_checksum != read64(&header[ChecksumOffset]))) {
+        file_.close();
+        return false;
+    }
+
+    uchar* data = file_.map(0, file_size);
+    if (! data) {
+        file_.close();
+        return false;
+    }
+    mapped_ = data + HeaderSize;
+    mapped_size_ = static_cast<int>(count);
+
+    // 先頭と末尾の記録が "[timestamp]" 行を指していることを確かめる
+    QFile log(log_file);
+    if ((mapped_size_ > 0) &&
+            ! (log.open(QIODevice::ReadOnly) &&
+               matchesRecord(log, offset(0)) &&
+               matchesRecord(log, offset(mapped_size_ - 1)))) {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+
+bool UbhIndex::save(const QString &log_file)
+{
+    if (mapped_ || entries_.isEmpty()) {
+        return false;
+    }
+
+    // create() は保持している記録を消すので、先に取り出しておく
+    QVector<Entry> entries = entries_;
+    if (! create(log_file)) {
+        entries_ = entries;
+        return false;
+    }
+    for (int i = 0; i < entries.size(); ++i) {
+        write(entries[i].offset, static_cast<long>(entries[i].timestamp));
+    }
+    bool result = commit(QFileInfo(log_file).size());
+    finish();
+    entries_ = entries;
+
+    if (! result) {
+        QFile::remove(fileName(log_file));
+    }
+    return result;
+}
+
+
+bool UbhIndex::create(const QString &log_file)
+{
+    clear();
+    finish();
+
+    file_.setFileName(fileName(log_file));
+    if (! file_.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        return false;
+    }
+
+    // 件数 0 の索引は、どのログとも一致しない
+    uchar header[HeaderSize];
+    memset(header, 0, sizeof(header));
+    memcpy(header, Magic, sizeof(Magic));
+    qToLittleEndian<quint32>(Version, &header[VersionOffset]);
+    qToLittleEndian<quint32>(EntrySize, &header[EntrySizeOffset]);
+    write64(&header[LogSizeOffset], Q_UINT64_C(0xffffffffffffffff));
+    if (file_.write(reinterpret_cast<const char*>(header), HeaderSize) != HeaderSize) {
+        file_.close();
+        return false;
+    }
+    log_file_ = log_file;
+    written_ = 0;
+    header_size_ = 0;
+    header_checksum_ = 0;
+    header_known_ = false;
+    return true;
+}
+
+
+void UbhIndex::write(qint64 offset, long timestamp)
+{
+    if (! file_.isOpen() || mapped_) {
+        return;
+    }
+
+    uchar entry[EntrySize];
+    write64(&entry[0], static_cast<quint64>(offset));
+    write64(&entry[8], static_cast<quint64>(static_cast<qint64>(timestamp)));
+    if (file_.write(reinterpret_cast<const char*>(entry), EntrySize) == EntrySize) {
+        if (written_ == 0) {
+            header_size_ = offset;
+        }
+        ++written_;
+    }
+    else {
+        // 書けなかった索引は使わせない
+        finish();
+    }
+}
+
+
+bool UbhIndex::commit(qint64 log_size)
+{
+    if (! isWriting()) {
+        return false;
+    }
+
+    // ヘッダは最初のフレームの前で確定する
+    if ((written_ > 0) && ! header_known_) {
+        if (! readHeader(log_file_, header_size_, header_checksum_)) {
+            return false;
+        }
+        header_known_ = true;
+    }
+
+    uchar header[HeaderSize - CountOffset];
+    memset(header, 0, sizeof(header));
+    write64(&header[CountOffset - CountOffset], written_);
+    write64(&header[LogSizeOffset - CountOffset], log_size);
+    write64(&header[HeaderSizeOffset - CountOffset], header_size_);
+    write64(&header[ChecksumOffset - CountOffset], header_checksum_);
+
+    qint64 end = file_.pos();
+    bool result = file_.seek(CountOffset) &&
+            (file_.write(reinterpret_cast<const char*>(header), sizeof(header)) ==
+             static_cast<qint64>(sizeof(header))) &&
+            file_.seek(end) && file_.flush();
+    return result;
+}
+
+
+bool UbhIndex::isWriting(void) const
+{
+    return file_.isOpen() && ! mapped_;
+}
+
+
+void UbhIndex::finish(void)
+{
+    if (isWriting()) {
+        file_.close();
+    }
+    written_ = 0;
+}
+
+
+bool UbhIndex::readHeader(const QString &log_file, qint64 header_size,
+                          quint64 &header_checksum)
+{
+    // テキストモードでは改行が変換されるので、バイナリのまま読む
+    QFile log(log_file);
+    if ((header_size < 0) || ! log.open(QIODevice::ReadOnly) ||
+            (header_size > log.size())) {
+        return false;
+    }
+    QByteArray header = log.read(header_size);
+    if (header.size() != header_size) {
+        return false;
+    }
+    header_checksum = checksum(header.constData(), header_size);
+    return true;
+}
+
+
+bool UbhIndex::matchesRecord(QFile &log, qint64 offset) const
+{
+    int size = static_cast<int>(sizeof(TimestampKey)) - 1;
+    return log.seek(offset) && (log.read(size) == QByteArray(TimestampKey, size));
+}
@@ -0,0 +1,148 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_UBH_INDEX_H
+#define QRK_UBH_INDEX_H
+
+/*!
+  \file
+  \brief Frame index of a UBH log, kept in a sidecar file
+*/
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+
+namespace qrk
+{
+/*!
+  \brief Frame index of a UBH log
+
+  Holds the file offset and the timestamp of every "[timestamp]" record
+  of a log. The index is either built in memory while scanning the log,
+  or mapped read-only from the "<log>.idx" sidecar file, so that opening
+  a large log does not read it.
+
+  The sidecar file is a 64 bytes header followed by one 16 bytes entry
+  per frame, all little endian:
+
+  - "UBHIDX01", version, entry size
+  - frame count, log size, header size, header checksum
+  - entries: offset of the "[timestamp]" line, timestamp
+
+  It is only used when the log size and the checksum of the log header
+  (the bytes before the first frame) still match.
+*/
+class UbhIndex
+{
+public:
+    UbhIndex(void);
+    ~UbhIndex(void);
+
+    //! Sidecar file name of \p log_file
+    static QString fileName(const QString &log_file);
+
+    //! FNV-1a checksum of the log header
+    static quint64 checksum(const char* data, qint64 size);
+
+
+    int size(void) const;
+    bool isEmpty(void) const;
+    qint64 offset(int index) const;
+    long timestamp(int index) const;
+
+    //! true if the entries come from the sidecar file
+    bool isMapped(void) const;
+
+
+    //! Drop every entry and unmap the sidecar file
+    void clear(void);
+
+    //! Add an entry in memory
+    void append(qint64 offset, long timestamp);
+
+    void reserve(int size);
+
+
+    /*!
+      \brief Map the sidecar file of \p log_file
+
+      \retval false if the sidecar file is missing or does not match the log
+    */
+    bool load(const QString &log_file);
+
+
+    //! Write the entries held in memory to the sidecar file
+    bool save(const QString &log_file);
+
+
+    /*!
+      \brief Start the sidecar file of a log being written
+
+      Entries given to write() go straight to the file; the header is
+      completed by commit().
+    */
+    bool create(const QString &log_file);
+
+    //! Append an entry to the sidecar file being written
+    void write(qint64 offset, long timestamp);
+
+    /*!
+      \brief Update the header of the sidecar file being written
+
+      The log header is read back from the log file once the first frame
+      is written, so the log must be flushed up to \p log_size.
+
+      \param[in] log_size Bytes of the log written so far
+    */
+    bool commit(qint64 log_size);
+
+    bool isWriting(void) const;
+
+    //! Close the sidecar file being written
+    void finish(void);
+
+private:
+    UbhIndex(const UbhIndex &rhs);
+    UbhIndex &operator = (const UbhIndex &rhs);
+
+    struct Entry {
+        qint64 offset;
+        qint64 timestamp;
+    };
+
+    static bool readHeader(const QString &log_file, qint64 header_size,
+                           quint64 &header_checksum);
+    bool matchesRecord(QFile &log, qint64 offset) const;
+
+    QVector<Entry> entries_;
+    QFile file_;
+    const uchar* mapped_;       //!< Entries of the mapped sidecar file
+    int mapped_size_;
+
+    QString log_file_;          //!< Log of the sidecar file being written
+    int written_;
+    qint64 header_size_;
+    quint64 header_checksum_;
+    bool header_known_;
+};
+}
+
+#endif /* !QRK_UBH_INDEX_H */
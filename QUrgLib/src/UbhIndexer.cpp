@@ -0,0 +1,294 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#include "UbhIndexer.h"
+#include "UbhIndex.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <cstring>
+
+using namespace qrk;
+
+
+namespace
+{
+const char TimestampKey[] = "[timestamp]";
+
+enum {
+    KeySize = sizeof(TimestampKey) - 1,
+    MinimumRangeSize = 16 * 1024 * 1024,
+    RangesPerThread = 4,
+    BlockSize = 1024 * 1024,
+
+    // 記録の先頭がブロックの末尾にあっても、時刻の行まで読めるだけの余裕
+    Overlap = 64,
+};
+
+
+class RangeTask : public QRunnable
+{
+public:
+    RangeTask(UbhIndexer* indexer, UbhIndexer::Range* range)
+        : indexer_(indexer), range_(range) {
+    }
+
+    void run(void) {
+        indexer_->scan(*range_);
+    }
+
+private:
+    UbhIndexer* indexer_;
+    UbhIndexer::Range* range_;
+};
+
+
+bool isSpace(char ch)
+{
+    return (ch == ' ') || (ch == '\t') || (ch == '\r') || (ch == '\n');
+}
+
+
+// QString::toLong() と同じく、数値として読めない行は 0 とする
+qint64 parseTimestamp(const char* first, const char* last)
+{
+    while ((first < last) && isSpace(*first)) {
+        ++first;
+    }
+    while ((last > first) && isSpace(last[-1])) {
+        --last;
+    }
+
+    bool negative = false;
+    if ((first < last) && ((*first == '-') || (*first == '+'))) {
+        negative = (*first == '-');
+        ++first;
+    }
+    if (first == last) {
+        return 0;
+    }
+
+    qint64 value = 0;
+    for (; first < last; ++first) {
+        if ((*first < '0') || (*first > '9')) {
+            return 0;
+        }
+        value = (value * 10) + (*first - '0');
+    }
+    return negative ? -value : value;
+}
+}
+
+
+UbhIndexer::UbhIndexer(const QString &log_file)
+    : log_file_(log_file), size_(0), range_size_(MinimumRangeSize),
+      block_size_(BlockSize), scanned_(0), canceled_(0)
+{
+}
+
+
+UbhIndexer::~UbhIndexer(void)
+{
+    cancel();
+    pool_.waitForDone();
+}
+
+
+void UbhIndexer::setThreadCount(int threads)
+{
+    pool_.setMaxThreadCount(qMax(threads, 1));
+}
+
+
+void UbhIndexer::setRangeSize(qint64 bytes)
+{
+    range_size_ = qMax(bytes, static_cast<qint64>(1));
+}
+
+
+void UbhIndexer::setBlockSize(int bytes)
+{
+    block_size_ = qMax(bytes, 1);
+}
+
+
+bool UbhIndexer::start(void)
+{
+    QFileInfo info(log_file_);
+    if (! info.exists()) {
+        return false;
+    }
+    size_ = info.size();
+    scanned_.store(0);
+    canceled_.store(0);
+
+    // 小さいファイルは分けず、大きいファイルはスレッド数より多く分けて負荷を均す
+    qint64 count = qMin(static_cast<qint64>(pool_.maxThreadCount()) * RangesPerThread,
+                        size_ / range_size_);
+    count = qMax(count, static_cast<qint64>(1));
+
+    ranges_.clear();
+    ranges_.resize(static_cast<int>(count));
+    for (int i = 0; i < ranges_.size(); ++i) {
+        ranges_[i].begin = size_ * i / count;
+        ranges_[i].end = size_ * (i + 1) / count;
+    }
+
+    for (int i = 0; i < ranges_.size(); ++i) {
+        pool_.start(new RangeTask(this, &ranges_[i]));
+    }
+    return true;
+}
+
+
+bool UbhIndexer::waitForDone(int msecs)
+{
+    return pool_.waitForDone(msecs);
+}
+
+
+int UbhIndexer::progress(void) const
+{
+    if (size_ <= 0) {
+        return 100;
+    }
+    return static_cast<int>(scanned_.load() * 100 / size_);
+}
+
+
+void UbhIndexer::cancel(void)
+{
+    canceled_.store(1);
+}
+
+
+bool UbhIndexer::isCanceled(void) const
+{
+    return canceled_.load() != 0;
+}
+
+
+bool UbhIndexer::hasTruncatedRecord(void) const
+{
+    for (int i = 0; i < ranges_.size(); ++i) {
+        if (ranges_[i].truncated) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool UbhIndexer::hasReadError(void) const
+{
+    for (int i = 0; i < ranges_.size(); ++i) {
+        if (ranges_[i].read_error) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool UbhIndexer::fill(UbhIndex &index) const
+{
+    index.clear();
+    if (isCanceled()) {
+        return false;
+    }
+
+    int total = 0;
+    for (int i = 0; i < ranges_.size(); ++i) {
+        total += ranges_[i].offsets.size();
+    }
+    index.reserve(total);
+
+    for (int i = 0; i < ranges_.size(); ++i) {
+        const Range &range = ranges_[i];
+        for (int j = 0; j < range.offsets.size(); ++j) {
+            index.append(range.offsets[j], static_cast<long>(range.timestamps[j]));
+        }
+    }
+    return ! hasReadError();
+}
+
+
+void UbhIndexer::scan(Range &range)
+{
+    QFile file(log_file_);
+    if (! file.open(QIODevice::ReadOnly)) {
+        range.read_error = true;
+        return;
+    }
+
+    // buffer[0] は直前のバイトで、行頭かどうかの判定に使う
+    QByteArray buffer(1 + block_size_ + Overlap, '\0');
+    qint64 position = range.begin;
+    while ((position < range.end) && ! isCanceled()) {
+        qint64 block_end = qMin(position + block_size_, range.end);
+        qint64 read_from = (position > 0) ? (position - 1) : 0;
+        qint64 wanted = qMin(block_end + Overlap, size_) - read_from;
+        if (! file.seek(read_from)) {
+            range.read_error = true;
+            return;
+        }
+        qint64 n = file.read(buffer.data(), wanted);
+        if (n != wanted) {
+            range.read_error = true;
+            return;
+        }
+
+        const char* data = buffer.constData();
+        const char* first = data + (position - read_from);
+        const char* last = data + (block_end - read_from);
+        const char* end = data + n;
+        const char* p = first;
+        while ((p = static_cast<const char*>(memchr(p, '[', last - p))) != NULL) {
+            const char* key = p++;
+            // data[0] が範囲の先頭になるのは、ファイルの先頭だけ
+            bool line_start = (key == data) || (key[-1] == '\n');
+            if (! line_start || (end - key < KeySize) ||
+                    memcmp(key, TimestampKey, KeySize)) {
+                continue;
+            }
+            range.offsets.append(read_from + (key - data));
+
+            // キーの行末から、続く時刻の行を取り出す
+            const char* line = static_cast<const char*>(
+                        memchr(key + KeySize, '\n', end - (key + KeySize)));
+            if (! line || (line + 1 >= end)) {
+                // 時刻のないまま終わった記録も、従来どおり 1 件と数える
+                range.truncated |= (read_from + n == size_);
+                range.timestamps.append(0);
+                continue;
+            }
+            ++line;
+            const char* line_end = static_cast<const char*>(memchr(line, '\n', end - line));
+            if (! line_end) {
+                line_end = end;
+            }
+
+            range.timestamps.append(parseTimestamp(line, line_end));
+        }
+
+        scanned_.fetchAndAddRelaxed(block_end - position);
+        position = block_end;
+    }
+}
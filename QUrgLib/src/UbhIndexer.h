@@ -0,0 +1,126 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_UBH_INDEXER_H
+#define QRK_UBH_INDEXER_H
+
+/*!
+  \file
+  \brief Parallel frame indexer of UBH logs
+*/
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+
+namespace qrk
+{
+class UbhIndex;
+
+
+/*!
+  \brief Parallel frame indexer of UBH logs
+
+  Builds the frame index of a log that has no sidecar index. The file is
+  split into byte ranges scanned on a thread pool: each range is read in
+  raw blocks and searched with memchr() for '[', so data lines are
+  skipped without being decoded. A "[timestamp]" record belongs to the
+  range holding its first byte, and its timestamp line may be read past
+  the end of the range. Ranges are joined in file order by fill().
+
+  \code
+  UbhIndexer indexer(file_name);
+  indexer.start();
+  while (! indexer.waitForDone(100)) {
+      showProgress(indexer.progress());
+  }
+  indexer.fill(index);
+  \endcode
+*/
+class UbhIndexer
+{
+public:
+    explicit UbhIndexer(const QString &log_file);
+    ~UbhIndexer(void);
+
+    //! Number of scanning threads, QThread::idealThreadCount() by default
+    void setThreadCount(int threads);
+
+    //! Smallest byte range given to a thread, 16 [MB] by default
+    void setRangeSize(qint64 bytes);
+
+    //! Bytes read at once within a range, 1 [MB] by default
+    void setBlockSize(int bytes);
+
+    bool start(void);
+
+    //! \retval true when every range was scanned or the scan was canceled
+    bool waitForDone(int msecs = -1);
+
+    //! Scanned part of the file [%]
+    int progress(void) const;
+
+    //! Stop the scan, waitForDone() returns soon after
+    void cancel(void);
+    bool isCanceled(void) const;
+
+    //! A "[timestamp]" record is the last line of the file
+    bool hasTruncatedRecord(void) const;
+
+    //! A range could not be read
+    bool hasReadError(void) const;
+
+    //! Replace the entries of \p index by those found, in file order
+    bool fill(UbhIndex &index) const;
+
+
+    //! Scan of one byte range, run on a pool thread
+    struct Range {
+        qint64 begin;
+        qint64 end;
+        QVector<qint64> offsets;
+        QVector<qint64> timestamps;
+        bool truncated;
+        bool read_error;
+
+        Range(void) : begin(0), end(0), truncated(false), read_error(false) {
+        }
+    };
+
+    void scan(Range &range);
+
+private:
+    UbhIndexer(const UbhIndexer &rhs);
+    UbhIndexer &operator = (const UbhIndexer &rhs);
+
+    QString log_file_;
+    qint64 size_;
+    qint64 range_size_;
+    int block_size_;
+    QVector<Range> ranges_;
+    QThreadPool pool_;
+    QAtomicInteger<qint64> scanned_;
+    QAtomicInt canceled_;
+};
+}
+
+#endif /* !QRK_UBH_INDEXER_H */
@@ -19,6 +19,8 @@
 */
 
 #include <QMutex>
+#include <QSemaphore>
+#include <QThread>
 #include <QDebug>
 #include <QTime>
 #include <QApplication>
@@ -31,6 +33,12 @@
 #include "ConnectionUtils.h"
 #include "SerialDevice.h"
 #include "ScipHandler.h"
+#include "ScipFrameParser.h"
+#include "BaudrateCache.h"
+#include "CommandCache.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "Thread.h"
 #include "RangeSensorParameter.h"
 #include "RangeSensorInformation.h"
 #include "RangeSensorInternalInformation.h"
@@ -64,6 +72,7 @@ namespace
 enum {
     MdScansMax = 100,           // [times]
     NdScansMax = 100,           // [times]
+    AsyncRetryMsec = 10,        // [msec]
 };
 }
 
@@ -75,7 +84,7 @@ struct UrgDevice::pImpl {
         }
 
         virtual string createCaptureCommand(void) = 0;
-        virtual int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) = 0;
+        virtual int capture(ScanData &scan, long &timestamp) = 0;
         virtual void setCapturesSize(size_t size) = 0;
         virtual size_t capturesSize(void) = 0;
         virtual size_t remainCaptureTimes(void) = 0;
@@ -102,7 +111,8 @@ struct UrgDevice::pImpl {
             return buffer;
         }
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
+            QMutexLocker locker(&pimpl_->mutex_);
             pimpl_->scip_.setLaserOutput(ScipHandler::On);
 
             string command = createCaptureCommand();
@@ -114,7 +124,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -126,10 +136,10 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
         void setCapturesSize(size_t size) {
@@ -170,7 +180,8 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
+            QMutexLocker locker(&pimpl_->mutex_);
             pimpl_->scip_.setLaserOutput(ScipHandler::On);
 
             string command = createCaptureCommand();
@@ -182,7 +193,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -194,11 +205,11 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
 
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -242,7 +253,8 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
+            QMutexLocker locker(&pimpl_->mutex_);
             pimpl_->scip_.setLaserOutput(ScipHandler::On);
 
 
@@ -255,7 +267,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -267,10 +279,10 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -314,7 +326,8 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
+            QMutexLocker locker(&pimpl_->mutex_);
             pimpl_->scip_.setLaserOutput(ScipHandler::On);
 
             string command = createCaptureCommand();
@@ -326,7 +339,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -338,10 +351,10 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -390,7 +403,7 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
 
             // Thread syncronization
             QMutexLocker locker(&pimpl_->mutex_);
@@ -406,7 +419,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            CaptureType type = pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            CaptureType type = pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -425,10 +438,10 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -478,7 +491,7 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
 
             QMutexLocker locker(&pimpl_->mutex_);
             if(!pimpl_->scip_.isContiniousMode()){
@@ -493,7 +506,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            CaptureType type = pimpl_->scip_.receiveCaptureData(ranges, levels, settings,timestamp);
+            CaptureType type = pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -512,11 +525,11 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
 
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -569,7 +582,7 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
             QMutexLocker locker(&pimpl_->mutex_);
             if(!pimpl_->scip_.isContiniousMode()){
                 string command = createCaptureCommand();
@@ -583,7 +596,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            CaptureType type = pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            CaptureType type = pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -601,11 +614,11 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
 
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -658,7 +671,7 @@ struct UrgDevice::pImpl {
         }
 
 
-        int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+        int capture(ScanData &scan, long &timestamp) {
             QMutexLocker locker(&pimpl_->mutex_);
             if(!pimpl_->scip_.isContiniousMode()){
                 string command = createCaptureCommand();
@@ -672,7 +685,7 @@ struct UrgDevice::pImpl {
             }
 
             CaptureSettings settings;
-            CaptureType type = pimpl_->scip_.receiveCaptureData(ranges, levels, settings, timestamp);
+            CaptureType type = pimpl_->scip_.receiveCaptureData(scan, settings, timestamp);
 
             if(settings.error_code < 0){
                 pimpl_->error_message_ = "Connection Timeout reached" ;
@@ -691,11 +704,11 @@ struct UrgDevice::pImpl {
                 return -1;
             }
 
-            if (ranges.isEmpty()) {
+            if (scan.isEmpty()) {
                 pimpl_->error_message_ = string("Device capture: ") + pimpl_->scip_.what();
             }
 
-            return static_cast<int>(ranges.size());
+            return scan.steps();
         }
 
 
@@ -744,7 +757,8 @@ struct UrgDevice::pImpl {
     ND_Capture nd_capture_;
     NE_Capture ne_capture_;
     Capture* capture_;
-    QMutex mutex_;
+    QMutex mutex_;              // コマンドとキャプチャのやり取りを直列にする (再帰可)
+    ScanBufferPool scan_pool_;
 
     int capture_begin_;
     int capture_end_;
@@ -756,6 +770,14 @@ struct UrgDevice::pImpl {
     size_t remain_times_;
     bool invalid_packet_;
 
+    Thread async_thread_;
+    SpscQueue<ScanData*>* async_queue_;
+    TripleBuffer<ScanData>* async_latest_;
+    QSemaphore async_available_;
+    QAtomicInt async_dropped_;
+    QAtomicInt async_stopping_;     // 止める間は、取り出し側にキューを触らせない
+    QAtomicInt async_consumers_;    // takeScan(), latestScan() の中にいるスレッド数
+
     //    long base_timestamp_;
     //    long pre_timestamp_;
 
@@ -768,17 +790,21 @@ struct UrgDevice::pImpl {
           hd_capture_(this), he_capture_(this),
           md_capture_(this), me_capture_(this),
           nd_capture_(this), ne_capture_(this),
-          capture_(&gd_capture_),
+          capture_(&gd_capture_), mutex_(QMutex::Recursive),
           capture_begin_(0), capture_end_(0),
           capture_group_steps_(1), capture_skip_frames_(0),
           capture_frame_interval_(0), capture_times_(0),
-          remain_times_(0), invalid_packet_(false)
+          remain_times_(0), invalid_packet_(false),
+          async_thread_(&asyncCaptureProcess, this), async_queue_(NULL),
+          async_latest_(NULL), async_dropped_(0), async_stopping_(0),
+          async_consumers_(0)
         //          base_timestamp_(0), pre_timestamp_(0)
     {
     }
 
 
     ~pImpl(void) {
+        stopAsyncCapture();
         disconnect();
         if(serial_) delete serial_;
     }
@@ -803,32 +829,40 @@ struct UrgDevice::pImpl {
             disconnect();
         }
 
+        QMutexLocker locker(&mutex_);
         scip_.setConnection(con_);
 
         if (! scip_.connect(device, baudrate)) {
             error_message_ = scip_.what();
             return false;
         }
+        // ボーレート探索中の応答ずれやタイムアウトは数えない
+        scip_.resetCaptureStatistics();
 
         return true;
     }
 
     bool loadParameters() {
+        // PP, VV, II を続けて送り、応答をまとめて待つ
+        ScipReply pp = scip_.post("PP");
+        ScipReply vv = scip_.post("VV");
+        ScipReply ii = scip_.post("II");
+
         bool result = true;
 
-        if (loadParameter()){
+        if (loadParameter(&pp)){
             updateCaptureParameters();
         }else{
             error_message_ = "Error loading parameters.";
             result = false;
         }
 
-        if (! loadInformation()) {
+        if (! loadInformation(&vv)) {
             error_message_ = "Error loading information.";
             result = false;
         }
 
-        if (! loadInternalInformation()) {
+        if (! loadInternalInformation(&ii)) {
             error_message_ = "Error loading internal information.";
             result = false;
         }
@@ -836,8 +870,47 @@ struct UrgDevice::pImpl {
         return result;
     }
 
-    void updateSupportedModes() {
-        supportedModes = scip_.supportedModes();
+    QVector<string> supportedCommands() {
+        QString product = QString::fromStdString(informations_.product);
+        QString firmware = QString::fromStdString(informations_.firmware);
+
+        QVector<string> commands;
+        QStringList cached = CommandCache::lookup(product, firmware, "commands");
+        if (! cached.isEmpty()) {
+            for (int i = 0; i < cached.size(); ++i) {
+                commands.push_back(cached[i].toStdString());
+            }
+            return commands;
+        }
+
+        bool complete = false;
+        commands = scip_.supportedCommands(&complete);
+        if (! complete) {
+            // タイムアウトを含む結果は記録しない
+            return commands;
+        }
+        QStringList values;
+        for (int i = 0; i < commands.size(); ++i) {
+            values << QString::fromStdString(commands[i]);
+        }
+        CommandCache::store(product, firmware, "commands", values);
+        return commands;
+    }
+
+    void updateSupportedModes(bool use_cache = true) {
+        // 対応モードは機種とファームウェアで決まるので、前回の結果を使う
+        QString product = QString::fromStdString(informations_.product);
+        QString firmware = QString::fromStdString(informations_.firmware);
+        if (use_cache) {
+            supportedModes = CommandCache::lookup(product, firmware, "modes");
+        }
+        if (! use_cache || supportedModes.isEmpty()) {
+            bool complete = false;
+            supportedModes = scip_.supportedModes(&complete);
+            if (complete) {
+                CommandCache::store(product, firmware, "modes", supportedModes);
+            }
+        }
 
         if((urg_type_ == "URG-04LX") ||
                 (urg_type_ == "UBG-04LX-F01") ||
@@ -849,9 +922,11 @@ struct UrgDevice::pImpl {
         }
     }
 
-    bool loadParameter(void) {
+    bool loadParameter(ScipReply* reply = NULL) {
         RangeSensorParameter parameters;
-        if (! scip_.loadParameter(parameters)) {
+        bool loaded = reply ? scip_.loadParameter(*reply, parameters) :
+                              scip_.loadParameter(parameters);
+        if (! loaded) {
             error_message_ = scip_.what();
             return false;
         }
@@ -864,21 +939,30 @@ struct UrgDevice::pImpl {
         return true;
     }
 
-    bool loadInformation(void) {
+    bool loadInformation(ScipReply* reply = NULL) {
         bool result = true;
         RangeSensorInformation informations;
-        if (! scip_.loadInformation(informations)) {
+        bool loaded = reply ? scip_.loadInformation(*reply, informations) :
+                              scip_.loadInformation(informations);
+        if (! loaded) {
             error_message_ = scip_.what();
             result = false;
         }
         qSwap(informations_, informations);
+
+        // 次回の接続で、応答したボーレートから試せるように記録する
+        if (result && con_ && (con_->connectionType() == Connection::SERIAL_TYPE)) {
+            BaudrateCache::store(con_->getDevice(), con_->baudrate());
+        }
         return result;
     }
 
-    bool loadInternalInformation(void) {
+    bool loadInternalInformation(ScipReply* reply = NULL) {
         bool result = true;
         RangeSensorInternalInformation informations;
-        if (! scip_.loadInternalInformation(informations)) {
+        bool loaded = reply ? scip_.loadInternalInformation(*reply, informations) :
+                              scip_.loadInternalInformation(informations);
+        if (! loaded) {
             error_message_ = scip_.what();
             result = false;
         }
@@ -887,20 +971,163 @@ struct UrgDevice::pImpl {
     }
 
     void disconnect(void) {
+        stopAsyncCapture();
         if (con_) {
             stop();
             con_->disconnect();
         }
     }
 
+    static int asyncCaptureProcess(void* args) {
+        pImpl* obj = static_cast<pImpl*>(args);
+
+        while (! obj->async_thread_.exitThread) {
+            long timestamp = 0;
+            if (obj->async_latest_) {
+                // 読み出されていないスキャンは、新しいスキャンで上書きする
+                if (obj->parent_->capture(obj->async_latest_->back(), timestamp) < 0) {
+                    obj->async_thread_.msleep(AsyncRetryMsec);
+                    continue;
+                }
+                obj->async_latest_->publish();
+                obj->parent_->captureReceived();
+                continue;
+            }
+
+            ScanData* scan = obj->parent_->captureScan(timestamp);
+            if (! scan) {
+                obj->async_thread_.msleep(AsyncRetryMsec);
+                continue;
+            }
+
+            if (obj->async_queue_->push(scan)) {
+                obj->scip_.captureCounters().queueIn();
+                obj->async_available_.release();
+                obj->parent_->captureReceived();
+            }
+            else {
+                // 読み出しが追いつかないときは、新しいスキャンを捨てる
+                obj->scan_pool_.release(scan);
+                obj->async_dropped_.ref();
+                obj->scip_.captureCounters().addDroppedFrame();
+            }
+        }
+        return 0;
+    }
+
+    bool startAsyncCapture(size_t queue_size) {
+        if (async_thread_.isRunning()) {
+            return true;
+        }
+        if (! isConnected()) {
+            error_message_ = "Sensor not connected.";
+            return false;
+        }
+
+        delete async_queue_;
+        async_queue_ = new SpscQueue<ScanData*>(qMax(queue_size, static_cast<size_t>(1)));
+        async_dropped_.fetchAndStoreRelease(0);
+        async_stopping_.fetchAndStoreOrdered(0);
+        async_thread_.run();
+        return true;
+    }
+
+    bool startLatestCapture(void) {
+        if (async_thread_.isRunning()) {
+            return true;
+        }
+        if (! isConnected()) {
+            error_message_ = "Sensor not connected.";
+            return false;
+        }
+
+        delete async_latest_;
+        async_latest_ = new TripleBuffer<ScanData>;
+        for (size_t i = 0; i < 3; ++i) {
+            async_latest_->slot(i).reserve(parameters_.area_max + 1, scanEchoes());
+        }
+        async_stopping_.fetchAndStoreOrdered(0);
+        async_thread_.run();
+        return true;
+    }
+
+    void stopAsyncCapture(void) {
+        if (! async_queue_ && ! async_latest_) {
+            return;
+        }
+        async_thread_.stop();
+
+        // 待っている取り出し側を起こし、全員が抜けてから解放する
+        async_stopping_.fetchAndStoreOrdered(1);
+        while (async_consumers_.fetchAndAddOrdered(0) > 0) {
+            async_available_.release();
+            QThread::yieldCurrentThread();
+        }
+
+        delete async_latest_;
+        async_latest_ = NULL;
+        if (! async_queue_) {
+            return;
+        }
+
+        ScanData* scan = NULL;
+        while (async_queue_->pop(scan)) {
+            scan_pool_.release(scan);
+        }
+        async_available_.acquire(async_available_.available());
+        scip_.captureCounters().clearQueue();
+
+        delete async_queue_;
+        async_queue_ = NULL;
+    }
+
+    ScanData* takeScan(int timeout) {
+        ScanData* scan = NULL;
+        async_consumers_.ref();
+        if (! async_stopping_.fetchAndAddOrdered(0) && async_queue_ &&
+                async_available_.tryAcquire(1, timeout)) {
+            // stopAsyncCapture() が起こしたときは、キューはもう空けられる
+            if (! async_stopping_.fetchAndAddOrdered(0)) {
+                async_queue_->pop(scan);
+                scip_.captureCounters().queueOut();
+            }
+        }
+        async_consumers_.deref();
+        return scan;
+    }
+
+    const ScanData* latestScan(void) {
+        const ScanData* scan = NULL;
+        async_consumers_.ref();
+        if (! async_stopping_.fetchAndAddOrdered(0) && async_latest_ &&
+                async_latest_->update()) {
+            scan = &async_latest_->front();
+        }
+        async_consumers_.deref();
+        return scan;
+    }
+
     void updateCaptureParameters(void) {
         capture_begin_ = parameters_.area_min;
         capture_end_ = parameters_.area_max;
+        updateScanPoolCapacity();
+    }
+
+    int scanEchoes(void) const {
+        bool multi_echo = (capture_mode_ == HD_Capture_mode) ||
+                (capture_mode_ == HE_Capture_mode) ||
+                (capture_mode_ == ND_Capture_mode) ||
+                (capture_mode_ == NE_Capture_mode);
+        return multi_echo ? int(ScipFrameParser::MaxEchoes) : 1;
+    }
+
+    void updateScanPoolCapacity(void) {
+        scan_pool_.setCapacity(parameters_.area_max + 1, scanEchoes());
     }
 
-    int capture(QVector<QVector<long> > &ranges, QVector<QVector<long> > &levels, long &timestamp) {
+    int capture(ScanData &scan, long &timestamp) {
         long raw_timestamp = 0;
-        int n = capture_->capture(ranges, levels, raw_timestamp);
+        int n = capture_->capture(scan, raw_timestamp);
         if (n < 0) {
             error_message_ = scip_.what();
             return n;
@@ -960,6 +1187,7 @@ struct UrgDevice::pImpl {
     }
 
 
+    // 連続取得を止めるためのものなので、取得中のスレッドを待たずに送る
     void stop(void) {
         if (! isConnected()) {
             return;
@@ -976,6 +1204,7 @@ UrgDevice::UrgDevice(void)
   , pimpl(new pImpl(this))
 {
     qRegisterMetaType<SensorDataArray>("SensorDataArray");
+    qRegisterMetaType<ScanData>("ScanData");
     qRegisterMetaType<Converter>("Converter");
 }
 
@@ -1082,6 +1311,7 @@ size_t UrgDevice::remainCaptureTimes(void)
 
 bool UrgDevice::loadParameters()
 {
+    QMutexLocker locker(&pimpl->mutex_);
     return pimpl->loadParameters();
 }
 
@@ -1162,6 +1392,7 @@ void UrgDevice::setCaptureMode(RangeCaptureMode mode)
     }
 
     pimpl->capture_mode_ = mode;
+    pimpl->updateScanPoolCapacity();
 }
 
 
@@ -1206,17 +1437,110 @@ size_t UrgDevice::captureGroupSteps() const
     return pimpl->capture_group_steps_;
 }
 
+void UrgDevice::setLazyChecksum(bool on)
+{
+    QMutexLocker locker(&pimpl->mutex_);
+    pimpl->scip_.setLazyChecksum(on);
+}
+
+bool UrgDevice::isLazyChecksum(void) const
+{
+    return pimpl->scip_.isLazyChecksum();
+}
+
 int UrgDevice::capture(SensorDataArray &ranges, SensorDataArray &levels, long &timestamp)
 {
-    int result = pimpl->capture(ranges.steps, levels.steps, timestamp);
+    // 同時に呼ばれても互いのデータを上書きしないよう、呼び出しごとにバッファを借りる
+    ScanData* scan = pimpl->scan_pool_.acquire();
+    int result = capture(*scan, timestamp);
+    if (result >= 0) {
+        scan->toSensorDataArray(ranges, levels);
+        result = ranges.steps.size();
+    }
+    pimpl->scan_pool_.release(scan);
+    return result;
+}
+
+ScanData* UrgDevice::captureScan(long &timestamp)
+{
+    ScanData* scan = pimpl->scan_pool_.acquire();
+    if (capture(*scan, timestamp) < 0) {
+        pimpl->scan_pool_.release(scan);
+        return NULL;
+    }
+    return scan;
+}
+
+void UrgDevice::releaseScan(ScanData* scan)
+{
+    pimpl->scan_pool_.release(scan);
+}
+
+ScanBufferPool::Statistics UrgDevice::scanPoolStatistics(void) const
+{
+    return pimpl->scan_pool_.statistics();
+}
+
+bool UrgDevice::startAsyncCapture(size_t queue_size)
+{
+    return pimpl->startAsyncCapture(queue_size);
+}
+
+void UrgDevice::stopAsyncCapture(void)
+{
+    pimpl->stopAsyncCapture();
+}
+
+bool UrgDevice::startLatestCapture(void)
+{
+    return pimpl->startLatestCapture();
+}
+
+bool UrgDevice::isAsyncCapture(void) const
+{
+    return (pimpl->async_queue_ != NULL) || (pimpl->async_latest_ != NULL);
+}
+
+ScanData* UrgDevice::takeScan(int timeout)
+{
+    return pimpl->takeScan(timeout);
+}
+
+size_t UrgDevice::droppedScans(void) const
+{
+    return pimpl->async_dropped_.loadAcquire();
+}
+
+const ScanData* UrgDevice::latestScan(void)
+{
+    return pimpl->latestScan();
+}
+
+size_t UrgDevice::supersededScans(void) const
+{
+    return pimpl->async_latest_ ? pimpl->async_latest_->superseded() : 0;
+}
+
+CaptureStatistics UrgDevice::captureStatistics(void) const
+{
+    return pimpl->scip_.captureStatistics();
+}
+
+
+QMutex* UrgDevice::commandMutex(void) const
+{
+    return &pimpl->mutex_;
+}
+
+int UrgDevice::capture(ScanData &scan, long &timestamp)
+{
+    int result = pimpl->capture(scan, timestamp);
     if(result < 0){
         return result;
     }
-    ranges.converter = getConverter();
-    ranges.timestamp = timestamp;
-    levels.converter = getConverter();
-    levels.timestamp = timestamp;
-    return ranges.steps.size();
+    scan.converter = getConverter();
+    scan.timestamp = timestamp;
+    return scan.steps();
 }
 
 
@@ -1229,6 +1553,7 @@ void UrgDevice::stop(void)
 bool UrgDevice::setTimestamp(int ticks, int* response_msec,
                              int* force_delay_msec)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1246,6 +1571,7 @@ long UrgDevice::recentTimestamp(void) const
 
 bool UrgDevice::setLaserOutput(bool on)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1305,24 +1631,28 @@ RangeSensorInternalInformation UrgDevice::internalInformation(void) const
 
 RangeSensorParameter UrgDevice::parameterNow(void) const
 {
+    QMutexLocker locker(&pimpl->mutex_);
     pimpl->loadParameter();
     return pimpl->parameters_;
 }
 
 RangeSensorInformation UrgDevice::informationNow(void) const
 {
+    QMutexLocker locker(&pimpl->mutex_);
     pimpl->loadInformation();
     return pimpl->informations_;
 }
 
 RangeSensorInternalInformation UrgDevice::internalInformationNow(void) const
 {
+    QMutexLocker locker(&pimpl->mutex_);
     pimpl->loadInternalInformation();
     return pimpl->internalInformations_;
 }
 
 bool UrgDevice::loadParameter(void)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     bool res = pimpl->loadParameter();
     if (!res) {
         pimpl->error_message_ = pimpl->scip_.what();
@@ -1332,6 +1662,7 @@ bool UrgDevice::loadParameter(void)
 
 bool UrgDevice::loadInformation(void)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     bool res = pimpl->loadInformation();
     if (!res) {
         pimpl->error_message_ = pimpl->scip_.what();
@@ -1342,6 +1673,7 @@ bool UrgDevice::loadInformation(void)
 
 bool UrgDevice::versionLines(QVector<string> &lines)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1356,6 +1688,7 @@ bool UrgDevice::versionLines(QVector<string> &lines)
 
 bool UrgDevice::commandLines(string cmd, QVector<string> &lines, bool all)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1369,6 +1702,7 @@ bool UrgDevice::commandLines(string cmd, QVector<string> &lines, bool all)
 
 bool UrgDevice::commandLines(string cmd)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1382,6 +1716,7 @@ bool UrgDevice::commandLines(string cmd)
 
 bool UrgDevice::commandLines(string cmd, int &status, QVector<string> &lines, bool all)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1395,6 +1730,7 @@ bool UrgDevice::commandLines(string cmd, int &status, QVector<string> &lines, bo
 
 bool UrgDevice::commandLines(QVector<string> &lines, bool all)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1408,6 +1744,7 @@ bool UrgDevice::commandLines(QVector<string> &lines, bool all)
 
 bool UrgDevice::commandLines(int &status, QVector<string> &lines, bool all)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if (! isConnected()) {
         pimpl->error_message_ = "Sensor not connected.";
         return false;
@@ -1421,7 +1758,8 @@ bool UrgDevice::commandLines(int &status, QVector<string> &lines, bool all)
 
 QVector<string> UrgDevice::supportedCommands(void) const
 {
-    return pimpl->scip_.supportedCommands();
+    QMutexLocker locker(&pimpl->mutex_);
+    return pimpl->supportedCommands();
 }
 
 bool UrgDevice::isSupportedMode(RangeCaptureMode mode)
@@ -1462,8 +1800,9 @@ bool UrgDevice::isSupportedMode(RangeCaptureMode mode)
 
 QStringList UrgDevice::supportedModes(bool force) const
 {
+    QMutexLocker locker(&pimpl->mutex_);
     if(pimpl->supportedModes.isEmpty() || force){
-        pimpl->updateSupportedModes();
+        pimpl->updateSupportedModes(! force);
     }
     return pimpl->supportedModes;
 }
@@ -1471,6 +1810,8 @@ QStringList UrgDevice::supportedModes(bool force) const
 
 bool UrgDevice::reboot(void)
 {
+    // disconnect() は取得スレッドを待つので、ロックを持ったまま呼ばない
+    QMutexLocker locker(&pimpl->mutex_);
     UrgDevice::setLaserOutput(ScipHandler::Off);
 
     // send "RB" twice.
@@ -1492,6 +1833,7 @@ bool UrgDevice::reboot(void)
             return false;
         }
     }
+    locker.unlock();
 
     UrgDevice::disconnect();
 
@@ -1500,6 +1842,7 @@ bool UrgDevice::reboot(void)
 
 bool UrgDevice::changeBaurate(long baud)
 {
+    QMutexLocker locker(&pimpl->mutex_);
     QString ss_command = "SS";
     ss_command += QString("%1").arg(baud, 6, 10, QLatin1Char('0'));
     ss_command += "\n";
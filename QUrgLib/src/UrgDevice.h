@@ -31,6 +31,8 @@
 */
 
 #include "RangeSensor.h"
+#include "ScanData.h"
+#include "ScanBufferPool.h"
 //#include "Coordinate.h"
 #include <QVector>
 #include <memory>
@@ -51,6 +53,7 @@ public:
     enum {
         DefaultBaudrate = 115200, //!< [bps]
         DefaultRetryTimes = 8,
+        DefaultAsyncQueueSize = 8,
         Infinity = 0,
 
         Off = 0,                  //!< Laser is off
@@ -185,8 +188,111 @@ public:
     void setCaptureGroupSteps(size_t group_steps);
     size_t captureGroupSteps() const;
 
+
+    /*!
+      \brief Verify data line checksums after decoding
+
+      \param[in] on true to keep scans with corrupted lines, the values of those lines being set to 0
+    */
+    void setLazyChecksum(bool on);
+    bool isLazyChecksum(void) const;
+
     int capture(SensorDataArray &ranges, SensorDataArray &levels, long &timestamp);
 
+    /*!
+      \brief Get data into flat arrays
+
+      \param[out] scan Scan data, its memory is reused between calls
+      \param[out] timestamp Time stamp
+
+      \return Number of steps received
+      \retval <0 Receiving failed
+    */
+    int capture(ScanData &scan, long &timestamp);
+
+
+    /*!
+      \brief Get data into a buffer leased from the internal pool
+
+      Buffers are reserved for a full scan of the current capture mode,
+      continuous capture then reuses them instead of allocating.
+
+      \param[out] timestamp Time stamp
+
+      \return Leased scan to give back with releaseScan(), NULL if receiving failed
+    */
+    ScanData* captureScan(long &timestamp);
+    void releaseScan(ScanData* scan);
+    ScanBufferPool::Statistics scanPoolStatistics(void) const;
+
+
+    /*!
+      \brief Capture continuously in a background thread
+
+      The thread captures with the current capture mode and queues the
+      scans, takeScan() then never waits on the connection. When the
+      queue is full, the newest scan is dropped and counted in
+      droppedScans().
+
+      \param[in] queue_size Number of scans queued
+
+      \attention capture() and captureScan() must not be called while the thread runs
+    */
+    bool startAsyncCapture(size_t queue_size = DefaultAsyncQueueSize);
+
+    /*!
+      \brief Capture continuously in a background thread, keeping only the newest scan
+
+      Scans are published through a triple buffer: the thread overwrites
+      a scan nobody took yet, and latestScan() returns the newest
+      complete one, at most one frame old.
+    */
+    bool startLatestCapture(void);
+
+    void stopAsyncCapture(void);
+    bool isAsyncCapture(void) const;
+
+
+    /*!
+      \brief Take the oldest queued scan
+
+      Call from a single consumer thread. It may run beside
+      stopAsyncCapture(): a waiting call then wakes up and returns NULL,
+      and the queue is freed only once no call is inside it.
+
+      \param[in] timeout Time to wait for a scan [msec], 0 to poll, -1 to wait forever
+
+      \return Scan to give back with releaseScan(), NULL if none arrived or capture stopped
+    */
+    ScanData* takeScan(int timeout = 0);
+
+    //! Scans dropped because the queue was full
+    size_t droppedScans(void) const;
+
+
+    /*!
+      \brief Take the newest scan published after startLatestCapture()
+
+      Call from a single consumer thread.
+
+      \return Newest scan, valid until the next call or stopAsyncCapture(), NULL if no new scan arrived
+    */
+    const ScanData* latestScan(void);
+
+    //! Scans overwritten before latestScan() took them
+    size_t supersededScans(void) const;
+
+    /*!
+      \brief Counters of the link and the capture since connect()
+
+      Lock-free, may be polled from any thread while capturing.
+      Drops and queue depth are those of startAsyncCapture().
+    */
+    CaptureStatistics captureStatistics(void) const;
+
+    //! Lock held by every command and capture of this device
+    QMutex* commandMutex(void) const;
+
 
     /*!
       \brief Stop data acquisition
@@ -21,11 +21,16 @@
 #include "UrgLogHandler.h"
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
 //#include <sys/time.h>
 #include <time.h>
 #include <QDateTime>
+#include <QAtomicInteger>
+#include <QThread>
+#include <QWaitCondition>
 
 #include "delay.h"
+#include "UbhIndexer.h"
 
 #include <QFileInfo>
 #include <QStringList>
@@ -43,8 +48,456 @@ namespace
 {
 enum {
     InvalidTimestamp = -1,
+    InitProgressMsec = 50,
 };
+
+
+bool isBlank(char ch)
+{
+    return (ch == ' ') || (ch == '\t') || (ch == '\n') ||
+            (ch == '\r') || (ch == '\v') || (ch == '\f');
+}
+
+
+// QString::toLong() と同じく、前後の空白は無視し、数値でなければ 0 を返す
+long parseLong(const char* first, const char* last)
+{
+    while ((first < last) && isBlank(*first)) {
+        ++first;
+    }
+    while ((last > first) && isBlank(last[-1])) {
+        --last;
+    }
+
+    bool negative = false;
+    if ((first < last) && ((*first == '-') || (*first == '+'))) {
+        negative = (*first == '-');
+        ++first;
+    }
+    if (first == last) {
+        return 0;
+    }
+
+    long value = 0;
+    for (; first < last; ++first) {
+        if ((*first < '0') || (*first > '9')) {
+            return 0;
+        }
+        value = (value * 10) + (*first - '0');
+    }
+    return negative ? -value : value;
+}
+
+
+const char* findChar(const char* first, const char* last, char ch)
+{
+    const void* found = memchr(first, ch, last - first);
+    return found ? static_cast<const char*>(found) : last;
+}
+
+
+// [pos, size) から 1 行を取り出す。改行 (CR LF) は含めない
+bool nextLine(const char* data, qint64 size, qint64 &pos,
+              const char* &first, const char* &last)
+{
+    if (pos >= size) {
+        return false;
+    }
+
+    first = data + pos;
+    const char* end = data + size;
+    last = findChar(first, end, '\n');
+    pos = ((last < end) ? (last + 1) : end) - data;
+    if ((last > first) && (last[-1] == '\r')) {
+        --last;
+    }
+    return true;
+}
+
+
+bool startsWith(const char* first, const char* last, const QString &key)
+{
+    if ((last - first) < key.size()) {
+        return false;
+    }
+    for (int i = 0; i < key.size(); ++i) {
+        if (key.at(i).unicode() != static_cast<uchar>(first[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool singleByte(const QString &separator, char &ch)
+{
+    if ((separator.size() != 1) || (separator.at(0).unicode() > 0x7f)) {
+        return false;
+    }
+    ch = separator.at(0).toLatin1();
+    return true;
+}
+
+
+// 符号と 64 bit の最大桁数
+enum {
+    NumberLength = 21,
+};
+
+
+const char* const DigitPairs =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+// QString::number() と同じ 10 進表記を書き込み、書き終えた位置を返す
+char* writeNumber(char* out, long value)
+{
+    char buffer[NumberLength];
+    char* p = buffer + NumberLength;
+    unsigned long n = (value < 0) ? (0UL - static_cast<unsigned long>(value)) :
+                                    static_cast<unsigned long>(value);
+    while (n >= 100) {
+        const char* pair = DigitPairs + ((n % 100) * 2);
+        n /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (n >= 10) {
+        const char* pair = DigitPairs + (n * 2);
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    else {
+        *--p = static_cast<char>('0' + n);
+    }
+    if (value < 0) {
+        *--p = '-';
+    }
+
+    size_t size = buffer + NumberLength - p;
+    memcpy(out, p, size);
+    return out + size;
+}
+
+
+char* writeBytes(char* out, const QByteArray &bytes)
+{
+    memcpy(out, bytes.constData(), bytes.size());
+    return out + bytes.size();
+}
+
+
+// UBH ログはバイナリで開き、改行はプラットフォームの形式で自分で書く
+// (テキストモードの変換があると、pos() と索引の位置がずれる)
+#ifdef Q_OS_WIN
+const char LineEnd[] = "\r\n";
+#else
+const char LineEnd[] = "\n";
+#endif
+
+enum {
+    LineEndSize = sizeof(LineEnd) - 1,
+    UbhRecordLines = 6,         // [timestamp], 時刻, [logtime], 日時, [scan], データ
+};
+
+
+char* writeLineEnd(char* out)
+{
+    memcpy(out, LineEnd, LineEndSize);
+    return out + LineEndSize;
+}
+
+
+char* writeLine(char* out, const QByteArray &bytes)
+{
+    out = writeBytes(out, bytes);
+    return writeLineEnd(out);
+}
+
+
+// SensorDataArray を ScanData と同じ形で読む
+class SensorDataArrayScan
+{
+public:
+    SensorDataArrayScan(const SensorDataArray &ranges, const SensorDataArray &levels)
+        : ranges_(ranges), levels_(levels) {
+    }
+
+    int steps(void) const {
+        return ranges_.steps.size();
+    }
+
+    int echoes(int step) const {
+        return ranges_.steps[step].size();
+    }
+
+    long range(int step, int echo) const {
+        return ranges_.steps[step][echo];
+    }
+
+    // 強度がなければ 0
+    long level(int step, int echo) const {
+        bool exists = (levels_.steps.size() > step) && (levels_.steps[step].size() > echo);
+        return exists ? levels_.steps[step][echo] : 0;
+    }
+
+private:
+    const SensorDataArray &ranges_;
+    const SensorDataArray &levels_;
+};
+
+
+// 空のステップの強度を次のステップから読まないように包む
+class ScanDataScan
+{
+public:
+    explicit ScanDataScan(const ScanData &scan) : scan_(scan) {
+    }
+
+    int steps(void) const {
+        return scan_.steps();
+    }
+
+    int echoes(int step) const {
+        return scan_.echoes(step);
+    }
+
+    long range(int step, int echo) const {
+        return scan_.range(step, echo);
+    }
+
+    long level(int step, int echo) const {
+        return (echo < scan_.echoes(step)) ? scan_.level(step, echo) : 0;
+    }
+
+private:
+    const ScanData &scan_;
+};
+
+
+void swapScan(ScanData &a, ScanData &b)
+{
+    a.ranges.swap(b.ranges);
+    a.levels.swap(b.levels);
+    a.echoOffsets.swap(b.echoOffsets);
+    qSwap(a.converter, b.converter);
+    qSwap(a.timestamp, b.timestamp);
 }
+}
+
+/*!
+  \brief Bounded record queue and the thread writing it to the UBH log
+*/
+class UrgLogHandler::AsyncQueue : public QThread
+{
+public:
+    //! One queued record, SensorDataArray is implicitly shared and not copied
+    class Record
+    {
+    public:
+        ScanData scan;
+        SensorDataArray ranges;
+        SensorDataArray levels;
+        long timestamp;
+        QDateTime logtime;      //!< When the record was queued
+        bool is_array;
+
+        Record(void) : timestamp(0), is_array(false) {
+        }
+    };
+
+    UrgLogHandler* handler_;
+    QMutex mutex_;
+    QWaitCondition not_empty_;
+    QWaitCondition not_full_;
+    QVector<Record> queue_;
+    QVector<ScanData> spare_;
+    int capacity_;
+    QueuePolicy policy_;
+    bool enabled_;
+    bool stop_;
+    QAtomicInteger<quint64> dropped_;
+
+
+    explicit AsyncQueue(UrgLogHandler* handler)
+        : handler_(handler), capacity_(DefaultQueueCapacity),
+          policy_(BlockWhenFull), enabled_(false), stop_(false), dropped_(0) {
+    }
+
+
+    bool push(const SensorDataArray &ranges, const SensorDataArray &levels, long timestamp) {
+        QDateTime logtime = QDateTime::currentDateTime();
+        QMutexLocker locker(&mutex_);
+        if (!makeRoom()) {
+            return false;
+        }
+
+        queue_.append(Record());
+        Record &record = queue_.last();
+        record.ranges = ranges;
+        record.levels = levels;
+        record.timestamp = timestamp;
+        record.logtime = logtime;
+        record.is_array = true;
+        not_empty_.wakeOne();
+        return true;
+    }
+
+
+    bool pushShared(const ScanData &scan, long timestamp) {
+        QDateTime logtime = QDateTime::currentDateTime();
+        QMutexLocker locker(&mutex_);
+        if (!makeRoom()) {
+            return false;
+        }
+
+        queue_.append(Record());
+        Record &record = queue_.last();
+        record.scan = scan;
+        record.timestamp = timestamp;
+        record.logtime = logtime;
+        not_empty_.wakeOne();
+        return true;
+    }
+
+
+    bool pushTaken(ScanData &scan, long timestamp) {
+        QDateTime logtime = QDateTime::currentDateTime();
+        QMutexLocker locker(&mutex_);
+        if (!makeRoom()) {
+            scan.clear();
+            return false;
+        }
+
+        // scan の中身を移し、代わりに書き終えたバッファを渡す
+        queue_.append(Record());
+        Record &record = queue_.last();
+        swapScan(record.scan, scan);
+        record.timestamp = timestamp;
+        record.logtime = logtime;
+        if (!spare_.isEmpty()) {
+            swapScan(scan, spare_.last());
+            spare_.removeLast();
+        }
+        not_empty_.wakeOne();
+        return true;
+    }
+
+
+    int depth(void) {
+        QMutexLocker locker(&mutex_);
+        return queue_.size();
+    }
+
+
+    //! Writes the remaining records and stops the thread
+    void finish(void) {
+        {
+            QMutexLocker locker(&mutex_);
+            stop_ = true;
+            not_empty_.wakeAll();
+        }
+        wait();
+
+        // 止める間に追加された記録も書く
+        QVector<Record> rest;
+        {
+            QMutexLocker locker(&mutex_);
+            rest.swap(queue_);
+            stop_ = false;
+            not_full_.wakeAll();
+        }
+        if (!rest.isEmpty()) {
+            write(rest);
+        }
+    }
+
+
+protected:
+    void run(void) {
+        QVector<Record> batch;
+        forever {
+            {
+                QMutexLocker locker(&mutex_);
+                while (queue_.isEmpty() && !stop_) {
+                    not_empty_.wait(&mutex_);
+                }
+                if (queue_.isEmpty()) {
+                    break;
+                }
+                batch.swap(queue_);
+                not_full_.wakeAll();
+            }
+            write(batch);
+        }
+    }
+
+
+private:
+    // mutex_ を保持して呼ぶ。記録を捨てるときは false を返す
+    bool makeRoom(void) {
+        while (queue_.size() >= capacity_) {
+            if (policy_ == DropNewest) {
+                dropped_.fetchAndAddRelaxed(1);
+                return false;
+            }
+            else if (policy_ == DropOldest) {
+                recycle(queue_.first());
+                queue_.remove(0);
+                dropped_.fetchAndAddRelaxed(1);
+            }
+            else {
+                not_full_.wait(&mutex_);
+            }
+        }
+        return true;
+    }
+
+
+    // mutex_ を保持して呼ぶ
+    void recycle(Record &record) {
+        if (!record.is_array && (spare_.size() < capacity_)) {
+            record.scan.clear();
+            spare_.append(ScanData());
+            swapScan(spare_.last(), record.scan);
+        }
+    }
+
+
+    // 記録をまとめて 1 回で書き、バッファは使い回しに戻す
+    void write(QVector<Record> &batch) {
+        {
+            QMutexLocker locker(&handler_->m_mutex);
+            if (handler_->m_sout.isOpen()) {
+                handler_->m_ubhBuffer.resize(0);
+                qint64 position = handler_->m_sout.pos();
+                for (int i = 0; i < batch.size(); ++i) {
+                    const Record &record = batch[i];
+                    if (record.is_array) {
+                        handler_->appendUbh(SensorDataArrayScan(record.ranges, record.levels),
+                                            record.timestamp, record.logtime, position);
+                    }
+                    else {
+                        handler_->appendUbh(ScanDataScan(record.scan), record.timestamp,
+                                            record.logtime, position);
+                    }
+                }
+                handler_->writeUbhBuffer();
+            }
+        }
+
+        QMutexLocker locker(&mutex_);
+        for (int i = 0; i < batch.size(); ++i) {
+            recycle(batch[i]);
+        }
+        batch.resize(0);
+    }
+};
+
 
 UrgLogHandler::UrgLogHandler(void)
 {
@@ -58,6 +511,10 @@ UrgLogHandler::UrgLogHandler(void)
     intensitySeparator = "|";
     m_errorMessage = tr("No errors");
     m_useFlush = false;
+    m_useMapping = true;
+    m_async = NULL;
+    m_map = NULL;
+    m_mapSize = 0;
     m_currentMode = UnknownMode;
 
     frontStep = 0;
@@ -106,14 +563,14 @@ UrgLogHandler::UrgLogHandler(void)
     logtimeKey = "[logtime]";
 
     m_shouldStopInit = false;
-
-    m_markPoints.clear();
 }
 
 
 UrgLogHandler::~UrgLogHandler(void)
 {
     close();
+    stopAsync();
+    delete m_async;
 }
 
 
@@ -129,13 +586,16 @@ bool UrgLogHandler::create(const QString &file_name)
 
         m_sout.setFileName(m_filename);
 
-        if (! m_sout.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        if (! m_sout.open(QIODevice::WriteOnly)) {
             m_errorMessage = tr("File could not be created.");
 
             m_isClosed = true;
             return false;
         }
 
+        // 索引が作れなくても、ログの記録は続ける
+        m_markPoints.create(m_filename);
+
         add(applicationNameKey, QApplication::applicationName());
         add(applicationVersionKey, QApplication::applicationVersion());
     }
@@ -199,6 +659,7 @@ bool UrgLogHandler::create(const QString &file_name)
     m_currentMode = WriteMode;
     m_isClosed = false;
     m_writePosition = 0;
+    startAsync();
     return true;
 }
 
@@ -215,6 +676,14 @@ bool UrgLogHandler::load(const QString &file_name)
 
         if (m_sin.open(QIODevice::ReadOnly | QIODevice::Text)) {
             initHeaderRecords();
+
+            // 索引ファイルが使えれば、init() でログ全体を読まずに済む
+            if (m_markPoints.load(m_filename)) {
+                m_totalTimestamps = m_markPoints.size();
+            }
+            if (m_useMapping) {
+                mapLog();
+            }
         }
         else{
             m_errorMessage = tr("File could not be opened.");
@@ -685,8 +1154,6 @@ bool UrgLogHandler::timestampSequential(long &totalTimestamp, long &skipTimestam
 
     m_markPoints.clear();
 
-    m_markPoints.push_back(0);
-
     bool result = true;
     m_shouldStopInit = false;
 
@@ -694,13 +1161,18 @@ bool UrgLogHandler::timestampSequential(long &totalTimestamp, long &skipTimestam
         line = m_sin.readLine();
         if (line.startsWith(timestampKey)) {
             qint64 currentPos = m_sin.pos() - (qint64)(timestampKey.length() + 5);
-            m_markPoints.push_back(currentPos);
             if (!m_sin.atEnd()) {
                 line = m_sin.readLine();
                 if (!line.isEmpty()) {
                     timestamp = line.toLong();
                     totalTimestamp++;
 
+                    // 先頭の記録は、ファイルの先頭からも読み出せる
+                    if (m_markPoints.isEmpty()) {
+                        m_markPoints.append(0, timestamp);
+                    }
+                    m_markPoints.append(currentPos, timestamp);
+
                     if (last_timestamp >= timestamp) {
                         m_errorMessage = tr("Non sequential timestamp.");
                         result = false;
@@ -727,6 +1199,10 @@ bool UrgLogHandler::timestampSequential(long &totalTimestamp, long &skipTimestam
         }
     }
 
+    if (m_markPoints.isEmpty()) {
+        m_markPoints.append(0, 0);
+    }
+
     totalTimestamp--;
 
     m_totalTimestamps = totalTimestamp;
@@ -739,10 +1215,10 @@ long UrgLogHandler::getSkippedTimeStamps()
     long skipTimestamp = 0;
     if (m_markPoints.size() > 0) {
         int scanThres = (scanMsec * 1.25);
-        long last_timestamp = timestampAt(0);
+        long last_timestamp = m_markPoints.timestamp(0);
 
         for (int i = 1; i < m_markPoints.size(); ++i) {
-            long current_timetsamp = timestampAt(i);
+            long current_timetsamp = m_markPoints.timestamp(i);
             if ((current_timetsamp - last_timestamp) > scanThres) {
                 skipTimestamp++;
             }
@@ -780,61 +1256,56 @@ bool UrgLogHandler::init(bool noFreeze)
 
     getDataInit();
 
-    QString line;
-
-    qint64 size = m_sin.size();
-
-    m_sin.reset();
-    m_sin.seek(0);
-
-    m_markPoints.clear();
-    qint64 avgCount =  size / 10419;
-    m_markPoints.reserve(avgCount);
-
+    // load() で索引ファイルを読み込めていれば、ログを走査しない
+    if (m_markPoints.isMapped()) {
+        m_totalTimestamps = m_markPoints.size();
+        emit initProgress(100);
+        return true;
+    }
 
+    // 索引のない古いログは、複数のスレッドで分担して走査する
     m_shouldStopInit = false;
-    qint64 totalTimestamp = 0;
-
-    while (!m_sin.atEnd() && !m_shouldStopInit) {
-        line = m_sin.readLine();
-        qint64 currentPos = m_sin.pos() - (qint64)(timestampKey.length() + 5);
-        if (line.startsWith(timestampKey)) {
-            m_markPoints.push_back(currentPos);
-            ++totalTimestamp;
-            if (!m_sin.atEnd()) {
-                line = m_sin.readLine();
-                if (line.isEmpty()) {
-                    m_errorMessage = tr("An empty timestamp is found.");
-                    result &= false;
-                }
-            }
-            else {
-                m_errorMessage = tr("End of file reached before getting the timestamp value.");
-                result &= false;
-            }
+    UbhIndexer indexer(m_filename);
+    if (!indexer.start()) {
+        m_errorMessage = tr("Log file is not open.");
+        return false;
+    }
 
-        }
-        if (size > 0) {
-            int progress = static_cast<int>(((double)currentPos / (double)size) * 100.0);
+    int lastProgress = -1;
+    while (!indexer.waitForDone(InitProgressMsec)) {
+        int progress = indexer.progress();
+        if (progress != lastProgress) {
             emit initProgress(progress);
-        }
-        else {
-            emit initProgress(0);
+            lastProgress = progress;
         }
 
         if (noFreeze) {
             QApplication::processEvents();
         }
+        if (m_shouldStopInit) {
+            indexer.cancel();
+        }
     }
 
-    if (m_shouldStopInit) {
+    if (m_shouldStopInit || !indexer.fill(m_markPoints)) {
         m_markPoints.clear();
-        m_markPoints.push_back(0);
+        m_markPoints.append(0, 0);
         result &= false;
-        m_errorMessage = tr("Initialization canceled.");
+        m_errorMessage = m_shouldStopInit ? tr("Initialization canceled.")
+                                          : tr("Log file could not be read.");
+        m_totalTimestamps = 0;
+    }
+    else {
+        if (indexer.hasTruncatedRecord()) {
+            m_errorMessage = tr("End of file reached before getting the timestamp value.");
+            result &= false;
+        }
+        else {
+            // 次に開くときのために索引ファイルを残す。書けなくても構わない
+            m_markPoints.save(m_filename);
+        }
+        m_totalTimestamps = m_markPoints.size();
     }
-
-    m_totalTimestamps = totalTimestamp;
     emit initProgress(100);
 
     m_sin.reset();
@@ -1166,14 +1637,24 @@ bool UrgLogHandler::close()
         return false;
     }
 
+    // 待っている記録を書いてから閉じる
+    stopAsync();
+
     m_isClosed = false;
     if (m_sout.isOpen()) {
+        if (m_markPoints.isWriting()) {
+            m_sout.flush();
+            m_markPoints.commit(m_sout.pos());
+            m_markPoints.finish();
+        }
         m_sout.close();
         m_isClosed = true;
     }
 
     if (m_sin.isOpen()) {
+        unmapLog();
         m_sin.close();
+        m_markPoints.clear();
         m_isClosed = true;
     }
 
@@ -1261,131 +1742,134 @@ long UrgLogHandler::addDataUbh(const SensorDataArray &ranges,
                 const SensorDataArray &levels,
                 long timestamp)
 {
-    long writtenCount = 0;
-
     if (! m_sout.isOpen()) {
         m_errorMessage = tr("Create log file first!");
-        return writtenCount;
+        return 0;
     }
 
-    QTextStream out(&m_sout);
-
-    m_lastTimestamp = timestamp;
-
-    out << timestampKey << endl;
-    writtenCount += timestampKey.size() + 1;
-    out << timestamp << endl;
-    writtenCount += QString::number(timestamp).size() + 1;
-
-    out << logtimeKey << endl;
-    writtenCount += logtimeKey.size() + 1;
+    m_ubhBuffer.resize(0);
+    appendUbh(SensorDataArrayScan(ranges, levels), timestamp,
+              QDateTime::currentDateTime(), m_sout.pos());
+    return writeUbhBuffer();
+}
 
-    QString logTimeS = QDateTime::currentDateTime().toString("yyyy-MM-dd HH:mm:ss.zzz");
+template <class Scan>
+void UrgLogHandler::appendUbh(const Scan &scan, long timestamp,
+                              const QDateTime &logtime, qint64 position)
+{
+    // QFile::pos() は書き込み前のバッファも含むので、位置は正確
+    int offset = m_ubhBuffer.size();
+    m_markPoints.write(position + offset, timestamp);
 
-    out << logTimeS << endl;
-    writtenCount += logTimeS.size() + 1;
+    m_lastTimestamp = timestamp;
 
-    out << scanKey << endl;
-    writtenCount += scanKey.size() + 1;
+    // QTextStream と同じく、文字列はロケールの文字コードで書き出す
+    QByteArray timestampS = timestampKey.toLocal8Bit();
+    QByteArray logtimeS = logtimeKey.toLocal8Bit();
+    QByteArray scanKeyS = scanKey.toLocal8Bit();
+    QByteArray logTimeS = logtime.toString("yyyy-MM-dd HH:mm:ss.zzz").toLocal8Bit();
+    QByteArray blockS = blockSeparator.toLocal8Bit();
+    QByteArray dataS = dataSeparator.toLocal8Bit();
+    QByteArray intensityS = intensitySeparator.toLocal8Bit();
+
+    // 1 エコーあたり、距離と強度、区切り文字 2 つまで
+    int echoes = 0;
+    for (int i = 0; i < scan.steps(); ++i) {
+        echoes += qMax(scan.echoes(i), 1);
+    }
+    int separatorSize = qMax(blockS.size(), qMax(dataS.size(), intensityS.size()));
+    int bound = timestampS.size() + logtimeS.size() + scanKeyS.size() + logTimeS.size() +
+            NumberLength + (echoes * 2 * (NumberLength + separatorSize)) +
+            (UbhRecordLines * LineEndSize);
+
+    // 記録用のバッファは使い回し、まとめて書くときは倍々に広げる
+    if (m_ubhBuffer.capacity() < (offset + bound)) {
+        m_ubhBuffer.reserve(qMax(offset + bound, m_ubhBuffer.capacity() * 2));
+    }
+    m_ubhBuffer.resize(offset + bound);
+    char* p = m_ubhBuffer.data() + offset;
+
+    p = writeLine(p, timestampS);
+    p = writeNumber(p, timestamp);
+    p = writeLineEnd(p);
+    p = writeLine(p, logtimeS);
+    p = writeLine(p, logTimeS);
+    p = writeLine(p, scanKeyS);
 
     switch (m_captureMode) {
     case GD_Capture_mode:
     case MD_Capture_mode: {
-        QString scanS;
-        for (int i = 0; i < ranges.steps.size(); ++i) {
-            if (ranges.steps[i].size() > 0) {
-                scanS += QString("%1").arg(ranges.steps[i][0]);
-            }
-            else {
-                scanS += QString("%1").arg(0);
-            }
-
-            if (i < (ranges.steps.size() - 1)) {
-                scanS += blockSeparator;
+        for (int i = 0; i < scan.steps(); ++i) {
+            if (i > 0) {
+                p = writeBytes(p, blockS);
             }
+            p = writeNumber(p, (scan.echoes(i) > 0) ? scan.range(i, 0) : 0);
         }
-        out << scanS << endl;
-        writtenCount += scanS.size() + 1;
+        p = writeLineEnd(p);
     }
     break;
     case GE_Capture_mode:
     case ME_Capture_mode: {
-        QString scanS;
-        for (int i = 0; i < ranges.steps.size(); ++i) {
-            if (ranges.steps[i].size() > 0) {
-                scanS += QString("%1").arg(ranges.steps[i][0]);
-            }
-            else {
-                scanS += QString("%1").arg(0);
-            }
-
-            scanS += intensitySeparator;
-
-            if (levels.steps.size() > i && levels.steps[i].size() > 0) {
-                scanS += QString("%1").arg(levels.steps[i][0]);
-            }
-            else {
-                scanS += QString("%1").arg(0);
-            }
-
-            if (i < (ranges.steps.size() - 1)) {
-                scanS += blockSeparator;
+        for (int i = 0; i < scan.steps(); ++i) {
+            if (i > 0) {
+                p = writeBytes(p, blockS);
             }
+            p = writeNumber(p, (scan.echoes(i) > 0) ? scan.range(i, 0) : 0);
+            p = writeBytes(p, intensityS);
+            p = writeNumber(p, scan.level(i, 0));
         }
-        out << scanS << endl;
-        writtenCount += scanS.size() + 1;
+        p = writeLineEnd(p);
     }
     break;
     case HD_Capture_mode:
     case ND_Capture_mode: {
-        QString scanS;
-        for (int i = 0; i < ranges.steps.size(); ++i) {
-            for (int j = 0; j < ranges.steps[i].size(); ++j) {
-                scanS += QString("%1").arg(ranges.steps[i][j]);
-                if (j < (ranges.steps[i].size() - 1)) {
-                    scanS += dataSeparator;
-                }
+        for (int i = 0; i < scan.steps(); ++i) {
+            if (i > 0) {
+                p = writeBytes(p, blockS);
             }
-            if (i < (ranges.steps.size() - 1)) {
-                scanS += blockSeparator;
+            for (int j = 0; j < scan.echoes(i); ++j) {
+                if (j > 0) {
+                    p = writeBytes(p, dataS);
+                }
+                p = writeNumber(p, scan.range(i, j));
             }
         }
-        out << scanS << endl;
-        writtenCount += scanS.size() + 1;
+        p = writeLineEnd(p);
     }
     break;
     case HE_Capture_mode:
     case NE_Capture_mode:
     case UnknownMode: {
-        QString scanS;
-        for (int i = 0; i < ranges.steps.size(); ++i) {
-            for (int j = 0; j < ranges.steps[i].size(); ++j) {
-                scanS += QString("%1").arg(ranges.steps[i][j]);
-
-                scanS += intensitySeparator;
-
-                if (levels.steps.size() > i && levels.steps[i].size() > j) {
-                    scanS += QString("%1").arg(levels.steps[i][j]);
-                }
-                else {
-                    scanS += QString("%1").arg(0);
-                }
-
-                if (j < (ranges.steps[i].size() - 1)) {
-                    scanS += dataSeparator;
-                }
+        for (int i = 0; i < scan.steps(); ++i) {
+            if (i > 0) {
+                p = writeBytes(p, blockS);
             }
-            if (i < (ranges.steps.size() - 1)) {
-                scanS += blockSeparator;
+            for (int j = 0; j < scan.echoes(i); ++j) {
+                if (j > 0) {
+                    p = writeBytes(p, dataS);
+                }
+                p = writeNumber(p, scan.range(i, j));
+                p = writeBytes(p, intensityS);
+                p = writeNumber(p, scan.level(i, j));
             }
         }
-        out << scanS << endl;
-        writtenCount += scanS.size() + 1;
+        p = writeLineEnd(p);
     }
     }
 
+    m_ubhBuffer.resize(p - m_ubhBuffer.constData());
+}
+
+long UrgLogHandler::writeUbhBuffer()
+{
+    long writtenCount = m_ubhBuffer.size();
+    if (m_sout.write(m_ubhBuffer.constData(), writtenCount) != writtenCount) {
+        m_errorMessage = tr("Log file could not be written.");
+    }
+
     if (m_useFlush) {
-        out.flush();
+        m_sout.flush();
+        m_markPoints.commit(m_sout.pos());
     }
 
     return writtenCount;
@@ -1715,6 +2199,11 @@ long UrgLogHandler::addData(const SensorDataArray &ranges,
     if (m_isClosed) {
         return writtenCount;
     }
+    if (isAsync()) {
+        m_writePosition++;
+        return m_async->push(ranges, levels, timestamp) ? 1 : 0;
+    }
+
     QMutexLocker locker(&m_mutex);
     if (m_logFormat == "ubh") {
         writtenCount = addDataUbh(ranges, levels, timestamp);
@@ -1735,6 +2224,48 @@ long UrgLogHandler::addData(const SensorDataArray &ranges,
     return writtenCount;
 }
 
+long UrgLogHandler::addData(const ScanData &scan, long timestamp)
+{
+    if (m_isClosed) {
+        return 0;
+    }
+    if (isAsync()) {
+        m_writePosition++;
+        return m_async->pushShared(scan, timestamp) ? 1 : 0;
+    }
+
+    if (m_logFormat == "ubh") {
+        QMutexLocker locker(&m_mutex);
+        if (! m_sout.isOpen()) {
+            m_errorMessage = tr("Create log file first!");
+            return 0;
+        }
+
+        m_ubhBuffer.resize(0);
+        appendUbh(ScanDataScan(scan), timestamp, QDateTime::currentDateTime(), m_sout.pos());
+        m_writePosition++;
+        return writeUbhBuffer();
+    }
+
+    SensorDataArray ranges;
+    SensorDataArray levels;
+    scan.toSensorDataArray(ranges, levels);
+
+    return addData(ranges, levels, timestamp);
+}
+
+long UrgLogHandler::takeData(ScanData &scan, long timestamp)
+{
+    if (!m_isClosed && isAsync()) {
+        m_writePosition++;
+        return m_async->pushTaken(scan, timestamp) ? 1 : 0;
+    }
+
+    long writtenCount = addData(scan, timestamp);
+    scan.clear();
+    return writtenCount;
+}
+
 bool UrgLogHandler::fileExists()
 {
     QFileInfo fi(m_filename);
@@ -1793,7 +2324,7 @@ long UrgLogHandler::setDataPos(long pos)
     QMutexLocker locker(&m_mutex);
     if ((pos >= 0) && (pos < m_markPoints.size())) {
         m_sin.reset();
-        m_sin.seek(m_markPoints[pos]);
+        m_sin.seek(m_markPoints.offset(pos));
         m_readPosition = pos;
         return m_readPosition;
     }
@@ -2247,6 +2778,211 @@ long UrgLogHandler::getData(SensorDataArray &ranges, SensorDataArray &levels, lo
     return m_readPosition - 1;
 }
 
+long UrgLogHandler::getData(ScanData &scan, long &timestamp)
+{
+    char block;
+    char data;
+    char intensity;
+    if (m_map && singleByte(blockSeparator, block) &&
+            singleByte(dataSeparator, data) && singleByte(intensitySeparator, intensity)) {
+        QMutexLocker locker(&m_mutex);
+        if (m_captureMode == Unknown_Capture_mode) {
+            m_errorMessage = tr("Please run getDataInit() first!");
+            scan.clear();
+            return -1;
+        }
+
+        qint64 pos = m_sin.pos();
+        QString error = readMappedRecord(pos, scan, timestamp, block, data, intensity);
+        m_sin.seek(pos);
+        if (!error.isEmpty()) {
+            m_errorMessage = error;
+            scan.clear();
+            return -1;
+        }
+
+        m_readPosition++;
+        return m_readPosition - 1;
+    }
+
+    // 区切り文字が複数文字のとき、またはログを割り当てられなかったとき
+    SensorDataArray ranges;
+    SensorDataArray levels;
+    long position = getData(ranges, levels, timestamp);
+    if (position < 0) {
+        scan.clear();
+        return position;
+    }
+
+    scan.fromSensorDataArray(ranges, levels);
+    return position;
+}
+
+QString UrgLogHandler::readMappedRecord(qint64 &pos, ScanData &scan, long &timestamp,
+                                        char block, char data, char intensity)
+{
+    const char* map = reinterpret_cast<const char*>(m_map);
+    const char* first;
+    const char* last;
+
+    bool recordFound = false;
+    while (!m_shouldStopInit && nextLine(map, m_mapSize, pos, first, last)) {
+        if (startsWith(first, last, timestampKey)) {
+            recordFound = true;
+            break;
+        }
+    }
+    if (!recordFound) {
+        return tr("No record found!");
+    }
+
+    if (!nextLine(map, m_mapSize, pos, first, last)) {
+        return tr("An empty timestamp is found.");
+    }
+    timestamp = parseLong(first, last);
+    m_timeStamp = timestamp;
+
+    if (!nextLine(map, m_mapSize, pos, first, last)) {
+        return tr("Log time is not found");
+    }
+    if (!startsWith(first, last, logtimeKey)) {
+        return tr("Log time place order is wrong.");
+    }
+    if (!nextLine(map, m_mapSize, pos, first, last)) {
+        return tr("Log time data is not found");
+    }
+    m_logTime = QString::fromUtf8(first, last - first).trimmed();
+
+    if (!nextLine(map, m_mapSize, pos, first, last)) {
+        return tr("Scan record is not found");
+    }
+    if (!startsWith(first, last, scanKey)) {
+        return tr("Scan place order is wrong.");
+    }
+    if (!nextLine(map, m_mapSize, pos, first, last)) {
+        return tr("Scan data is not found");
+    }
+
+    QString error = parseMappedScan(first, last, scan, block, data, intensity);
+    if (!error.isEmpty()) {
+        return error;
+    }
+
+    scan.converter = getConverter();
+    scan.timestamp = timestamp;
+    return QString();
+}
+
+QString UrgLogHandler::parseMappedScan(const char* first, const char* last, ScanData &scan,
+                                       char block, char data, char intensity)
+{
+    bool distanceOnly = false;
+    bool singleEcho = false;
+    bool needIntensity = false;
+    switch (m_captureMode) {
+    case GD_Capture_mode:
+    case MD_Capture_mode:
+        distanceOnly = true;
+        singleEcho = true;
+        break;
+    case GE_Capture_mode:
+    case ME_Capture_mode:
+        singleEcho = true;
+        needIntensity = true;
+        break;
+    case HD_Capture_mode:
+    case ND_Capture_mode:
+        distanceOnly = true;
+        break;
+    case HE_Capture_mode:
+    case NE_Capture_mode:
+        needIntensity = true;
+        break;
+    default:
+        return tr("Capture mode unknown.");
+    }
+
+    // getData(SensorDataArray&, ...) と同じ順に、範囲外のステップとエコーを除く
+    bool firstEchoOnly =
+            (m_captureModeRead == GE_Capture_mode) || (m_captureModeRead == ME_Capture_mode) ||
+            (m_captureModeRead == GD_Capture_mode) || (m_captureModeRead == MD_Capture_mode);
+    bool keepLevels = needIntensity &&
+            (m_captureModeRead != GD_Capture_mode) && (m_captureModeRead != MD_Capture_mode) &&
+            (m_captureModeRead != HD_Capture_mode) && (m_captureModeRead != ND_Capture_mode);
+    int skipFront = qMax(m_startStepRead - startStep, 0);
+    int skipBack = qMax(endStep - m_endStepRead, 0);
+
+    scan.clear();
+    scan.reserve(qMax(endStep - startStep + 1, 0), firstEchoOnly ? 1 : qMax(m_maxEchoNumber, 1));
+
+    int step = 0;
+    const char* p = first;
+    while (true) {
+        const char* blockEnd = findChar(p, last, block);
+
+        bool hasIntensity = findChar(p, blockEnd, intensity) != blockEnd;
+        bool hasMultiEcho = findChar(p, blockEnd, data) != blockEnd;
+        if (distanceOnly && hasIntensity) {
+            return tr("Intensity values in distance only mode.");
+        }
+        if (singleEcho && hasMultiEcho) {
+            return needIntensity ? tr("Multiecho values in distance and intensity only mode.") :
+                                   tr("Multiecho values in distance only mode.");
+        }
+        if (needIntensity && !hasIntensity) {
+            return tr("No Intensity values in intensity mode.");
+        }
+
+        if (step >= skipFront) {
+            scan.addStep();
+            const char* echo = p;
+            for (int i = 0; ; ++i) {
+                const char* echoEnd = findChar(echo, blockEnd, data);
+                const char* levelFirst = findChar(echo, echoEnd, intensity);
+                if (!firstEchoOnly || (i == 0)) {
+                    quint32 range = parseLong(echo, levelFirst);
+                    if (keepLevels) {
+                        quint32 level = 0;
+                        if (levelFirst != echoEnd) {
+                            ++levelFirst;
+                            level = parseLong(levelFirst, findChar(levelFirst, echoEnd, intensity));
+                        }
+                        scan.addEcho(range, level);
+                    }
+                    else {
+                        scan.addEcho(range);
+                    }
+                }
+                if (echoEnd == blockEnd) {
+                    break;
+                }
+                echo = echoEnd + 1;
+            }
+        }
+        ++step;
+
+        if (blockEnd == last) {
+            break;
+        }
+        p = blockEnd + 1;
+    }
+
+    int steps = scan.steps();
+    if (skipBack > 0) {
+        int keep = qMax(steps - skipBack, 0);
+        if (keep < steps) {
+            int echoes = scan.echoOffsets.at(keep);
+            scan.echoOffsets.resize(keep);
+            scan.ranges.resize(echoes);
+            if (keepLevels) {
+                scan.levels.resize(echoes);
+            }
+        }
+    }
+
+    return QString();
+}
+
 long UrgLogHandler::getTimestamp(long &timestamp)
 {
     QMutexLocker locker(&m_mutex);
@@ -2469,8 +3205,8 @@ long UrgLogHandler::add(const QString &key, int value)
 
         QTextStream out(&m_sout);
 
-        out << key << endl << value << endl;
-        usedSize += key.size() + 1 + QString::number(value).size() + 1;
+        out << key << LineEnd << value << LineEnd;
+        usedSize += key.size() + LineEndSize + QString::number(value).size() + LineEndSize;
 
         if (m_useFlush) {
             out.flush();
@@ -2502,8 +3238,8 @@ long UrgLogHandler::add(const QString &key, const QString &value)
 
         QTextStream out(&m_sout);
 
-        out << key << endl << value << endl;
-        usedSize += key.size() + 1 + value.size() + 1;
+        out << key << LineEnd << value << LineEnd;
+        usedSize += key.size() + LineEndSize + value.size() + LineEndSize;
 
         if (m_useFlush) {
             out.flush();
@@ -2537,8 +3273,8 @@ long UrgLogHandler::add(const QString &key, long value)
 
         QTextStream out(&m_sout);
 
-        out << key << endl << value << endl;
-        usedSize += key.size() + 1 + QString::number(value).size() + 1;
+        out << key << LineEnd << value << LineEnd;
+        usedSize += key.size() + LineEndSize + QString::number(value).size() + LineEndSize;
 
         if (m_useFlush) {
             out.flush();
@@ -2635,6 +3371,88 @@ void UrgLogHandler::useFlush(bool state)
     m_useFlush = state;
 }
 
+void UrgLogHandler::useMapping(bool state)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_useMapping = state;
+    if (!m_useMapping) {
+        unmapLog();
+    } else if (m_sin.isOpen() && (m_currentMode == ReadMode)) {
+        mapLog();
+    }
+}
+
+void UrgLogHandler::useAsync(bool state, int capacity, QueuePolicy policy)
+{
+    stopAsync();
+
+    if (state && !m_async) {
+        m_async = new AsyncQueue(this);
+    }
+    if (m_async) {
+        m_async->enabled_ = state;
+        m_async->capacity_ = qMax(capacity, 1);
+        m_async->policy_ = policy;
+        m_async->dropped_.storeRelease(0);
+        startAsync();
+    }
+}
+
+int UrgLogHandler::queueDepth()
+{
+    return m_async ? m_async->depth() : 0;
+}
+
+quint64 UrgLogHandler::droppedRecords()
+{
+    return m_async ? m_async->dropped_.loadAcquire() : 0;
+}
+
+bool UrgLogHandler::isAsync()
+{
+    return m_async && m_async->isRunning();
+}
+
+void UrgLogHandler::startAsync()
+{
+    // 書き込みスレッドは UBH の記録中だけ動かす
+    if (m_async && m_async->enabled_ && !m_async->isRunning() &&
+            (m_logFormat == "ubh") && m_sout.isOpen()) {
+        m_async->start();
+    }
+}
+
+void UrgLogHandler::stopAsync()
+{
+    if (isAsync()) {
+        m_async->finish();
+    }
+}
+
+void UrgLogHandler::mapLog()
+{
+    if (m_map || (m_sin.size() <= 0)) {
+        return;
+    }
+
+    // 割り当てに失敗したときは、QFile::readLine() による読み出しを使う
+    m_mapSize = m_sin.size();
+    m_map = m_sin.map(0, m_mapSize);
+    if (!m_map) {
+        m_mapSize = 0;
+    }
+}
+
+void UrgLogHandler::unmapLog()
+{
+    if (m_map) {
+        m_sin.unmap(const_cast<uchar*>(m_map));
+        m_map = NULL;
+        m_mapSize = 0;
+    }
+}
+
 //QVector<long> UrgLogHandler::getEcho(int echo, QVector<long> &ranges, int length)
 //{
 //    QVector<long> distances;
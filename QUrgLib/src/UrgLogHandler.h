@@ -30,10 +30,13 @@
 #include "RangeSensor.h"
 #include "RangeCaptureMode.h"
 #include "RangeSensorParameter.h"
+#include "ScanData.h"
+#include "UbhIndex.h"
 #include <QVector>
 #include "BasicExcel.hpp"
 using namespace YExcel;
 
+#include <QDateTime>
 #include <QFile>
 
 #include <QObject>
@@ -50,6 +53,17 @@ class UrgLogHandler: public QObject
 {
     Q_OBJECT
 public:
+    //! What addData() does when the asynchronous queue is full
+    enum QueuePolicy {
+        BlockWhenFull,          //!< Wait until the writer thread takes records
+        DropOldest,             //!< Discard the oldest queued record
+        DropNewest,             //!< Discard the record being added
+    };
+
+    enum {
+        DefaultQueueCapacity = 64,
+    };
+
     UrgLogHandler(const UrgLogHandler &rhs);
     UrgLogHandler &operator = (const UrgLogHandler &rhs);
     UrgLogHandler(void);
@@ -106,6 +120,7 @@ public:
 
 //    long getData(QVector<long> &ranges, QVector<long> &levels, long &timestamp);
     long getData(SensorDataArray &ranges, SensorDataArray &levels, long &timestamp);
+    long getData(ScanData &scan, long &timestamp);
     long getTimestamp(long &timestamp);
 
     QString getAppName() {return appName;}
@@ -136,6 +151,40 @@ public:
     QString what();
     void useFlush(bool state);
 
+    /*!
+      \brief Parse scans straight from a memory mapped UBH log
+
+      getData(ScanData&, long&) then reads the mapped bytes instead of
+      QFile::readLine() and fills the ScanData without temporary strings.
+      Enabled by default, multi character separators always use the
+      line based reader.
+    */
+    void useMapping(bool state);
+
+    /*!
+      \brief Write UBH records from a background thread
+
+      addData() then only queues the record, and a writer thread formats
+      the queued records and writes them to the file in one batch, so that
+      a slow disk does not stall the capture. addData() returns 1 for a
+      queued record and 0 for a dropped one. useFlush() flushes once per
+      batch. close() and useAsync(false) write the remaining records.
+
+      Header records should be added before the first scan.
+
+      \param[in] state Enables the asynchronous mode
+      \param[in] capacity Maximum number of queued records
+      \param[in] policy What addData() does when the queue is full
+    */
+    void useAsync(bool state, int capacity = DefaultQueueCapacity,
+                  QueuePolicy policy = BlockWhenFull);
+
+    //! Records waiting for the writer thread
+    int queueDepth();
+
+    //! Records discarded by a full queue since useAsync(true)
+    quint64 droppedRecords();
+
     int headerCheck();
     bool getDataInit();
 
@@ -196,6 +245,16 @@ public:
     long getNextData(SensorDataArray &ranges, SensorDataArray &levels, long &timestamp);
 //    void convertData(QVector<QVector<long> > &output, QVector<long> &input);
     long addData(const SensorDataArray &ranges, const SensorDataArray &levels, long timestamp);
+    long addData(const ScanData &scan, long timestamp);
+
+    /*!
+      \brief Add a scan, handing its buffers over to the log
+
+      Same as addData(const ScanData&, long), but in asynchronous mode the
+      buffers of scan are moved into the queue and scan receives a
+      recycled buffer in exchange. In any mode scan is empty on return.
+    */
+    long takeData(ScanData &scan, long timestamp);
 
     bool fileExists();
     long timestampAt(qint64 pos);
@@ -234,6 +293,13 @@ private:
     QString m_errorMessage;
 
     bool m_useFlush;
+    QByteArray m_ubhBuffer;
+    bool m_useMapping;
+    const uchar* m_map;
+    qint64 m_mapSize;
+
+    class AsyncQueue;
+    AsyncQueue* m_async;
 
     QString appName;
     QString appVersion;
@@ -280,7 +346,7 @@ private:
 
     RangeSensorParameter m_urgParameter;
 
-    QVector<qint64> m_markPoints;
+    UbhIndex m_markPoints;         //!< Frames of the log being read or written
 
     QString m_logTime;
     long m_timeStamp;
@@ -304,6 +370,19 @@ private:
     long addDataCsv(const SensorDataArray &ranges, const SensorDataArray &levels, long timestamp);
     long addDataXy(const SensorDataArray &ranges, const SensorDataArray &levels, long timestamp);
     void initHeaderRecords();
+    template <class Scan>
+    void appendUbh(const Scan &scan, long timestamp, const QDateTime &logtime,
+                   qint64 position);
+    long writeUbhBuffer();
+    bool isAsync();
+    void startAsync();
+    void stopAsync();
+    void mapLog();
+    void unmapLog();
+    QString readMappedRecord(qint64 &pos, ScanData &scan, long &timestamp,
+                             char block, char data, char intensity);
+    QString parseMappedScan(const char* first, const char* last, ScanData &scan,
+                            char block, char data, char intensity);
 };
 
 #endif /* !URG_LOG_HANDLER_H */
@@ -119,8 +119,7 @@ int CustomConnection::receive(char* data, size_t count, int timeout)
 {
     static_cast<void>(timeout);
 
-    int n = std::min(pimpl->recv_buffer_.size(), count);
-    pimpl->recv_buffer_.get(data, n);
+    int n = static_cast<int>(pimpl->recv_buffer_.get(data, count));
 //    cout << "Receive Start -------------" << endl;
 //    cout << "count: " << count << endl;
 //    cout << "buffer size: " << pimpl->recv_buffer_.size() << endl;
@@ -136,7 +135,7 @@ int CustomConnection::receive(char* data, size_t count, int timeout)
 
 size_t CustomConnection::size(void) const
 {
-    cout << "size: " << pimpl->recv_buffer_.size() << endl;
+//    cout << "size: " << pimpl->recv_buffer_.size() << endl;
     return pimpl->recv_buffer_.size();
 }
 
@@ -167,13 +166,15 @@ void CustomConnection::ungetc(const char ch)
 
 void CustomConnection::setReadData(const char* data, size_t count)
 {
+    // 大きなデータも失わないよう、受信バッファを広げる
+    pimpl->recv_buffer_.reserve(pimpl->recv_buffer_.size() + count);
     pimpl->recv_buffer_.put(data, count);
 }
 
 
 void CustomConnection::setReadData(std::string data)
 {
-    pimpl->recv_buffer_.put(data.c_str(), data.size());
+    setReadData(data.c_str(), data.size());
     cout << "setdata size: " << pimpl->recv_buffer_.size() << endl;
 
 }
@@ -181,6 +182,7 @@ void CustomConnection::setReadData(std::string data)
 
 void CustomConnection::readSendData(char* data, size_t count)
 {
+    pimpl->send_buffer_.reserve(pimpl->send_buffer_.size() + count);
     pimpl->send_buffer_.put(data, count);
 }
 
@@ -0,0 +1,231 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#include "SimulatedSensor.h"
+#include "ScipDecoder.h"
+#include <cstring>
+#include <string>
+
+using namespace qrk;
+using namespace std;
+
+
+namespace
+{
+enum {
+    StartBit = 0,
+    StopBit = 9,
+    FrameBits = 10,             // スタートビット + 8 データビット + ストップビット
+};
+
+
+// センサが送信する波形の bit 番目のレベル (送信後はアイドルの 1)
+int lineLevel(const string &data, qint64 bit)
+{
+    if (bit >= static_cast<qint64>(data.size()) * FrameBits) {
+        return 1;
+    }
+    int position = static_cast<int>(bit % FrameBits);
+    if (position == StartBit) {
+        return 0;
+    } else if (position == StopBit) {
+        return 1;
+    }
+    return (static_cast<unsigned char>(data[bit / FrameBits]) >> (position - 1)) & 1;
+}
+}
+
+
+SimulatedSensor::SimulatedSensor(long sensor_baudrate)
+    : sensor_baudrate_(sensor_baudrate), baudrate_(0), connected_(false),
+      commands_(0)
+{
+}
+
+
+const char* SimulatedSensor::what(void) const
+{
+    return "no error.";
+}
+
+
+bool SimulatedSensor::connect(const char* device, long baudrate)
+{
+    device_ = QString::fromLatin1(device);
+    baudrate_ = baudrate;
+    connected_ = true;
+    commands_ = 0;
+    return true;
+}
+
+
+void SimulatedSensor::disconnect(void)
+{
+    connected_ = false;
+}
+
+
+bool SimulatedSensor::setBaudrate(long baudrate)
+{
+    baudrate_ = baudrate;
+    return true;
+}
+
+
+long SimulatedSensor::baudrate(void) const
+{
+    return baudrate_;
+}
+
+
+bool SimulatedSensor::isConnected(void) const
+{
+    return connected_;
+}
+
+
+int SimulatedSensor::send(const char* data, size_t count)
+{
+    ++commands_;
+
+    // センサはコマンドを自分のボーレートで受け取れたものとして応答する
+    string response;
+    if ((count == 3) && ! strncmp(data, "QT\n", 3)) {
+        response = "QT\n00P\n\n";
+    }
+    else if ((count > 1) && (data[count - 1] == '\n')) {
+        QString command = QString::fromLatin1(data, static_cast<int>(count - 1));
+        received_ << command;
+        if (silent_commands_.contains(command)) {
+            return static_cast<int>(count);
+        }
+        char status[] = "00?\n\n";
+        if (! supported_commands_.contains(command)) {
+            status[1] = 'E';
+        }
+        status[2] = ScipDecoder::checkSum(status, 2);
+        response.assign(data, count);
+        response += status;
+    }
+
+    if (baudrate_ == sensor_baudrate_) {
+        reply(response.data(), response.size());
+    } else {
+        garble(response);
+    }
+    return static_cast<int>(count);
+}
+
+
+void SimulatedSensor::garble(const string &response)
+{
+    // ホスト側の UART は立ち下がりをスタートビットとして同期し、
+    // 自分のボーレートのビット中央で 8 ビットを読んでから次の立ち下がりを待つ
+    // 時刻は 1 / (2 * sensor_baudrate_ * baudrate_) 秒単位で整数で扱う
+    const qint64 sensor_bit = 2 * static_cast<qint64>(baudrate_);
+    const qint64 host_bit = 2 * static_cast<qint64>(sensor_baudrate_);
+
+    qint64 bits = static_cast<qint64>(response.size()) * FrameBits;
+    qint64 ready = 0;
+    for (qint64 bit = 0; bit < bits; ++bit) {
+        bool falling = (lineLevel(response, bit) == 0) &&
+                ((bit == 0) || (lineLevel(response, bit - 1) == 1));
+        qint64 edge = bit * sensor_bit;
+        if (! falling || (edge < ready)) {
+            continue;
+        }
+
+        unsigned char ch = 0;
+        for (int i = 0; i < 8; ++i) {
+            qint64 sample = edge + host_bit + (host_bit / 2) + (i * host_bit);
+            ch |= lineLevel(response, sample / sensor_bit) << i;
+        }
+        reply(reinterpret_cast<const char*>(&ch), 1);
+
+        // ストップビットの中央から、次の立ち下がりを待つ
+        ready = edge + (9 * host_bit) + (host_bit / 2);
+    }
+}
+
+
+void SimulatedSensor::reply(const char* data, size_t count)
+{
+    recv_buffer_.reserve(recv_buffer_.size() + count);
+    recv_buffer_.put(data, count);
+}
+
+
+int SimulatedSensor::receive(char* data, size_t count, int timeout)
+{
+    Q_UNUSED(timeout);
+    return static_cast<int>(recv_buffer_.get(data, count));
+}
+
+
+size_t SimulatedSensor::size(void) const
+{
+    return recv_buffer_.size();
+}
+
+
+void SimulatedSensor::flush(void)
+{
+}
+
+
+void SimulatedSensor::clear(void)
+{
+    recv_buffer_.clear();
+}
+
+
+void SimulatedSensor::ungetc(const char ch)
+{
+    recv_buffer_.ungetc(ch);
+}
+
+
+QString SimulatedSensor::getDevice()
+{
+    return device_;
+}
+
+
+size_t SimulatedSensor::commands(void) const
+{
+    return commands_;
+}
+
+
+void SimulatedSensor::setSupportedCommands(const QStringList &commands)
+{
+    supported_commands_ = commands;
+}
+
+
+void SimulatedSensor::setSilentCommands(const QStringList &commands)
+{
+    silent_commands_ = commands;
+}
+
+
+bool SimulatedSensor::received(const QString &command) const
+{
+    return received_.contains(command);
+}
@@ -0,0 +1,96 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+#ifndef QRK_SIMULATED_SENSOR_H
+#define QRK_SIMULATED_SENSOR_H
+
+/*!
+  \file
+  \brief Serial sensor answering commands at a fixed baudrate
+*/
+
+#include "Connection.h"
+#include "RingBuffer.h"
+#include <QStringList>
+#include <QSet>
+#include <string>
+
+
+namespace qrk
+{
+/*!
+  \brief Serial sensor answering commands at a fixed baudrate
+
+  At the sensor baudrate, QT is answered as a real sensor does, and any
+  other command is echoed back with status 00 when it is one of the
+  supported commands and 0E otherwise. At
+  another baudrate the same answer is received the way a UART sampling
+  at the host baudrate frames it: every start bit it detects yields a
+  byte, made of whatever levels are on the line at its bit centres.
+  Nothing ever blocks.
+*/
+class SimulatedSensor : public Connection
+{
+public:
+    explicit SimulatedSensor(long sensor_baudrate);
+
+    const char* what(void) const;
+
+    bool connect(const char* device, long baudrate);
+    void disconnect(void);
+    bool setBaudrate(long baudrate);
+    long baudrate(void) const;
+    bool isConnected(void) const;
+    int send(const char* data, size_t count);
+    int receive(char* data, size_t count, int timeout);
+    size_t size(void) const;
+    void flush(void);
+    void clear(void);
+    void ungetc(const char ch);
+    ConnectionType connectionType() { return SERIAL_TYPE; }
+    QString getDevice();
+
+    //! Number of commands received
+    size_t commands(void) const;
+
+    void setSupportedCommands(const QStringList &commands);
+
+    //! Commands left unanswered, as if their reply was lost
+    void setSilentCommands(const QStringList &commands);
+
+    //! Whether \p command was ever sent
+    bool received(const QString &command) const;
+
+private:
+    void reply(const char* data, size_t count);
+    void garble(const std::string &response);
+
+    long sensor_baudrate_;
+    long baudrate_;
+    bool connected_;
+    QString device_;
+    size_t commands_;
+    QStringList supported_commands_;
+    QStringList silent_commands_;
+    QSet<QString> received_;
+    RingBuffer<char> recv_buffer_;
+};
+}
+
+#endif /* !QRK_SIMULATED_SENSOR_H */
@@ -19,8 +19,204 @@
 */
 
 #include "TestUrgDevice.h"
+#include "ConnectionUtils.h"
+#include "LineReader.h"
+#include "ScipFrameParser.h"
+#include "ScipDecoder.h"
+#include "ScipHandler.h"
+#include "RingBuffer.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
+#include "CaptureStatistics.h"
+#include "BaudrateCache.h"
+#include "CommandCache.h"
+#include "UbhIndex.h"
+#include "UbhIndexer.h"
+#include "UrgLogHandler.h"
+#include "ScanReactor.h"
+#include "SimulatedSensor.h"
 
 #include <QFile>
+#include <QThread>
+#include <QTemporaryDir>
+
+#if defined(Q_OS_LINUX)
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+namespace
+{
+enum {
+    UtmSteps = 1081,
+    ScipLineBytes = 64,
+};
+
+string scipEncode(long value, int width)
+{
+    string encoded(width, '0');
+    for (int i = width - 1; i >= 0; --i) {
+        encoded[i] = static_cast<char>((value & 0x3f) + 0x30);
+        value >>= 6;
+    }
+    return encoded;
+}
+
+string scipLine(const string &payload)
+{
+    char sum = 0;
+    for (size_t i = 0; i < payload.size(); ++i) {
+        sum += payload[i];
+    }
+    return payload + static_cast<char>((sum & 0x3f) + 0x30) + "\n";
+}
+
+// Same byte stream as one UTM-30LX ME frame (range + intensity, 6.5 KB)
+string meFrame(int steps = UtmSteps)
+{
+    string frame = "ME0000108001000\n";
+    frame += scipLine("99");
+    frame += scipLine(scipEncode(123456, 4));
+
+    string payload;
+    for (int i = 0; i < steps; ++i) {
+        payload += scipEncode(1000 + (i * 37) % 29000, 3);
+        payload += scipEncode((i * 13) % 4000, 3);
+    }
+    for (size_t i = 0; i < payload.size(); i += ScipLineBytes) {
+        frame += scipLine(payload.substr(i, ScipLineBytes));
+    }
+    frame += "\n";
+    return frame;
+}
+
+
+#if defined(Q_OS_LINUX)
+// ソケットの片側を、ScanReactor が待てる接続として使う
+class SocketConnection : public Connection
+{
+public:
+    explicit SocketConnection(int fd) : fd_(fd), sends_(0) {
+    }
+
+    const char* what(void) const {
+        return "no error.";
+    }
+
+    bool connect(const char*, long) {
+        return true;
+    }
+
+    bool setBaudrate(long) {
+        return true;
+    }
+
+    long baudrate(void) const {
+        return 0;
+    }
+
+    bool isConnected(void) const {
+        return true;
+    }
+
+    int send(const char* data, size_t count) {
+        // フラグなしで送るので、切れた接続に送ると SIGPIPE で止まる
+        ++sends_;
+        return static_cast<int>(::send(fd_, data, count, 0));
+    }
+
+    int sends(void) const {
+        return sends_;
+    }
+
+    int receive(char* data, size_t count, int) {
+        return static_cast<int>(::read(fd_, data, count));
+    }
+
+    size_t size(void) const {
+        return 0;
+    }
+
+    void flush(void) {
+    }
+
+    void clear(void) {
+    }
+
+    void ungetc(const char) {
+    }
+
+    ConnectionType connectionType() {
+        return CUSTOM_TYPE;
+    }
+
+    int nativeHandle(void) const {
+        return fd_;
+    }
+
+    QString getDevice() {
+        return QString();
+    }
+
+private:
+    int fd_;
+    int sends_;
+};
+
+
+// ループバックで接続した TCP ソケットの組
+bool tcpPair(int fds[2])
+{
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if ((listener < 0) ||
+            (bind(listener, reinterpret_cast<struct sockaddr*>(&address), length) < 0) ||
+            (listen(listener, 1) < 0) ||
+            (getsockname(listener, reinterpret_cast<struct sockaddr*>(&address), &length) < 0)) {
+        return false;
+    }
+
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    bool connected = ::connect(fds[0], reinterpret_cast<struct sockaddr*>(&address), length) == 0;
+    fds[1] = connected ? accept(listener, NULL, NULL) : -1;
+    ::close(listener);
+    return fds[1] >= 0;
+}
+#endif
+
+
+// takeScan() で待ち続ける取り出し側
+class TakeScanThread : public QThread
+{
+public:
+    explicit TakeScanThread(UrgDevice* urg)
+        : urg_(urg), scan_(reinterpret_cast<ScanData*>(1))
+    {
+    }
+
+    ScanData* scan(void) const
+    {
+        return scan_;
+    }
+
+protected:
+    void run(void)
+    {
+        scan_ = urg_->takeScan(-1);
+    }
+
+private:
+    UrgDevice* urg_;
+    ScanData* scan_;
+};
+}
 
 TestUrgDevice::TestUrgDevice()
 {
@@ -45,5 +241,917 @@ void TestUrgDevice::connection()
     QVERIFY(urg.isConnected());
 }
 
+void TestUrgDevice::asyncCaptureStop()
+{
+    UrgDevice urg;
+    CustomConnection custom;
+
+    urg.setConnection(&custom);
+    QFile file(":/testfile/connection");
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QByteArray fileContent = file.readAll();
+    custom.setReadData(fileContent.data(), fileContent.size());
+    QVERIFY(urg.connect("Com1", 115200));
+
+    // 応答の無いセンサで、取り出し側は待ち続ける
+    QVERIFY(urg.startAsyncCapture(2));
+    TakeScanThread consumer(&urg);
+    consumer.start();
+    QTest::qWait(100);
+    QVERIFY(consumer.isRunning());
+
+    // 停止で起こされ、NULL を返す
+    urg.stopAsyncCapture();
+    QVERIFY(consumer.wait(5000));
+    QVERIFY(consumer.scan() == NULL);
+    QVERIFY(! urg.isAsyncCapture());
+    QVERIFY(urg.takeScan(0) == NULL);
+}
+
+void TestUrgDevice::readlineBenchmark_data()
+{
+    QTest::addColumn<bool>("buffered");
+
+    QTest::newRow("byte-at-a-time readline") << false;
+    QTest::newRow("LineReader") << true;
+}
+
+void TestUrgDevice::readlineBenchmark()
+{
+    QFETCH(bool, buffered);
+
+    enum { BufferSize = 4096 + 1 };
+    const string frame = meFrame();
+    CustomConnection custom;
+    LineReader reader(&custom);
+    char buffer[BufferSize];
+
+    QBENCHMARK {
+        custom.setReadData(frame.c_str(), frame.size());
+        int lines = 0;
+        int n = 0;
+        do {
+            n = buffered ? reader.readline(buffer, BufferSize, 0)
+                         : readline(&custom, buffer, BufferSize, 0);
+            ++lines;
+        } while (n > 0);
+        QCOMPARE(lines, 106);
+    }
+}
+
+void TestUrgDevice::frameParser_data()
+{
+    QTest::addColumn<int>("chunk");
+
+    QTest::newRow("byte by byte") << 1;
+    QTest::newRow("odd chunks") << 7;
+    QTest::newRow("line chunks") << 65;
+    QTest::newRow("whole frame") << 0;
+}
+
+void TestUrgDevice::frameParser()
+{
+    QFETCH(int, chunk);
+
+    const string frame = meFrame();
+    QVector<quint32> ranges(UtmSteps);
+    QVector<quint32> levels(UtmSteps);
+    QVector<quint32> offsets(UtmSteps);
+
+    ScipFrameParser parser;
+    ScipFrameParser::Output output;
+    output.ranges = ranges.data();
+    output.levels = levels.data();
+    output.step_offsets = offsets.data();
+    output.value_capacity = ranges.size();
+    output.step_capacity = offsets.size();
+    parser.setOutput(output);
+
+    size_t chunk_size = (chunk > 0) ? chunk : frame.size();
+    size_t position = 0;
+    ScipFrameParser::Event event = ScipFrameParser::NeedMoreData;
+    while ((position < frame.size()) && (event != ScipFrameParser::FrameComplete)) {
+        size_t consumed = 0;
+        size_t n = qMin(chunk_size, frame.size() - position);
+        event = parser.feed(&frame[position], n, &consumed);
+        QVERIFY(event != ScipFrameParser::ChecksumError);
+        position += consumed;
+    }
+
+    QCOMPARE(event, ScipFrameParser::FrameComplete);
+    QCOMPARE(position, frame.size());
+    QCOMPARE(parser.type(), ME);
+    QCOMPARE(QString(parser.status()), QString("99"));
+    QCOMPARE(parser.timestamp(), 123456L);
+    QCOMPARE(parser.steps(), static_cast<size_t>(UtmSteps));
+    QCOMPARE(parser.values(), static_cast<size_t>(UtmSteps));
+    QVERIFY(! parser.isOverflow());
+    for (int i = 0; i < UtmSteps; ++i) {
+        QCOMPARE(offsets[i], static_cast<quint32>(i));
+        QCOMPARE(ranges[i], static_cast<quint32>(1000 + (i * 37) % 29000));
+        QCOMPARE(levels[i], static_cast<quint32>((i * 13) % 4000));
+    }
+}
+
+void TestUrgDevice::frameParserLazyChecksum()
+{
+    string frame = meFrame();
+
+    // 10 番目のデータ行の 1 文字を壊す
+    size_t position = 0;
+    for (int i = 0; i < 3 + 10; ++i) {
+        position = frame.find('\n', position) + 1;
+    }
+    frame[position + 5] ^= 0x01;
+
+    QVector<quint32> ranges(UtmSteps);
+    QVector<quint32> levels(UtmSteps);
+    QVector<quint32> offsets(UtmSteps);
+
+    ScipFrameParser parser;
+    ScipFrameParser::Output output;
+    output.ranges = ranges.data();
+    output.levels = levels.data();
+    output.step_offsets = offsets.data();
+    output.value_capacity = ranges.size();
+    output.step_capacity = offsets.size();
+    parser.setOutput(output);
+
+    size_t consumed = 0;
+    QCOMPARE(parser.feed(frame.data(), frame.size(), &consumed), ScipFrameParser::EchobackReceived);
+
+    parser.setLazyChecksum(true);
+    QCOMPARE(parser.feed(frame.data() + consumed, frame.size() - consumed, &consumed),
+             ScipFrameParser::FrameComplete);
+    QCOMPARE(parser.steps(), static_cast<size_t>(UtmSteps));
+
+    // 1 行 64 文字に、6 文字の値が最大 12 個かかる
+    size_t invalid = 0;
+    for (int i = 0; i < UtmSteps; ++i) {
+        if ((ranges[i] == 0) && (levels[i] == 0)) {
+            ++invalid;
+            continue;
+        }
+        QCOMPARE(ranges[i], static_cast<quint32>(1000 + (i * 37) % 29000));
+        QCOMPARE(levels[i], static_cast<quint32>((i * 13) % 4000));
+    }
+    QVERIFY(invalid > 0);
+    QCOMPARE(parser.invalidValues(), invalid);
+    QVERIFY(invalid <= 12);
+}
+
+void TestUrgDevice::scipLazyChecksum()
+{
+    string frame = meFrame();
+
+    // 10 番目のデータ行の 1 文字を壊す
+    size_t position = 0;
+    for (int i = 0; i < 3 + 10; ++i) {
+        position = frame.find('\n', position) + 1;
+    }
+    frame[position + 5] ^= 0x01;
+
+    CustomConnection custom;
+    custom.setReadData(frame);
+    ScipHandler scip;
+    scip.setConnection(&custom);
+    scip.setLazyChecksum(true);
+
+    // 受信の経路でも、壊れた行の値だけが 0 になり、チェックサム異常として数える
+    ScanData scan;
+    CaptureSettings settings;
+    long timestamp = 0;
+    scip.receiveCaptureData(scan, settings, timestamp);
+    QCOMPARE(scan.steps(), int(UtmSteps));
+    QCOMPARE(timestamp, 123456L);
+
+    int invalid = 0;
+    for (int i = 0; i < UtmSteps; ++i) {
+        if ((scan.range(i) == 0) && (scan.level(i) == 0)) {
+            ++invalid;
+            continue;
+        }
+        QCOMPARE(scan.range(i), static_cast<quint32>(1000 + (i * 37) % 29000));
+        QCOMPARE(scan.level(i), static_cast<quint32>((i * 13) % 4000));
+    }
+    QVERIFY(invalid > 0);
+    QVERIFY(invalid <= 12);
+    QCOMPARE(scip.captureStatistics().checksum_errors, Q_UINT64_C(1));
+    QCOMPARE(QString(scip.what()), QString("Checksum error"));
+}
+
+void TestUrgDevice::scipDecoder_data()
+{
+    QTest::addColumn<int>("width");
+
+    QTest::newRow("2 characters (GS/MS)") << 2;
+    QTest::newRow("3 characters (GD/MD/GE/ME)") << 3;
+    QTest::newRow("4 characters (timestamp)") << 4;
+}
+
+void TestUrgDevice::scipDecoder()
+{
+    QFETCH(int, width);
+
+    enum { Trials = 200, MaxValues = 300, Guard = 0xdeadbeef };
+    const ScipDecoder::Implementation selected = ScipDecoder::implementation();
+    const ScipDecoder::Implementation implementations[] = {
+        ScipDecoder::Scalar,
+        ScipDecoder::Sse2,
+        ScipDecoder::Ssse3,
+        ScipDecoder::Avx2,
+        ScipDecoder::Neon,
+    };
+
+    qsrand(width);
+    for (size_t i = 0; i < sizeof(implementations) / sizeof(implementations[0]); ++i) {
+        if (! ScipDecoder::setImplementation(implementations[i])) {
+            continue;
+        }
+
+        for (int trial = 0; trial < Trials; ++trial) {
+            int count = qrand() % MaxValues;
+            QByteArray encoded(count * width, '0');
+            for (int j = 0; j < encoded.size(); ++j) {
+                encoded[j] = static_cast<char>(0x30 + (qrand() % 64));
+            }
+
+            QVector<quint32> values(count + 1, Guard);
+            ScipDecoder::decode(values.data(), encoded.constData(), count, width);
+            for (int j = 0; j < count; ++j) {
+                QCOMPARE(values[j], static_cast<quint32>(
+                             ScipHandler::decode(encoded.constData() + (j * width), width)));
+            }
+            QCOMPARE(values[count], static_cast<quint32>(Guard));
+
+            char sum = 0;
+            for (int j = 0; j < encoded.size(); ++j) {
+                sum += encoded[j];
+            }
+            QCOMPARE(ScipDecoder::checkSum(encoded.constData(), encoded.size()),
+                     static_cast<char>((sum & 0x3f) + 0x30));
+
+            int pairs = count / 2;
+            QVector<quint32> first(pairs);
+            QVector<quint32> second(pairs);
+            ScipDecoder::decodePairs(first.data(), second.data(),
+                                     encoded.constData(), pairs, width);
+            for (int j = 0; j < pairs; ++j) {
+                QCOMPARE(first[j], values[j * 2]);
+                QCOMPARE(second[j], values[(j * 2) + 1]);
+            }
+        }
+    }
+    ScipDecoder::setImplementation(selected);
+}
+
+void TestUrgDevice::scanDataAdapter()
+{
+    // 多重エコーを含む、段ごとにエコー数の異なるスキャン
+    SensorDataArray ranges;
+    SensorDataArray levels;
+    ranges.timestamp = 1234;
+    for (int i = 0; i < UtmSteps; ++i) {
+        QVector<long> step_ranges;
+        QVector<long> step_levels;
+        for (int j = 0; j <= (i % 3); ++j) {
+            step_ranges << 1000 + (i * 7) + j;
+            step_levels << (i * 3) + j;
+        }
+        ranges.steps << step_ranges;
+        levels.steps << step_levels;
+    }
+
+    ScanData scan;
+    scan.fromSensorDataArray(ranges, levels);
+    QCOMPARE(scan.steps(), UtmSteps);
+    QVERIFY(scan.hasLevels());
+    QCOMPARE(scan.echoes(2), 3);
+    QCOMPARE(scan.range(2, 1), static_cast<quint32>(1000 + 14 + 1));
+    QCOMPARE(scan.level(2, 2), static_cast<quint32>(6 + 2));
+
+    SensorDataArray converted_ranges;
+    SensorDataArray converted_levels;
+    scan.toSensorDataArray(converted_ranges, converted_levels);
+    QVERIFY(converted_ranges.steps == ranges.steps);
+    QVERIFY(converted_levels.steps == levels.steps);
+    QCOMPARE(converted_levels.timestamp, ranges.timestamp);
+
+    scan.clear();
+    QVERIFY(scan.isEmpty());
+    QVERIFY(scan.ranges.capacity() >= UtmSteps);
+}
+
+void TestUrgDevice::scanBufferPool()
+{
+    ScanBufferPool pool(2);
+    pool.setCapacity(UtmSteps);
+
+    ScanData* first = pool.acquire();
+    ScanData* second = pool.acquire();
+    QVERIFY(first->ranges.capacity() >= UtmSteps);
+    first->addStep();
+    first->addEcho(1000);
+    pool.release(first);
+
+    // 返却されたバッファは空の状態で再利用される
+    ScanData* third = pool.acquire();
+    QCOMPARE(third, first);
+    QVERIFY(third->isEmpty());
+    pool.release(second);
+    pool.release(third);
+
+    ScanBufferPool::Statistics statistics = pool.statistics();
+    QCOMPARE(statistics.misses, static_cast<size_t>(2));
+    QCOMPARE(statistics.hits, static_cast<size_t>(1));
+    QCOMPARE(statistics.high_water, static_cast<size_t>(2));
+    QCOMPARE(statistics.leased, static_cast<size_t>(0));
+    QCOMPARE(statistics.pooled, static_cast<size_t>(2));
+}
+
+
+void TestUrgDevice::ringBuffer()
+{
+    RingBuffer<char> buffer(8);
+    QCOMPARE(buffer.capacity(), static_cast<size_t>(7));
+
+    // 空き領域を超えるデータは格納されない
+    QCOMPARE(buffer.put("abcdefghij", 10), static_cast<size_t>(7));
+    char data[8];
+    QCOMPARE(buffer.get(data, 3), static_cast<size_t>(3));
+    QVERIFY(buffer.ungetc('C'));
+    QVERIFY(!buffer.ungetc('B'));
+    QCOMPARE(buffer.put("xyz", 3), static_cast<size_t>(2));
+
+    // 折り返したデータは 2 つの連続領域として読み出される
+    QCOMPARE(buffer.peek(data, sizeof(data)), static_cast<size_t>(7));
+    QCOMPARE(QByteArray(data, 7), QByteArray("Cdefgxy"));
+    const char* span;
+    QCOMPARE(buffer.readSpan(&span), static_cast<size_t>(6));
+    buffer.consume(6);
+    QCOMPARE(buffer.readSpan(&span), static_cast<size_t>(1));
+    QCOMPARE(span[0], 'y');
+
+    // 広げても、格納済みのデータは順に残る
+    QCOMPARE(buffer.put("z", 1), static_cast<size_t>(1));
+    buffer.reserve(20);
+    QVERIFY(buffer.capacity() >= static_cast<size_t>(20));
+    QCOMPARE(buffer.put("0123456789", 10), static_cast<size_t>(10));
+    QCOMPARE(buffer.get(data, 8), static_cast<size_t>(8));
+    QCOMPARE(QByteArray(data, 8), QByteArray("yz012345"));
+
+    buffer.clear();
+    QVERIFY(buffer.empty());
+}
+
+
+void TestUrgDevice::scanReactor()
+{
+#if defined(Q_OS_LINUX)
+    // 相手が閉じる接続と、リセットされる (ECONNRESET) 接続
+    int closing_pair[2];
+    QCOMPARE(socketpair(AF_UNIX, SOCK_STREAM, 0, closing_pair), 0);
+    int reset_pair[2];
+    QVERIFY(tcpPair(reset_pair));
+    SocketConnection closing(closing_pair[0]);
+    SocketConnection resetting(reset_pair[0]);
+
+    ScanReactor reactor;
+    QCOMPARE(reactor.addChannel(&closing, "ME0000108001000\n", UtmSteps), 0);
+    QCOMPARE(reactor.addChannel(&resetting, "ME0000108001000\n", UtmSteps), 1);
+    QVERIFY(reactor.start(1));
+
+    // 開始コマンドに応えて返したスキャンを受け取れる
+    char command[64];
+    QVERIFY(::read(closing_pair[1], command, sizeof(command)) > 0);
+    string frame = meFrame();
+    QCOMPARE(::write(closing_pair[1], frame.data(), frame.size()),
+             static_cast<ssize_t>(frame.size()));
+    ScanData* scan = NULL;
+    QTRY_VERIFY((scan = reactor.takeScan(0)) != NULL);
+    QCOMPARE(scan->steps(), int(UtmSteps));
+    QCOMPARE(scan->timestamp, Q_INT64_C(123456));
+    reactor.releaseScan(0, scan);
+    QVERIFY(! reactor.statistics(0).closed);
+
+    // 閉じた接続も、エラーになった接続も登録から外れる
+    ::close(closing_pair[1]);
+    struct linger reset;
+    reset.l_onoff = 1;
+    reset.l_linger = 0;
+    setsockopt(reset_pair[1], SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    ::close(reset_pair[1]);
+
+    QTRY_VERIFY(reactor.statistics(0).closed);
+    QTRY_VERIFY(reactor.statistics(1).closed);
+
+    // 切れた接続には、止めるときの QT も送らない
+    int closing_sends = closing.sends();
+    int resetting_sends = resetting.sends();
+    reactor.stop();
+    QCOMPARE(closing.sends(), closing_sends);
+    QCOMPARE(resetting.sends(), resetting_sends);
+    ::close(closing_pair[0]);
+    ::close(reset_pair[0]);
+#else
+    QSKIP("epoll is only available on Linux");
+#endif
+}
+
+
+void TestUrgDevice::spscQueue()
+{
+    SpscQueue<int> queue(3);
+    QCOMPARE(queue.capacity(), static_cast<size_t>(3));
+    QVERIFY(queue.empty());
+
+    // 満杯になるまで追加でき、追加した順に取り出せる
+    int value = 0;
+    QVERIFY(!queue.pop(value));
+    for (int i = 0; i < 3; ++i) {
+        QVERIFY(queue.push(i));
+    }
+    QVERIFY(!queue.push(3));
+    QCOMPARE(queue.size(), static_cast<size_t>(3));
+
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(queue.pop(value));
+        QCOMPARE(value, i);
+        QVERIFY(queue.push(i + 3));
+    }
+    QCOMPARE(queue.size(), static_cast<size_t>(3));
+}
+
+
+void TestUrgDevice::tripleBuffer()
+{
+    TripleBuffer<int> buffer;
+    QVERIFY(!buffer.update());
+
+    buffer.back() = 1;
+    buffer.publish();
+    QVERIFY(buffer.update());
+    QCOMPARE(buffer.front(), 1);
+    QVERIFY(!buffer.update());
+
+    // 読み出される前に公開された値は、新しい値で置き換えられる
+    for (int i = 2; i <= 4; ++i) {
+        buffer.back() = i;
+        buffer.publish();
+    }
+    QVERIFY(buffer.update());
+    QCOMPARE(buffer.front(), 4);
+    QCOMPARE(buffer.superseded(), static_cast<size_t>(2));
+}
+
+
+void TestUrgDevice::captureCounters()
+{
+    // 2 のべき乗ごとのバケットに振り分けられる
+    QCOMPARE(CaptureHistogram::bucket(0), 0);
+    QCOMPARE(CaptureHistogram::bucket(1), 1);
+    QCOMPARE(CaptureHistogram::bucket(1023), 10);
+    QCOMPARE(CaptureHistogram::bucket(1024), 11);
+    QCOMPARE(CaptureHistogram::bucket(Q_INT64_C(1) << 40),
+             int(CaptureHistogram::Buckets) - 1);
+
+    CaptureCounters counters;
+    for (int i = 0; i < 100; ++i) {
+        counters.addParseTime((i < 90) ? 100 : 5000);
+    }
+    counters.queueIn();
+    counters.queueIn();
+    counters.queueOut();
+    counters.addDroppedFrame();
+    counters.addBytesSent(5);
+    counters.addBytesSent(-1);
+
+    CaptureStatistics statistics = counters.snapshot();
+    QCOMPARE(statistics.parse_time.total(), Q_UINT64_C(100));
+    QCOMPARE(statistics.parse_time.percentile(0.5), Q_INT64_C(128));
+    QCOMPARE(statistics.parse_time.percentile(0.99), Q_INT64_C(8192));
+    QCOMPARE(statistics.queue_depth, 1u);
+    QCOMPARE(statistics.max_queue_depth, 2u);
+    QCOMPARE(statistics.dropped_frames, Q_UINT64_C(1));
+    QCOMPARE(statistics.bytes_sent, Q_UINT64_C(5));
+
+    // 最後のバケットは上限がないので、下限を返す
+    counters.addParseTime(Q_INT64_C(1) << 40);
+    statistics = counters.snapshot();
+    QCOMPARE(statistics.parse_time.percentile(1.0),
+             CaptureHistogram::upperBound(CaptureHistogram::Buckets - 2));
+
+    counters.reset();
+    statistics = counters.snapshot();
+    QCOMPARE(statistics.parse_time.total(), Q_UINT64_C(0));
+    QCOMPARE(statistics.max_queue_depth, 0u);
+}
+
+
+void TestUrgDevice::baudrateProbe()
+{
+    QTemporaryDir directory;
+    BaudrateCache::setFileName(directory.path() + "/BaudrateCache.ini");
+
+    // 文字化けした応答の長さから見積もって、候補の並び順より早く 921600 bps に着く
+    // (並び順のままでは 12 回目)
+    SimulatedSensor sensor(921600);
+    ScipHandler scip;
+    scip.setConnection(&sensor);
+    QVERIFY(scip.connect("/dev/simulated", 115200));
+    QCOMPARE(sensor.baudrate(), 921600L);
+    QVERIFY(sensor.commands() < static_cast<size_t>(12));
+
+    // 記録したボーレートは最初に試す
+    BaudrateCache::store("/dev/simulated", 921600);
+    QCOMPARE(BaudrateCache::lookup("/dev/simulated"), 921600L);
+    QVERIFY(scip.connect("/dev/simulated", 115200));
+    QCOMPARE(sensor.commands(), static_cast<size_t>(1));
+
+    BaudrateCache::setFileName(QString());
+}
+
+
+void TestUrgDevice::commandDiscovery()
+{
+    QTemporaryDir directory;
+    BaudrateCache::setFileName(directory.path() + "/BaudrateCache.ini");
+    CommandCache::setFileName(directory.path() + "/CommandCache.ini");
+
+    QStringList expected;
+    expected << "GD" << "MD" << "VV";
+
+    SimulatedSensor sensor(115200);
+    sensor.setSupportedCommands(QStringList(expected) << "RB" << "%ST" << "$XY");
+    ScipHandler scip;
+    scip.setConnection(&sensor);
+    QVERIFY(scip.connect("/dev/simulated", 115200));
+
+    // センサの状態を変えるコマンドは送らない
+    QStringList commands;
+    bool complete = false;
+    QVector<string> supported = scip.supportedCommands(&complete);
+    QVERIFY(complete);
+    for (int i = 0; i < supported.size(); ++i) {
+        commands << QString::fromStdString(supported[i]);
+    }
+    commands.sort();
+    expected.sort();
+    QCOMPARE(commands, expected);
+    QVERIFY(! sensor.received("RB"));
+    QVERIFY(! sensor.received("%ST"));
+    QVERIFY(! sensor.received("$XY"));
+    QCOMPARE(scip.supportedModes(), QStringList() << "GD" << "MD");
+
+    // 1 つずつ送り直しても応答のないコマンドがあれば、結果は不完全
+    sensor.setSilentCommands(QStringList() << "ME");
+    QCOMPARE(scip.supportedModes(&complete), QStringList() << "GD" << "MD");
+    QVERIFY(! complete);
+
+    // 機種とファームウェアが同じなら、記録した結果を返す
+    CommandCache::store("UTM-30LX", "1.19.00", "modes", QStringList() << "GD");
+    QCOMPARE(CommandCache::lookup("UTM-30LX", "1.19.00", "modes"),
+             QStringList() << "GD");
+    QVERIFY(CommandCache::lookup("UTM-30LX", "1.20.00", "modes").isEmpty());
+    CommandCache::remove("UTM-30LX", "1.19.00");
+    QVERIFY(CommandCache::lookup("UTM-30LX", "1.19.00", "modes").isEmpty());
+
+    CommandCache::setFileName(QString());
+    BaudrateCache::setFileName(QString());
+}
+
+
+void TestUrgDevice::pipelinedCommands()
+{
+    QTemporaryDir directory;
+    BaudrateCache::setFileName(directory.path() + "/BaudrateCache.ini");
+
+    SimulatedSensor sensor(115200);
+    sensor.setSupportedCommands(QStringList() << "PP" << "VV");
+    ScipHandler scip;
+    scip.setConnection(&sensor);
+    QVERIFY(scip.connect("/dev/simulated", 115200));
+
+    // 応答を待たずに送り、エコーバックで応答を対応付ける
+    ScipReply pp = scip.post("PP");
+    ScipReply xx = scip.post("XX");
+    ScipReply vv = scip.post("VV");
+    QCOMPARE(scip.pendingReplies(), 3);
+    QVERIFY(! pp.isReady());
+
+    QVERIFY(scip.wait(vv));
+    QVERIFY(pp.isReady());
+    QVERIFY(xx.isReady());
+    QCOMPARE(pp.status(), 0);
+    QCOMPARE(xx.status(), 0x0E);
+    QCOMPARE(vv.status(), 0);
+    QCOMPARE(scip.pendingReplies(), 0);
+
+    // 送信していないコマンドは待たない
+    ScipReply none;
+    QVERIFY(! scip.wait(none));
+
+    BaudrateCache::setFileName(QString());
+}
+
+
+void TestUrgDevice::ubhIndex()
+{
+    QTemporaryDir directory;
+    QString file_name = directory.path() + "/scan.ubh";
+
+    SensorDataArray ranges;
+    SensorDataArray levels;
+    for (int i = 0; i < 3; ++i) {
+        ranges.steps << (QVector<long>() << 1000 + i);
+    }
+
+    UrgLogHandler writer;
+    QVERIFY(writer.create(file_name));
+    writer.addCaptureMode(MD_Capture_mode);
+    writer.addStartStep(0);
+    writer.addEndStep(2);
+    for (int i = 0; i < 3; ++i) {
+        writer.addData(ranges, levels, 1000 + (i * 25));
+    }
+    writer.close();
+
+    // 記録しながら書いた索引は、そのまま読み込める
+    UbhIndex index;
+    QVERIFY(index.load(file_name));
+    QVERIFY(index.isMapped());
+    QCOMPARE(index.size(), 3);
+    QCOMPARE(index.timestamp(2), 1050L);
+    index.clear();
+
+    UrgLogHandler reader;
+    QVERIFY(reader.load(file_name));
+    QVERIFY(reader.init());
+    QCOMPARE(reader.getTotalTimestamps(), 3L);
+    QCOMPARE(reader.setDataPos(2), 2L);
+    long timestamp = 0;
+    QCOMPARE(reader.getData(ranges, levels, timestamp), 2L);
+    QCOMPARE(timestamp, 1050L);
+    reader.close();
+
+    // ログと合わなくなった索引は使わず、走査して作り直す
+    QFile log(file_name);
+    QVERIFY(log.open(QIODevice::Append));
+    log.write("\n");
+    log.close();
+    QVERIFY(!index.load(file_name));
+
+    QVERIFY(reader.load(file_name));
+    QVERIFY(reader.init());
+    QCOMPARE(reader.getTotalTimestamps(), 3L);
+    reader.close();
+    QVERIFY(index.load(file_name));
+    QCOMPARE(index.size(), 3);
+    QCOMPARE(index.timestamp(0), 1000L);
+}
+
+
+void TestUrgDevice::ubhIndexer()
+{
+    QTemporaryDir directory;
+    QString file_name = directory.path() + "/legacy.ubh";
+
+    // 改行が CRLF で、最後の記録に時刻のない古いログ
+    QByteArray log = "[model]\r\nUTM-30LX\r\n[timestampOffset]\r\n0\r\n";
+    QVector<qint64> offsets;
+    for (int i = 0; i < 3; ++i) {
+        offsets << log.size();
+        log += "[timestamp]\r\n" + QByteArray::number(2000 + i) +
+                "\r\n[logtime]\r\n2016-01-01 00:00:00.000\r\n[scan]\r\n1;2;3\r\n";
+    }
+    offsets << log.size();
+    log += "[timestamp]\r\n";
+
+    QFile file(file_name);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(log);
+    file.close();
+
+    UbhIndexer indexer(file_name);
+    indexer.setThreadCount(2);
+    QVERIFY(indexer.start());
+    QVERIFY(indexer.waitForDone());
+    QCOMPARE(indexer.progress(), 100);
+    QVERIFY(indexer.hasTruncatedRecord());
+
+    UbhIndex index;
+    QVERIFY(indexer.fill(index));
+    QCOMPARE(index.size(), 4);
+    for (int i = 0; i < 4; ++i) {
+        QCOMPARE(index.offset(i), offsets[i]);
+    }
+    QCOMPARE(index.timestamp(1), 2001L);
+    QCOMPARE(index.timestamp(3), 0L);
+
+    // 小さな範囲とブロックに分け、キーが境界をまたぐ位置をずらしながら試す
+    for (int padding = 0; padding < 24; ++padding) {
+        QByteArray padded = "[model]\r\n" + QByteArray(padding, 'x') + "\r\n";
+        QVector<qint64> expected;
+        for (int i = 0; i < 20; ++i) {
+            expected << padded.size();
+            padded += "[timestamp]\r\n" + QByteArray::number(3000 + i) +
+                    "\r\n[scan]\r\n1;2;3\r\n";
+        }
+
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        file.write(padded);
+        file.close();
+
+        UbhIndexer split(file_name);
+        split.setThreadCount(4);
+        split.setRangeSize(37);
+        split.setBlockSize(13);
+        QVERIFY(split.start());
+        QVERIFY(split.waitForDone());
+        QVERIFY(! split.hasTruncatedRecord());
+
+        QVERIFY(split.fill(index));
+        QCOMPARE(index.size(), expected.size());
+        for (int i = 0; i < expected.size(); ++i) {
+            QCOMPARE(index.offset(i), expected[i]);
+            QCOMPARE(index.timestamp(i), 3000L + i);
+        }
+    }
+}
+
+
+void TestUrgDevice::ubhMappedReader()
+{
+    QTemporaryDir directory;
+    QString file_name = directory.path() + "/multi.ubh";
+
+    SensorDataArray ranges;
+    SensorDataArray levels;
+    for (int i = 0; i < 4; ++i) {
+        ranges.steps << (QVector<long>() << 1000 + i << 2000 + i);
+        levels.steps << (QVector<long>() << 10 + i << 20 + i);
+    }
+
+    UrgLogHandler writer;
+    QVERIFY(writer.create(file_name));
+    writer.addCaptureMode(HE_Capture_mode);
+    writer.addStartStep(0);
+    writer.addEndStep(3);
+    for (int i = 0; i < 2; ++i) {
+        writer.addData(ranges, levels, 500 + i);
+    }
+    writer.close();
+
+    // 割り当てたログからの読み出しは、行単位の読み出しと同じ結果になる
+    QList<RangeCaptureMode> modes;
+    modes << HE_Capture_mode << HD_Capture_mode << GE_Capture_mode << GD_Capture_mode;
+    foreach (RangeCaptureMode mode, modes) {
+        UrgLogHandler mapped;
+        UrgLogHandler legacy;
+        legacy.useMapping(false);
+        QList<UrgLogHandler*> readers;
+        readers << &mapped << &legacy;
+        foreach (UrgLogHandler* reader, readers) {
+            QVERIFY(reader->load(file_name));
+            QVERIFY(reader->getDataInit());
+            reader->setCaptureMode(mode);
+            reader->setReadStartStep(1);
+            reader->setReadEndStep(2);
+        }
+
+        for (int i = 0; i < 2; ++i) {
+            ScanData expected;
+            ScanData actual;
+            long expected_timestamp = 0;
+            long actual_timestamp = 0;
+            QCOMPARE(legacy.getData(expected, expected_timestamp), long(i));
+            QCOMPARE(mapped.getData(actual, actual_timestamp), long(i));
+            QCOMPARE(actual_timestamp, 500L + i);
+            QCOMPARE(actual_timestamp, expected_timestamp);
+            QCOMPARE(actual.steps(), 2);
+            QCOMPARE(actual.ranges, expected.ranges);
+            QCOMPARE(actual.levels, expected.levels);
+            QCOMPARE(actual.echoOffsets, expected.echoOffsets);
+        }
+
+        ScanData scan;
+        long timestamp = 0;
+        QCOMPARE(mapped.getData(scan, timestamp), -1L);
+        QVERIFY(scan.isEmpty());
+    }
+}
+
+
+void TestUrgDevice::ubhWriterFormat()
+{
+    QTemporaryDir directory;
+    QString file_name = directory.path() + "/format.ubh";
+
+    // 強度の欠けたエコー、空のステップ、負の値
+    SensorDataArray ranges;
+    SensorDataArray levels;
+    ranges.steps << (QVector<long>() << 1000 << 2000) << QVector<long>() << (QVector<long>() << -5);
+    levels.steps << (QVector<long>() << 10);
+
+    UrgLogHandler writer;
+    QVERIFY(writer.create(file_name));
+    writer.addCaptureMode(HE_Capture_mode);
+    QVERIFY(writer.addData(ranges, levels, 123456789) > 0);
+    writer.setCaptureMode(GD_Capture_mode);
+    QVERIFY(writer.addData(ranges, levels, 0) > 0);
+    writer.close();
+
+    QFile file(file_name);
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+    QStringList lines = QString::fromLocal8Bit(file.readAll()).split('\n');
+    int first = lines.indexOf("[timestamp]");
+    QVERIFY(first >= 0);
+    QCOMPARE(lines.at(first + 1), QString("123456789"));
+    QCOMPARE(lines.at(first + 4), QString("[scan]"));
+    QCOMPARE(lines.at(first + 5), QString("1000|10&2000|0;;-5|0"));
+    QCOMPARE(lines.at(first + 6), QString("[timestamp]"));
+    QCOMPARE(lines.at(first + 7), QString("0"));
+    QCOMPARE(lines.at(first + 11), QString("1000;0;-5"));
+}
+
+
+void TestUrgDevice::ubhAsyncWriter()
+{
+    QTemporaryDir directory;
+    QStringList file_names;
+    file_names << directory.path() + "/sync.ubh" << directory.path() + "/async.ubh";
+
+    for (int n = 0; n < file_names.size(); ++n) {
+        UrgLogHandler writer;
+        if (n > 0) {
+            writer.useAsync(true, 4, UrgLogHandler::BlockWhenFull);
+        }
+        QVERIFY(writer.create(file_names.at(n)));
+        writer.addCaptureMode(HE_Capture_mode);
+
+        ScanData scan;
+        for (int i = 0; i < 100; ++i) {
+            for (int step = 0; step < 10; ++step) {
+                scan.addStep();
+                scan.addEcho(1000 + i + step, 10 + step);
+                scan.addEcho(2000 + i + step, 20 + step);
+            }
+            QVERIFY(writer.takeData(scan, i) > 0);
+            QVERIFY(scan.isEmpty());
+        }
+        writer.close();
+        QCOMPARE(writer.queueDepth(), 0);
+        QCOMPARE(writer.droppedRecords(), quint64(0));
+
+        // 書き込みスレッドが書いた索引も使える
+        UbhIndex index;
+        QVERIFY(index.load(file_names.at(n)));
+        QCOMPARE(index.size(), 100);
+        QCOMPARE(index.timestamp(99), 99L);
+
+        // まとめて書いた記録の位置も、ファイル上の記録の先頭を指す
+        QFile file(file_names.at(n));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QByteArray data = file.readAll();
+        for (int i = 0; i < index.size(); ++i) {
+            QCOMPARE(data.mid(index.offset(i), 11), QByteArray("[timestamp]"));
+        }
+    }
+
+    // 記録した時刻の行を除けば、同期で書いたログと同じ
+    QList<QByteArray> logs;
+    foreach (const QString &file_name, file_names) {
+        QFile file(file_name);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QList<QByteArray> lines = file.readAll().split('\n');
+        for (int i = lines.size() - 1; i > 0; --i) {
+            if (lines.at(i - 1).startsWith("[logtime]")) {
+                lines.removeAt(i);
+            }
+        }
+        logs << QByteArray();
+        foreach (const QByteArray &line, lines) {
+            logs.last() += line + '\n';
+        }
+    }
+    QCOMPARE(logs.at(1), logs.at(0));
+}
+
+
+void TestUrgDevice::connectBenchmark()
+{
+    QTemporaryDir directory;
+    BaudrateCache::setFileName(directory.path() + "/BaudrateCache.ini");
+
+    SimulatedSensor sensor(750000);
+    ScipHandler scip;
+    scip.setConnection(&sensor);
+    QBENCHMARK {
+        QVERIFY(scip.connect("/dev/simulated", 115200));
+    }
+
+    BaudrateCache::setFileName(QString());
+}
+
 QTEST_MAIN(TestUrgDevice)
 
@@ -37,6 +37,31 @@ public:
 
 private slots:
     void connection();
+    void asyncCaptureStop();
+    void readlineBenchmark_data();
+    void readlineBenchmark();
+    void frameParser_data();
+    void frameParser();
+    void frameParserLazyChecksum();
+    void scipLazyChecksum();
+    void scipDecoder_data();
+    void scipDecoder();
+    void scanDataAdapter();
+    void scanBufferPool();
+    void ringBuffer();
+    void scanReactor();
+    void spscQueue();
+    void tripleBuffer();
+    void captureCounters();
+    void baudrateProbe();
+    void commandDiscovery();
+    void pipelinedCommands();
+    void ubhIndex();
+    void ubhIndexer();
+    void ubhMappedReader();
+    void ubhWriterFormat();
+    void ubhAsyncWriter();
+    void connectBenchmark();
 };
 
 
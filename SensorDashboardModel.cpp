@@ -0,0 +1,433 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "SensorDashboardModel.h"
+
+#include <QAtomicInt>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QStringList>
+
+//! Shared by a row and its query, so the row can wait for that query alone
+struct SensorDashboardModel::QueryState
+{
+    enum {
+        Queued = 0,
+        Running,
+        Canceled,
+    };
+
+    QAtomicInt state;
+    QSemaphore done;    //!< released when a running query has finished
+
+    QueryState() : state(Queued) {}
+};
+
+namespace
+{
+enum {
+    MaxQueryThreads = 16,
+};
+
+class DashboardQuery : public QRunnable
+{
+public:
+    typedef QSharedPointer<SensorDashboardModel::QueryState> State;
+
+    DashboardQuery(QObject* model, RangeSensor* sensor, bool identify,
+                   const QElapsedTimer &clock, const State &state)
+        : m_model(model)
+        , m_sensor(sensor)
+        , m_identify(identify)
+        , m_clock(clock)
+        , m_state(state)
+    {
+    }
+
+    void run()
+    {
+        // The row was removed while this query waited for a pool thread
+        if (!m_state->state.testAndSetOrdered(SensorDashboardModel::QueryState::Queued,
+                                              SensorDashboardModel::QueryState::Running)) {
+            return;
+        }
+
+        DashboardSample sample;
+        sample.sensor = m_sensor;
+
+        {
+            // Queued behind the loader and any other command to this sensor
+            QMutexLocker locker(m_sensor->commandMutex());
+            QElapsedTimer timer;
+            timer.start();
+
+            // A capturing sensor is left alone, its counters are enough
+            if (m_sensor->isConnected() && !m_sensor->isWorking()) {
+                if (m_identify) {
+                    sample.parameter = m_sensor->parameterNow();
+                    sample.information = m_sensor->informationNow();
+                    sample.identified = true;
+                }
+                sample.internalInformation = m_sensor->internalInformationNow();
+                sample.polled = true;
+            }
+            sample.latency = timer.elapsed();
+        }
+
+        sample.statistics = m_sensor->captureStatistics();
+        sample.time = m_clock.elapsed();
+
+        QMetaObject::invokeMethod(m_model, "applySample", Qt::QueuedConnection,
+                                  Q_ARG(DashboardSample, sample));
+        m_state->done.release();
+    }
+
+private:
+    QObject* m_model;
+    RangeSensor* m_sensor;
+    bool m_identify;
+    const QElapsedTimer &m_clock;
+    State m_state;
+};
+}
+
+SensorDashboardModel::Row::Row()
+    : sensor(NULL)
+    , logger(NULL)
+    , busy(false)
+    , identified(false)
+    , motorSpeed(0)
+    , framesPerSecond(0.0)
+    , hasStatistics(false)
+    , latency(-1)
+    , lastFrames(0)
+    , lastTime(-1)
+{
+}
+
+SensorDashboardModel::SensorDashboardModel(QObject* parent)
+    : QAbstractTableModel(parent)
+{
+    qRegisterMetaType<DashboardSample>();
+    m_pool.setMaxThreadCount(MaxQueryThreads);
+    m_clock.start();
+}
+
+SensorDashboardModel::~SensorDashboardModel()
+{
+    m_pool.waitForDone();
+}
+
+void SensorDashboardModel::addSensor(RangeSensor* sensor)
+{
+    if (!sensor || sensorRow(sensor) >= 0) {
+        return;
+    }
+
+    Row row;
+    row.sensor = sensor;
+    if (sensor->connection()) {
+        row.device = sensor->connection()->getDevice();
+    }
+
+    beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size());
+    m_rows.append(row);
+    endInsertRows();
+}
+
+void SensorDashboardModel::removeSensor(RangeSensor* sensor)
+{
+    int row = sensorRow(sensor);
+    if (row < 0) {
+        return;
+    }
+
+    // A query still queued is dropped, one already running is waited for;
+    // queries of the other sensors are left alone
+    const Row &removed = m_rows[row];
+    if (removed.busy && removed.query &&
+            !removed.query->state.testAndSetOrdered(QueryState::Queued,
+                                                    QueryState::Canceled)) {
+        removed.query->done.acquire();
+    }
+    removeRow(row);
+}
+
+void SensorDashboardModel::addLogger(UrgLogHandler* logger)
+{
+    if (!logger || loggerRow(logger) >= 0) {
+        return;
+    }
+
+    Row row;
+    row.logger = logger;
+    row.device = logger->getFileName();
+    row.model = logger->getModel();
+    row.serialNumber = logger->getSerialNumber();
+    row.firmware = logger->getFirmwareVersion();
+    row.motorSpeed = logger->getMotorSpeed();
+
+    beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size());
+    m_rows.append(row);
+    endInsertRows();
+}
+
+void SensorDashboardModel::removeLogger(UrgLogHandler* logger)
+{
+    int row = loggerRow(logger);
+    if (row >= 0) {
+        removeRow(row);
+    }
+}
+
+void SensorDashboardModel::refresh()
+{
+    for (int i = 0; i < m_rows.size(); ++i) {
+        Row &row = m_rows[i];
+        if (!row.sensor || row.busy) {
+            continue;
+        }
+        row.busy = true;
+        row.query = QSharedPointer<QueryState>(new QueryState);
+        m_pool.start(new DashboardQuery(this, row.sensor, !row.identified, m_clock,
+                                        row.query));
+    }
+}
+
+void SensorDashboardModel::applySample(const DashboardSample &sample)
+{
+    int i = sensorRow(sample.sensor);
+    if (i < 0) {
+        return;
+    }
+
+    Row &row = m_rows[i];
+    row.busy = false;
+
+    if (sample.identified) {
+        row.identified = true;
+        row.model = QString::fromStdString(sample.parameter.model);
+        row.serialNumber = QString::fromStdString(sample.information.serial_number);
+        row.firmware = QString::fromStdString(sample.information.firmware);
+        row.motorSpeed = sample.parameter.scan_rpm;
+    }
+    if (sample.polled) {
+        row.laser = QString::fromStdString(sample.internalInformation.laserStatus);
+        row.state = QString::fromStdString(sample.internalInformation.stateID);
+        row.latency = sample.latency;
+    }
+    if (row.sensor->connection()) {
+        row.device = row.sensor->connection()->getDevice();
+    }
+
+    const CaptureStatistics &statistics = sample.statistics;
+    if (row.lastTime >= 0 && sample.time > row.lastTime &&
+            statistics.frames >= row.lastFrames) {
+        row.framesPerSecond = (statistics.frames - row.lastFrames) * 1000.0 /
+                (sample.time - row.lastTime);
+    }
+    row.lastFrames = statistics.frames;
+    row.lastTime = sample.time;
+    row.statistics = statistics;
+    row.hasStatistics = true;
+
+    emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
+}
+
+int SensorDashboardModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_rows.size();
+}
+
+int SensorDashboardModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(ColumnCount);
+}
+
+QVariant SensorDashboardModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    // Numbers are returned as numbers so that the columns sort numerically
+    const Row &row = m_rows[index.row()];
+    bool live = row.hasStatistics;
+    const CaptureStatistics &statistics = row.statistics;
+    switch (index.column()) {
+    case DeviceColumn:
+        return row.device;
+    case ModelColumn:
+        return row.model;
+    case SerialNumberColumn:
+        return row.serialNumber;
+    case FirmwareColumn:
+        return row.firmware;
+    case MotorSpeedColumn:
+        return row.motorSpeed > 0 ? QVariant(qlonglong(row.motorSpeed)) : QVariant();
+    case LaserColumn:
+        return row.laser;
+    case StateColumn:
+        return row.state;
+    case FramesPerSecondColumn:
+        return live ? QVariant(qRound(row.framesPerSecond * 10) / 10.0) : QVariant();
+    case ChecksumErrorsColumn:
+        return live ? QVariant(qulonglong(statistics.checksum_errors)) : QVariant();
+    case TimeoutsColumn:
+        return live ? QVariant(qulonglong(statistics.timeouts)) : QVariant();
+    case DroppedFramesColumn:
+        return live ? QVariant(qulonglong(statistics.dropped_frames)) : QVariant();
+    case EchobackMismatchesColumn:
+        return live ? QVariant(qulonglong(statistics.echoback_mismatches)) : QVariant();
+    case BytesReceivedColumn:
+        return live ? QVariant(qulonglong(statistics.bytes_received)) : QVariant();
+    case BytesSentColumn:
+        return live ? QVariant(qulonglong(statistics.bytes_sent)) : QVariant();
+    case QueueDepthColumn:
+        return live ? QVariant(statistics.queue_depth) : QVariant();
+    case ParseTimeColumn:
+        return live && statistics.parse_time.total() > 0 ?
+                    QVariant(qlonglong(statistics.parse_time.percentile(0.99))) : QVariant();
+    case ReceiveLatencyColumn:
+        return live && statistics.receive_latency.total() > 0 ?
+                    QVariant(statistics.receive_latency.percentile(0.99) / 1000.0) : QVariant();
+    case LatencyColumn:
+        return row.latency >= 0 ? QVariant(qlonglong(row.latency)) : QVariant();
+    default:
+        return QVariant();
+    }
+}
+
+QVariant SensorDashboardModel::headerData(int section, Qt::Orientation orientation,
+                                          int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case DeviceColumn:
+        return tr("Device");
+    case ModelColumn:
+        return tr("Model");
+    case SerialNumberColumn:
+        return tr("Serial number");
+    case FirmwareColumn:
+        return tr("Firmware");
+    case MotorSpeedColumn:
+        return tr("Motor speed [rpm]");
+    case LaserColumn:
+        return tr("Laser");
+    case StateColumn:
+        return tr("State");
+    case FramesPerSecondColumn:
+        return tr("Frames/s");
+    case ChecksumErrorsColumn:
+        return tr("Checksum errors");
+    case TimeoutsColumn:
+        return tr("Timeouts");
+    case DroppedFramesColumn:
+        return tr("Dropped");
+    case EchobackMismatchesColumn:
+        return tr("Echoback mismatches");
+    case BytesReceivedColumn:
+        return tr("Bytes in");
+    case BytesSentColumn:
+        return tr("Bytes out");
+    case QueueDepthColumn:
+        return tr("Queue depth");
+    case ParseTimeColumn:
+        return tr("Parse p99 [us]");
+    case ReceiveLatencyColumn:
+        return tr("Receive p99 [ms]");
+    case LatencyColumn:
+        return tr("II latency [ms]");
+    default:
+        return QVariant();
+    }
+}
+
+void SensorDashboardModel::exportStatistics(QTextStream &stream) const
+{
+    QStringList header;
+    for (int column = 0; column < ColumnCount; ++column) {
+        header << headerData(column, Qt::Horizontal).toString();
+    }
+    // Buckets are named after their upper bound, the last one is open
+    QStringList buckets;
+    for (int i = 0; i < CaptureHistogram::Buckets - 1; ++i) {
+        buckets << QString("<%1us").arg(CaptureHistogram::upperBound(i));
+    }
+    buckets << QString(">=%1us").arg(CaptureHistogram::upperBound(CaptureHistogram::Buckets - 2));
+    foreach (const QString &bucket, buckets) {
+        header << tr("Parse") + ' ' + bucket;
+    }
+    foreach (const QString &bucket, buckets) {
+        header << tr("Receive") + ' ' + bucket;
+    }
+    stream << header.join(',') << endl;
+
+    for (int row = 0; row < m_rows.size(); ++row) {
+        QStringList fields;
+        for (int column = 0; column < ColumnCount; ++column) {
+            QString field = data(index(row, column)).toString();
+            if (field.contains(',') || field.contains('"')) {
+                field = '"' + field.replace('"', "\"\"") + '"';
+            }
+            fields << field;
+        }
+        const CaptureStatistics &statistics = m_rows[row].statistics;
+        for (int i = 0; i < CaptureHistogram::Buckets; ++i) {
+            fields << QString::number(statistics.parse_time.counts[i]);
+        }
+        for (int i = 0; i < CaptureHistogram::Buckets; ++i) {
+            fields << QString::number(statistics.receive_latency.counts[i]);
+        }
+        stream << fields.join(',') << endl;
+    }
+}
+
+int SensorDashboardModel::sensorRow(RangeSensor* sensor) const
+{
+    for (int i = 0; i < m_rows.size(); ++i) {
+        if (m_rows[i].sensor == sensor) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int SensorDashboardModel::loggerRow(UrgLogHandler* logger) const
+{
+    for (int i = 0; i < m_rows.size(); ++i) {
+        if (m_rows[i].logger == logger) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SensorDashboardModel::removeRow(int row)
+{
+    beginRemoveRows(QModelIndex(), row, row);
+    m_rows.remove(row);
+    endRemoveRows();
+}
@@ -0,0 +1,155 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef SENSORDASHBOARDMODEL_H
+#define SENSORDASHBOARDMODEL_H
+
+#include <QAbstractTableModel>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include "RangeSensor.h"
+#include "CaptureStatistics.h"
+#include "UrgLogHandler.h"
+
+using namespace qrk;
+
+//! Result of one dashboard query of a sensor, made on a pool thread
+struct DashboardSample
+{
+    RangeSensor* sensor;
+    bool identified;    //!< parameter and information were loaded
+    bool polled;        //!< internalInformation was loaded
+    RangeSensorParameter parameter;
+    RangeSensorInformation information;
+    RangeSensorInternalInformation internalInformation;
+    CaptureStatistics statistics;
+    qint64 latency;     //!< [msec] of the queries
+    qint64 time;        //!< [msec] when the statistics were read
+
+    DashboardSample()
+        : sensor(NULL), identified(false), polled(false), latency(0), time(0) {}
+};
+
+Q_DECLARE_METATYPE(DashboardSample)
+
+/*!
+  \brief One row per sensor or log file, with live capture rates
+
+  refresh() queries every sensor on a thread pool, at most one query per
+  sensor at a time, so a slow link only delays its own row. PP and VV are
+  read once per sensor, II on each refresh while the sensor is idle; the
+  capture counters are read on each refresh without touching the link.
+*/
+class SensorDashboardModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        DeviceColumn = 0,
+        ModelColumn,
+        SerialNumberColumn,
+        FirmwareColumn,
+        MotorSpeedColumn,
+        LaserColumn,
+        StateColumn,
+        FramesPerSecondColumn,
+        ChecksumErrorsColumn,
+        TimeoutsColumn,
+        DroppedFramesColumn,
+        EchobackMismatchesColumn,
+        BytesReceivedColumn,
+        BytesSentColumn,
+        QueueDepthColumn,
+        ParseTimeColumn,
+        ReceiveLatencyColumn,
+        LatencyColumn,
+        ColumnCount,
+    };
+
+    explicit SensorDashboardModel(QObject* parent = 0);
+    virtual ~SensorDashboardModel();
+
+    void addSensor(RangeSensor* sensor);
+    //! Waits for a query already running on \p sensor, a queued one is dropped
+    void removeSensor(RangeSensor* sensor);
+    void addLogger(UrgLogHandler* logger);
+    void removeLogger(UrgLogHandler* logger);
+
+    /*!
+      \brief Write every sensor with its capture statistics as CSV
+
+      The columns of the table are followed by the bucket counts of the
+      parse time and receive latency histograms.
+    */
+    void exportStatistics(QTextStream &stream) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+
+public slots:
+    void refresh();
+
+private slots:
+    void applySample(const DashboardSample &sample);
+
+private:
+    struct QueryState;
+
+    struct Row {
+        RangeSensor* sensor;
+        UrgLogHandler* logger;
+        bool busy;
+        QSharedPointer<QueryState> query;
+        bool identified;
+        QString device;
+        QString model;
+        QString serialNumber;
+        QString firmware;
+        long motorSpeed;
+        QString laser;
+        QString state;
+        double framesPerSecond;
+        bool hasStatistics;
+        CaptureStatistics statistics;
+        qint64 latency;
+        quint64 lastFrames;
+        qint64 lastTime;
+
+        Row();
+    };
+
+    QVector<Row> m_rows;
+    QThreadPool m_pool;
+    QElapsedTimer m_clock;
+
+    int sensorRow(RangeSensor* sensor) const;
+    int loggerRow(UrgLogHandler* logger) const;
+    void removeRow(int row);
+};
+
+#endif // SENSORDASHBOARDMODEL_H
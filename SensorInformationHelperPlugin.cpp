@@ -32,8 +32,40 @@
 #include <QDateTime>
 #include <QAction>
 
+#include <cstdlib>
+
 using namespace std;
 
+namespace
+{
+double leadingNumber(const string &text)
+{
+    size_t first = text.find_first_of("0123456789");
+    if (first == string::npos) {
+        return 0.0;
+    }
+    return atof(text.c_str() + first);
+}
+
+struct ModelImage {
+    const char* prefix;
+    const char* resource;
+};
+
+// A model is matched against the prefixes in order, so a variant must
+// come before the model it derives from
+const ModelImage ModelImages[] = {
+    { "ubg-04lx-f01", ":/SensorInformationHelperPlugin/ubg-04lx-f01" },
+    { "urg-04lx-ug01", ":/SensorInformationHelperPlugin/urg-04lx-ug01" },
+    { "urg-04lx", ":/SensorInformationHelperPlugin/urg-04lx" },
+    { "utm-30lx-ew", ":/SensorInformationHelperPlugin/utm-30lx-ew" },
+    { "utm-30lx", ":/SensorInformationHelperPlugin/utm-30lx" },
+    { "uxm-30lx-ew", ":/SensorInformationHelperPlugin/uxm-30lx-ew" },
+};
+
+const char UnknownModelImage[] = ":/SensorInformationHelperPlugin/unknown";
+}
+
 SensorInformationHelperPlugin::SensorInformationHelperPlugin(QWidget* parent)
     : HelperPluginInterface(parent)
     , ui(new Ui::SensorInformationHelperPlugin)
@@ -41,6 +73,10 @@ SensorInformationHelperPlugin::SensorInformationHelperPlugin(QWidget* parent)
     REGISTER_FUNCTION(setDeviceMethod);
     REGISTER_FUNCTION(setLoggerMethod);
     REGISTER_FUNCTION(noReloadMethod);
+    REGISTER_FUNCTION(addDeviceMethod);
+    REGISTER_FUNCTION(removeDeviceMethod);
+    REGISTER_FUNCTION(addLoggerMethod);
+    REGISTER_FUNCTION(removeLoggerMethod);
 
     ui->setupUi(this);
 
@@ -66,6 +102,38 @@ SensorInformationHelperPlugin::SensorInformationHelperPlugin(QWidget* parent)
     connect(ui->homeButton, &QAbstractButton::clicked,
             this, &SensorInformationHelperPlugin::showSensorHomePage);
 
+    m_loader = new SensorInformationLoader(this);
+    connect(m_loader, &SensorInformationLoader::loaded,
+            this, &SensorInformationHelperPlugin::queryLoaded);
+    connect(m_loader, &QThread::finished,
+            this, &SensorInformationHelperPlugin::reloadFinished);
+    connect(m_loader, &SensorInformationLoader::sensorWorking,
+            this, &SensorInformationHelperPlugin::sensorWorking);
+    connect(ui->cancelButton, &QAbstractButton::clicked,
+            this, &SensorInformationHelperPlugin::cancelReload);
+
+    m_reloadTimer.setSingleShot(true);
+    connect(&m_reloadTimer, &QTimer::timeout,
+            this, &SensorInformationHelperPlugin::reloadTimedOut);
+    m_reloadCanceled = false;
+    m_loaderBusy = false;
+
+    QStringList trends;
+    trends << tr("Motor speed [rpm]") << tr("Laser") << tr("Timestamp drift [ms]") << tr("II latency [ms]");
+    ui->trendWidget->setSeries(trends, LiveSamples);
+    m_liveSample = false;
+    m_reloadQueued = false;
+    m_liveTimeValid = false;
+    m_lastSensorTime = 0;
+    m_lastHostTime = 0;
+    m_timestampDrift = 0.0;
+    connect(ui->liveCheckBox, &QAbstractButton::toggled,
+            this, &SensorInformationHelperPlugin::setLive);
+    connect(ui->liveIntervalSpinBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            &m_liveTimer, static_cast<void (QTimer::*)(int)>(&QTimer::setInterval));
+    connect(&m_liveTimer, &QTimer::timeout,
+            this, &SensorInformationHelperPlugin::liveSample);
+
     QAction* copyAction = new QAction(tr("Copy"), this);
     connect(copyAction, &QAction::triggered, this, &SensorInformationHelperPlugin::copy);
     ui->propertiesTable->setContextMenuPolicy(Qt::ActionsContextMenu);
@@ -74,25 +142,52 @@ SensorInformationHelperPlugin::SensorInformationHelperPlugin(QWidget* parent)
 
     //        ui->reloadButton->setEnabled(false);
 
-    ui->propertiesTable->setEditTriggers(QTableWidget::NoEditTriggers);
+    m_properties = new SensorPropertyModel(this);
+    m_modelImage = NULL;
+    ui->propertiesTable->setModel(m_properties);
+    ui->propertiesTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->propertiesTable->horizontalHeader()->setSectionResizeMode(SensorPropertyModel::NameColumn, QHeaderView::ResizeToContents);
+    ui->propertiesTable->horizontalHeader()->setSectionResizeMode(SensorPropertyModel::ValueColumn, QHeaderView::Stretch);
     ui->homeButton->setVisible(false);
 
+    m_dashboard = new SensorDashboardModel(this);
+    m_dashboardProxy = new QSortFilterProxyModel(this);
+    m_dashboardProxy->setSourceModel(m_dashboard);
+    ui->dashboardTable->setModel(m_dashboardProxy);
+    ui->dashboardTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->dashboardTable->sortByColumn(SensorDashboardModel::DeviceColumn, Qt::AscendingOrder);
+    ui->dashboardTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_dashboardTimer.setInterval(DashboardInterval);
+    connect(&m_dashboardTimer, &QTimer::timeout,
+            m_dashboard, &SensorDashboardModel::refresh);
+    connect(ui->tabWidget, &QTabWidget::currentChanged,
+            this, &SensorInformationHelperPlugin::dashboardTabChanged);
+    connect(ui->exportButton, &QAbstractButton::clicked,
+            this, &SensorInformationHelperPlugin::exportStatistics);
+
     m_sensor = NULL;
 }
 
 SensorInformationHelperPlugin::~SensorInformationHelperPlugin()
 {
+    m_dashboardTimer.stop();
+    // No new query starts; the one in progress cannot be aborted and ends
+    // within the ScipHandler response timeout
+    m_loader->requestInterruption();
+    m_loader->wait();
     delete ui;
 }
 
 void SensorInformationHelperPlugin::saveState(QSettings &settings)
 {    
     settings.setValue("widgetGeometry", saveGeometry());
+    settings.setValue("liveInterval", ui->liveIntervalSpinBox->value());
 }
 
 void SensorInformationHelperPlugin::restoreState(QSettings &settings)
 {
     restoreGeometry(settings.value("widgetGeometry", saveGeometry()).toByteArray());
+    ui->liveIntervalSpinBox->setValue(settings.value("liveInterval", ui->liveIntervalSpinBox->value()).toInt());
 }
 
 void SensorInformationHelperPlugin::loadTranslator(const QString &locale)
@@ -135,6 +230,48 @@ QVariant SensorInformationHelperPlugin::noReloadMethod(const QVariantList &vars)
     return QVariant();
 }
 
+QVariant SensorInformationHelperPlugin::addDeviceMethod(const QVariantList &vars)
+{
+    if(vars.size() == 1){
+        m_dashboard->addSensor((RangeSensor*)vars[0].value<void *>());
+    }
+    return QVariant();
+}
+
+QVariant SensorInformationHelperPlugin::removeDeviceMethod(const QVariantList &vars)
+{
+    if(vars.size() == 1){
+        RangeSensor* sensor = (RangeSensor*)vars[0].value<void *>();
+        m_dashboard->removeSensor(sensor);
+        if (sensor == m_sensor) {
+            ui->liveCheckBox->setChecked(false);
+            // The loader still uses the sensor until its current query ends
+            if (m_loader->isRunning()) {
+                m_loader->requestInterruption();
+                m_loader->wait();
+            }
+            m_sensor = NULL;
+        }
+    }
+    return QVariant();
+}
+
+QVariant SensorInformationHelperPlugin::addLoggerMethod(const QVariantList &vars)
+{
+    if(vars.size() == 1){
+        m_dashboard->addLogger((UrgLogHandler*)vars[0].value<void *>());
+    }
+    return QVariant();
+}
+
+QVariant SensorInformationHelperPlugin::removeLoggerMethod(const QVariantList &vars)
+{
+    if(vars.size() == 1){
+        m_dashboard->removeLogger((UrgLogHandler*)vars[0].value<void *>());
+    }
+    return QVariant();
+}
+
 void SensorInformationHelperPlugin::onLoad(PluginManagerInterface *manager)
 {
 
@@ -148,11 +285,13 @@ void SensorInformationHelperPlugin::onUnload()
 void SensorInformationHelperPlugin::setRangeSensor(RangeSensor* sensor)
 {
     m_sensor = sensor;
+    m_dashboard->addSensor(sensor);
 }
 
 void SensorInformationHelperPlugin::setLogger(UrgLogHandler* logger)
 {
     if (logger->isOpen()) {
+        m_dashboard->addLogger(logger);
         updateUI(logger);
         show();
     }
@@ -176,214 +315,288 @@ void SensorInformationHelperPlugin::updateUI(RangeSensorParameter pp,
                                        RangeSensorInternalInformation ii)
 {
     if (m_sensor) {
-        resetTable(21);
-        m_model = QString::fromStdString(pp.model).trimmed().toLower().split('(')[0];
-        if (m_model.startsWith("ubg-04lx-f01")) {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/ubg-04lx-f01")));
-        }
-        else if (m_model.startsWith("urg-04lx-ug01")) {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/urg-04lx-ug01")));
-        }
-        else if (m_model.startsWith("urg-04lx")) {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/urg-04lx")));
-        }
-        else if (m_model.startsWith("utm-30lx-ew")) {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/utm-30lx-ew")));
-        }
-        else if (m_model.startsWith("utm-30lx")) {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/utm-30lx")));
-        }
-        else if (m_model.startsWith("uxm-30lx-ew")) {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/uxm-30lx-ew")));
-        }
-        else {
-            ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/unknown")));
-        }
-
-        //PP
-        ui->propertiesTable->setItem(0, 0, new QTableWidgetItem(QString("Model")));
-        ui->propertiesTable->setItem(0, 1, new QTableWidgetItem(QString::fromStdString(pp.model)));
-
-        ui->propertiesTable->setItem(1, 0, new QTableWidgetItem(QString("Area front")));
-        ui->propertiesTable->setItem(1, 1, new QTableWidgetItem(QString::number(pp.area_front)));
-
-        ui->propertiesTable->setItem(2, 0, new QTableWidgetItem(QString("Area min")));
-        ui->propertiesTable->setItem(2, 1, new QTableWidgetItem(QString::number(pp.area_min)));
-
-        ui->propertiesTable->setItem(3, 0, new QTableWidgetItem(QString("Area max")));
-        ui->propertiesTable->setItem(3, 1, new QTableWidgetItem(QString::number(pp.area_max)));
-
-        ui->propertiesTable->setItem(4, 0, new QTableWidgetItem(QString("Area total")));
-        ui->propertiesTable->setItem(4, 1, new QTableWidgetItem(QString::number(pp.area_total)));
-
-        ui->propertiesTable->setItem(5, 0, new QTableWidgetItem(QString("Min distance [mm]")));
-        ui->propertiesTable->setItem(5, 1, new QTableWidgetItem(QString::number(pp.distance_min)));
-
-        ui->propertiesTable->setItem(6, 0, new QTableWidgetItem(QString("Max distance [mm]")));
-        ui->propertiesTable->setItem(6, 1, new QTableWidgetItem(QString::number(pp.distance_max)));
-
-        ui->propertiesTable->setItem(7, 0, new QTableWidgetItem(QString("Motor speed [rpm]")));
-        ui->propertiesTable->setItem(7, 1, new QTableWidgetItem(QString::number(pp.scan_rpm)));
-
-        //VV
-        ui->propertiesTable->setItem(8, 0, new QTableWidgetItem(QString("Product")));
-        ui->propertiesTable->setItem(8, 1, new QTableWidgetItem(QString::fromStdString(vv.product)));
-
-        ui->propertiesTable->setItem(9, 0, new QTableWidgetItem(QString("Protocol")));
-        ui->propertiesTable->setItem(9, 1, new QTableWidgetItem(QString::fromStdString(vv.protocol)));
-
-        ui->propertiesTable->setItem(10, 0, new QTableWidgetItem(QString("Firmware")));
-        ui->propertiesTable->setItem(10, 1, new QTableWidgetItem(QString::fromStdString(vv.firmware)));
-
-        ui->propertiesTable->setItem(11, 0, new QTableWidgetItem(QString("Serial number")));
-        ui->propertiesTable->setItem(11, 1, new QTableWidgetItem(QString::fromStdString(vv.serial_number)));
-
-        ui->propertiesTable->setItem(12, 0, new QTableWidgetItem(QString("Vendor")));
-        ui->propertiesTable->setItem(12, 1, new QTableWidgetItem(QString::fromStdString(vv.vendor)));
+        m_properties->setLayout(SensorPropertyModel::SensorLayout);
+        setModelImage(QString::fromStdString(pp.model));
+        m_properties->setParameter(pp);
+        m_properties->setInformation(vv);
+        m_properties->setInternalInformation(ii);
+        m_properties->setSupportedModes(m_sensor->supportedModes());
+    }
+}
 
-        //II
+void SensorInformationHelperPlugin::updateUI(UrgLogHandler *logger)
+{
+    setModelImage(logger->getModel());
+    m_properties->setLogger(logger);
+}
 
-        ui->propertiesTable->setItem(13, 0, new QTableWidgetItem(QString("Model")));
-        ui->propertiesTable->setItem(13, 1, new QTableWidgetItem(QString::fromStdString(ii.model)));
+void SensorInformationHelperPlugin::setModelImage(const QString &model)
+{
+    m_model = model.trimmed().toLower().split('(')[0];
 
-        ui->propertiesTable->setItem(14, 0, new QTableWidgetItem(QString("Communication type")));
-        ui->propertiesTable->setItem(14, 1, new QTableWidgetItem(QString::fromStdString(ii.communicationType)));
+    const char* resource = UnknownModelImage;
+    for (size_t i = 0; i < sizeof(ModelImages) / sizeof(ModelImages[0]); ++i) {
+        if (m_model.startsWith(QLatin1String(ModelImages[i].prefix))) {
+            resource = ModelImages[i].resource;
+            break;
+        }
+    }
 
-        ui->propertiesTable->setItem(15, 0, new QTableWidgetItem(QString("Raw timestamp [Hex]")));
-        ui->propertiesTable->setItem(15, 1, new QTableWidgetItem(QString::fromStdString(ii.internalTime)));
+    if (resource != m_modelImage) {
+        m_modelImage = resource;
+        ui->imageLabel->setPixmap(QPixmap(QString::fromLatin1(resource)));
+    }
+}
 
-        ui->propertiesTable->setItem(16, 0, new QTableWidgetItem(QString("Laser status")));
-        ui->propertiesTable->setItem(16, 1, new QTableWidgetItem(QString::fromStdString(ii.laserStatus)));
+void SensorInformationHelperPlugin::saveButtonClicked()
+{
+    QString defaulName = QString("/") +
+            QDateTime::currentDateTime().toString("yyyy_MM_dd_HH_mm_ss_zzz") +
+            ".txt";
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save information file as"),
+                                                    QDir::currentPath() + defaulName,
+                                                    "*.txt");
 
-        ui->propertiesTable->setItem(17, 0, new QTableWidgetItem(QString("Motor desired speed")));
-        ui->propertiesTable->setItem(17, 1, new QTableWidgetItem(QString::fromStdString(ii.motorDesiredSpeed)));
+    if (!fileName.isEmpty()) {
+        QFile file(fileName);
+        if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            QTextStream stream(&file);
 
-        ui->propertiesTable->setItem(18, 0, new QTableWidgetItem(QString("Current internal state")));
-        ui->propertiesTable->setItem(18, 1, new QTableWidgetItem(QString::fromStdString(ii.stateID)));
+            stream << QApplication::applicationName() << " = " <<
+                      QApplication::applicationVersion() << endl;
 
-        ui->propertiesTable->setItem(19, 0, new QTableWidgetItem(QString("Sensor situation")));
-        ui->propertiesTable->setItem(19, 1, new QTableWidgetItem(QString::fromStdString(ii.sensorSituation)));
+            for (int row = 0; row < m_properties->rowCount(); ++row) {
+                // Rows of a canceled reload stay empty
+                if (!m_properties->hasValue(row)) {
+                    continue;
+                }
+                stream << m_properties->name(row) << " = " <<
+                          m_properties->value(row) << endl;
+            }
 
-        //---------------------------------------------------------
-        QStringList commandsList = m_sensor->supportedModes();
-        QString commands;
-        for (int i = 0; i < commandsList.size(); ++i) {
-            commands.append(QString(" [%1]").arg(commandsList[i]));
+            file.close();
+            emit information(QApplication::applicationName(),
+                             tr("Sensor information were saved successfully."));
+        }
+        else {
+            emit error(QApplication::applicationName(),
+                       tr("Output file could not be created."));
         }
-
-        ui->propertiesTable->setItem(20, 0, new QTableWidgetItem(QString("Supported Modes")));
-        ui->propertiesTable->setItem(20, 1, new QTableWidgetItem(commands));
-
-        //-------------------------------------------------------------
     }
 }
 
-void SensorInformationHelperPlugin::updateUI(UrgLogHandler *logger)
+void SensorInformationHelperPlugin::reloadButtonClicked()
 {
-    resetTable(12);
-    m_model = logger->getModel().trimmed().toLower().split('(')[0];
-    if (m_model.startsWith("ubg-04lx-f01")) {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/ubg-04lx-f01")));
-    }
-    else if (m_model.startsWith("urg-04lx-ug01")) {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/urg-04lx-ug01")));
-    }
-    else if (m_model.startsWith("urg-04lx")) {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/urg-04lx")));
-    }
-    else if (m_model.startsWith("utm-30lx-ew")) {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/utm-30lx-ew")));
-    }
-    else if (m_model.startsWith("utm-30lx")) {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/utm-30lx")));
+    if (m_loaderBusy) {
+        // A live sample is short, the reload starts once it has finished
+        if (m_liveSample) {
+            m_reloadQueued = true;
+        }
+        return;
     }
-    else if (m_model.startsWith("uxm-30lx-ew")) {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/uxm-30lx-ew")));
+
+    if (m_sensor && !m_sensor->isWorking()) {
+        // The queries block on the sensor link, keep them off the GUI thread
+        m_properties->setLayout(SensorPropertyModel::SensorLayout);
+        m_properties->clearValues();
+        m_latencies.clear();
+        ui->latencyLabel->clear();
+        m_reloadCanceled = false;
+        setReloading(true);
+
+        m_loaderBusy = true;
+        m_loader->setRangeSensor(m_sensor);
+        m_loader->setQueries(SensorInformationLoader::AllQueries);
+        m_loader->start();
+        m_reloadTimer.start(ui->timeoutSpinBox->value() * 1000);
     }
     else {
-        ui->imageLabel->setPixmap(QPixmap(QString::fromUtf8(":/SensorInformationHelperPlugin/unknown")));
+        emit information(QApplication::applicationName(),
+                         tr("The sensor is working."));
     }
+}
 
-    ui->propertiesTable->setItem(0, 0, new QTableWidgetItem(QString("Application name")));
-    ui->propertiesTable->setItem(0, 1, new QTableWidgetItem(logger->getAppName()));
+// Cancel and timeout do not abort the query already sent: the remaining
+// queries are skipped and whatever arrives late is ignored. Reload stays
+// disabled until the loader thread has finished.
+void SensorInformationHelperPlugin::cancelReload()
+{
+    if (m_loader->isRunning()) {
+        m_reloadCanceled = true;
+        m_loader->requestInterruption();
+        ui->latencyLabel->setText(tr("Canceled, late answers are ignored"));
+    }
+}
 
-    ui->propertiesTable->setItem(1, 0, new QTableWidgetItem(QString("Application version")));
-    ui->propertiesTable->setItem(1, 1, new QTableWidgetItem(logger->getAppVersion()));
+void SensorInformationHelperPlugin::reloadTimedOut()
+{
+    if (m_loader->isRunning()) {
+        m_reloadCanceled = true;
+        m_loader->requestInterruption();
+        ui->latencyLabel->setText(tr("Timeout, late answers are ignored"));
+        emit warning(QApplication::applicationName(),
+                     tr("The sensor did not answer in time."));
+    }
+}
 
-    ui->propertiesTable->setItem(2, 0, new QTableWidgetItem(QString("Model")));
-    ui->propertiesTable->setItem(2, 1, new QTableWidgetItem(logger->getModel()));
+void SensorInformationHelperPlugin::sensorWorking()
+{
+    if (m_liveSample) {
+        // A capture started between liveSample() and the II query
+        ui->latencyLabel->setText(tr("Live paused: the sensor is working"));
+        m_liveTimeValid = false;
+        return;
+    }
+    if (m_reloadCanceled) {
+        return;
+    }
+    emit information(QApplication::applicationName(),
+                     tr("The sensor is working."));
+}
 
-    ui->propertiesTable->setItem(3, 0, new QTableWidgetItem(QString("Serial number")));
-    ui->propertiesTable->setItem(3, 1, new QTableWidgetItem(logger->getSerialNumber()));
+void SensorInformationHelperPlugin::queryLoaded(int query, qint64 msec)
+{
+    if (m_liveSample) {
+        liveSampleLoaded(msec);
+        return;
+    }
 
-    ui->propertiesTable->setItem(4, 0, new QTableWidgetItem(QString("Area front")));
-    ui->propertiesTable->setItem(4, 1, new QTableWidgetItem(QString::number(logger->getFrontStep())));
+    if (m_reloadCanceled) {
+        return;
+    }
 
-    ui->propertiesTable->setItem(5, 0, new QTableWidgetItem(QString("Area min")));
-    ui->propertiesTable->setItem(5, 1, new QTableWidgetItem(QString::number(logger->getStartStep())));
+    switch (query) {
+    case SensorInformationLoader::ParameterQuery:
+        setModelImage(QString::fromStdString(m_loader->parameter().model));
+        m_properties->setParameter(m_loader->parameter());
+        break;
+    case SensorInformationLoader::InformationQuery:
+        m_properties->setInformation(m_loader->information());
+        break;
+    case SensorInformationLoader::InternalInformationQuery:
+        m_properties->setInternalInformation(m_loader->internalInformation());
+        break;
+    case SensorInformationLoader::ModesQuery:
+        m_properties->setSupportedModes(m_loader->supportedModes());
+        break;
+    }
 
-    ui->propertiesTable->setItem(6, 0, new QTableWidgetItem(QString("Area max")));
-    ui->propertiesTable->setItem(6, 1, new QTableWidgetItem(QString::number(logger->getEndStep())));
+    m_latencies << QString("%1: %2 ms").arg(SensorInformationLoader::queryName(query)).arg(msec);
+    ui->latencyLabel->setText(m_latencies.join(", "));
+}
 
-    ui->propertiesTable->setItem(7, 0, new QTableWidgetItem(QString("Area total")));
-    ui->propertiesTable->setItem(7, 1, new QTableWidgetItem(QString::number(logger->getTotalSteps())));
+void SensorInformationHelperPlugin::reloadFinished()
+{
+    m_loaderBusy = false;
+    if (m_liveSample) {
+        m_liveSample = false;
+        if (m_reloadQueued) {
+            m_reloadQueued = false;
+            reloadButtonClicked();
+        }
+        return;
+    }
 
-    ui->propertiesTable->setItem(8, 0, new QTableWidgetItem(QString("Step grouping")));
-    ui->propertiesTable->setItem(8, 1, new QTableWidgetItem(QString::number(logger->getGrouping())));
+    m_reloadTimer.stop();
+    setReloading(false);
+}
 
-    ui->propertiesTable->setItem(9, 0, new QTableWidgetItem(QString("Min distance [mm]")));
-    ui->propertiesTable->setItem(9, 1, new QTableWidgetItem(QString::number(logger->getMinDistance())));
+void SensorInformationHelperPlugin::setLive(bool on)
+{
+    ui->trendWidget->setVisible(on);
+    if (on) {
+        ui->trendWidget->clear();
+        m_liveTimeValid = false;
+        m_timestampDrift = 0.0;
+        m_liveClock.start();
+        m_liveTimer.start(ui->liveIntervalSpinBox->value());
+    }
+    else {
+        m_liveTimer.stop();
+    }
+}
 
-    ui->propertiesTable->setItem(10, 0, new QTableWidgetItem(QString("Max distance [mm]")));
-    ui->propertiesTable->setItem(10, 1, new QTableWidgetItem(QString::number(logger->getMaxDistance())));
+void SensorInformationHelperPlugin::liveSample()
+{
+    if (!m_sensor || m_loaderBusy) {
+        return;
+    }
 
-    ui->propertiesTable->setItem(11, 0, new QTableWidgetItem(QString("Motor speed [rpm]")));
-    ui->propertiesTable->setItem(11, 1, new QTableWidgetItem(QString::number(logger->getMotorSpeed())));
+    // Never take the link away from a capture; sampling resumes once it stops.
+    // The loader checks again under the sensor's command lock before II.
+    if (m_sensor->isWorking()) {
+        ui->latencyLabel->setText(tr("Live paused: the sensor is working"));
+        m_liveTimeValid = false;
+        return;
+    }
 
-    //-------------------------------------------------------------
+    m_liveSample = true;
+    m_loaderBusy = true;
+    m_loader->setRangeSensor(m_sensor);
+    m_loader->setQueries(1 << SensorInformationLoader::InternalInformationQuery);
+    m_loader->start();
 }
 
-void SensorInformationHelperPlugin::resetTable(int rows)
+void SensorInformationHelperPlugin::liveSampleLoaded(qint64 msec)
 {
-    ui->propertiesTable->clear();
-
-    ui->propertiesTable->setRowCount(rows);
-    ui->propertiesTable->setColumnCount(2);
+    RangeSensorInternalInformation ii = m_loader->internalInformation();
+    m_properties->setInternalInformation(ii);
+
+    ui->trendWidget->addSample(MotorSpeedTrend, leadingNumber(ii.motorDesiredSpeed));
+    ui->trendWidget->addSample(LaserTrend,
+                               QString::fromStdString(ii.laserStatus).startsWith("ON", Qt::CaseInsensitive) ? 1.0 : 0.0);
+
+    // The sensor clock is a 24 bit millisecond counter; compare its progress
+    // with the host clock at the middle of the query
+    bool ok = false;
+    long sensorTime = QString::fromStdString(ii.internalTime).toLong(&ok, 16);
+    qint64 hostTime = m_liveClock.elapsed() - msec / 2;
+    if (ok) {
+        if (m_liveTimeValid) {
+            long sensorDelta = (sensorTime - m_lastSensorTime) & 0xffffff;
+            m_timestampDrift += sensorDelta - (hostTime - m_lastHostTime);
+            ui->trendWidget->addSample(DriftTrend, m_timestampDrift);
+        }
+        m_lastSensorTime = sensorTime;
+        m_lastHostTime = hostTime;
+        m_liveTimeValid = true;
+    }
 
-    QStringList labels;
-    labels << tr("Property") << tr("Value");
+    ui->trendWidget->addSample(LatencyTrend, msec);
+    ui->latencyLabel->setText(tr("Live II: %1 ms").arg(msec));
+}
 
-    ui->propertiesTable->setHorizontalHeaderLabels(labels);
-    ui->propertiesTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
-    ui->propertiesTable->horizontalHeader()->setSectionResizeMode(1, QHeaderView::Stretch);
+void SensorInformationHelperPlugin::dashboardTabChanged(int index)
+{
+    // The dashboard only polls while it is visible
+    if (ui->tabWidget->widget(index) == ui->dashboardTab) {
+        m_dashboard->refresh();
+        m_dashboardTimer.start();
+    }
+    else {
+        m_dashboardTimer.stop();
+    }
 }
 
-void SensorInformationHelperPlugin::saveButtonClicked()
+void SensorInformationHelperPlugin::exportStatistics()
 {
-    QString defaulName = QString("/") +
+    QString defaulName = QString("/statistics_") +
             QDateTime::currentDateTime().toString("yyyy_MM_dd_HH_mm_ss_zzz") +
-            ".txt";
+            ".csv";
     QString fileName = QFileDialog::getSaveFileName(this,
-                                                    tr("Save information file as"),
+                                                    tr("Export statistics as"),
                                                     QDir::currentPath() + defaulName,
-                                                    "*.txt");
+                                                    "*.csv");
 
     if (!fileName.isEmpty()) {
         QFile file(fileName);
         if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
             QTextStream stream(&file);
-
-            stream << QApplication::applicationName() << " = " <<
-                      QApplication::applicationVersion() << endl;
-
-            for (int row = 0; row < ui->propertiesTable->rowCount(); ++row) {
-                stream << ui->propertiesTable->item(row, 0)->text() << " = " <<
-                          ui->propertiesTable->item(row, 1)->text() << endl;
-            }
-
+            m_dashboard->exportStatistics(stream);
             file.close();
             emit information(QApplication::applicationName(),
-                             tr("Sensor information were saved successfully."));
+                             tr("Statistics were exported successfully."));
         }
         else {
             emit error(QApplication::applicationName(),
@@ -392,15 +605,11 @@ void SensorInformationHelperPlugin::saveButtonClicked()
     }
 }
 
-void SensorInformationHelperPlugin::reloadButtonClicked()
+void SensorInformationHelperPlugin::setReloading(bool reloading)
 {
-    if (m_sensor && !m_sensor->isWorking()) {
-        updateUI(m_sensor->parameterNow(), m_sensor->informationNow(), m_sensor->internalInformationNow());
-    }
-    else {
-        emit information(QApplication::applicationName(),
-                         tr("The sensor is working."));
-    }
+    ui->reloadButton->setEnabled(!reloading);
+    ui->cancelButton->setEnabled(reloading);
+    ui->timeoutSpinBox->setEnabled(!reloading);
 }
 
 void SensorInformationHelperPlugin::copy()
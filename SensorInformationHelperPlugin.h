@@ -24,9 +24,15 @@
 #include "HelperPluginInterface.h"
 
 #include <QTranslator>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSortFilterProxyModel>
 
 #include "RangeSensor.h"
 #include "UrgLogHandler.h"
+#include "SensorInformationLoader.h"
+#include "SensorPropertyModel.h"
+#include "SensorDashboardModel.h"
 
 using namespace qrk;
 
@@ -81,18 +87,60 @@ private slots:
     void reloadButtonClicked();
     void copy();
     void showSensorHomePage();
+    void cancelReload();
+    void reloadTimedOut();
+    void queryLoaded(int query, qint64 msec);
+    void reloadFinished();
+    void sensorWorking();
+    void setLive(bool on);
+    void liveSample();
+    void dashboardTabChanged(int index);
+    void exportStatistics();
 
 private:
     Ui::SensorInformationHelperPlugin* ui;
     RangeSensor* m_sensor;
     QString m_model;
+    const char* m_modelImage;
+    SensorPropertyModel* m_properties;
     QTranslator m_translator;
+    SensorInformationLoader* m_loader;
+    QTimer m_reloadTimer;
+    QStringList m_latencies;
+    bool m_reloadCanceled;
+    bool m_loaderBusy;
+
+    // Live II polling
+    enum {
+        MotorSpeedTrend = 0,
+        LaserTrend,
+        DriftTrend,
+        LatencyTrend,
+
+        LiveSamples = 300,
+        DashboardInterval = 1000, // [msec]
+    };
+    QTimer m_liveTimer;
+    bool m_liveSample;
+    bool m_reloadQueued;    // Reload clicked while a live sample ran
+    QElapsedTimer m_liveClock;
+    bool m_liveTimeValid;
+    long m_lastSensorTime;
+    qint64 m_lastHostTime;
+    double m_timestampDrift;
+
+    // Every sensor and log file known to the application
+    SensorDashboardModel* m_dashboard;
+    QSortFilterProxyModel* m_dashboardProxy;
+    QTimer m_dashboardTimer;
 
     void updateUI(RangeSensorParameter pp,
                   RangeSensorInformation vv,
                   RangeSensorInternalInformation ii);
     void updateUI(UrgLogHandler *logger);
-    void resetTable(int rows);
+    void setModelImage(const QString &model);
+    void setReloading(bool reloading);
+    void liveSampleLoaded(qint64 msec);
 
     void setRangeSensor(RangeSensor* sensor);
     void setLogger(UrgLogHandler* logger);
@@ -102,6 +150,10 @@ private:
     QVariant setDeviceMethod(const QVariantList &vars);
     QVariant setLoggerMethod(const QVariantList &vars);
     QVariant noReloadMethod(const QVariantList &vars);
+    QVariant addDeviceMethod(const QVariantList &vars);
+    QVariant removeDeviceMethod(const QVariantList &vars);
+    QVariant addLoggerMethod(const QVariantList &vars);
+    QVariant removeLoggerMethod(const QVariantList &vars);
 
 };
 
@@ -14,10 +14,18 @@
     INCLUDEPATH += $$PWD
 
     SOURCES += \
-        $$PWD/SensorInformationHelperPlugin.cpp
+        $$PWD/SensorInformationHelperPlugin.cpp \
+        $$PWD/SensorInformationLoader.cpp \
+        $$PWD/SensorPropertyModel.cpp \
+        $$PWD/SensorDashboardModel.cpp \
+        $$PWD/TrendWidget.cpp
 
     HEADERS  += \
-        $$PWD/SensorInformationHelperPlugin.h
+        $$PWD/SensorInformationHelperPlugin.h \
+        $$PWD/SensorInformationLoader.h \
+        $$PWD/SensorPropertyModel.h \
+        $$PWD/SensorDashboardModel.h \
+        $$PWD/TrendWidget.h
 
     FORMS += \
         $$PWD/SensorInformationHelperPlugin.ui
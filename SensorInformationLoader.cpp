@@ -0,0 +1,135 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "SensorInformationLoader.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+SensorInformationLoader::SensorInformationLoader(QObject* parent)
+    : QThread(parent)
+    , m_sensor(NULL)
+    , m_queries(AllQueries)
+{
+}
+
+SensorInformationLoader::~SensorInformationLoader()
+{
+    // Waits for the query in progress, bounded by the ScipHandler timeout
+    requestInterruption();
+    wait();
+}
+
+void SensorInformationLoader::setRangeSensor(RangeSensor* sensor)
+{
+    m_sensor = sensor;
+}
+
+void SensorInformationLoader::setQueries(int queries)
+{
+    m_queries = queries;
+}
+
+int SensorInformationLoader::queries() const
+{
+    return m_queries;
+}
+
+RangeSensorParameter SensorInformationLoader::parameter() const
+{
+    return m_parameter;
+}
+
+RangeSensorInformation SensorInformationLoader::information() const
+{
+    return m_information;
+}
+
+RangeSensorInternalInformation SensorInformationLoader::internalInformation() const
+{
+    return m_internalInformation;
+}
+
+QStringList SensorInformationLoader::supportedModes() const
+{
+    return m_modes;
+}
+
+QString SensorInformationLoader::queryName(int query)
+{
+    switch (query) {
+    case ParameterQuery:
+        return "PP";
+    case InformationQuery:
+        return "VV";
+    case InternalInformationQuery:
+        return "II";
+    case ModesQuery:
+        return tr("Modes");
+    default:
+        return QString();
+    }
+}
+
+void SensorInformationLoader::run()
+{
+    if (!m_sensor) {
+        return;
+    }
+
+    // All queries share the sensor link with the capture and the dashboard,
+    // so each one holds the command lock and checks again that no capture
+    // started since it was requested; each result is written before
+    // loaded() hands it to the GUI thread.
+    QElapsedTimer timer;
+    for (int query = 0; query < QueryCount; ++query) {
+        if (isInterruptionRequested()) {
+            return;
+        }
+        if (!(m_queries & (1 << query))) {
+            continue;
+        }
+
+        QMutexLocker locker(m_sensor->commandMutex());
+        if (m_sensor->isWorking()) {
+            emit sensorWorking();
+            return;
+        }
+
+        timer.start();
+        switch (query) {
+        case ParameterQuery:
+            m_parameter = m_sensor->parameterNow();
+            break;
+        case InformationQuery:
+            m_information = m_sensor->informationNow();
+            break;
+        case InternalInformationQuery:
+            m_internalInformation = m_sensor->internalInformationNow();
+            break;
+        case ModesQuery:
+            m_modes = m_sensor->supportedModes();
+            break;
+        }
+        qint64 msec = timer.elapsed();
+        locker.unlock();
+        emit loaded(query, msec);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef SENSORINFORMATIONLOADER_H
+#define SENSORINFORMATIONLOADER_H
+
+#include <QThread>
+#include <QStringList>
+
+#include "RangeSensor.h"
+#include "RangeSensorParameter.h"
+#include "RangeSensorInformation.h"
+#include "RangeSensorInternalInformation.h"
+
+using namespace qrk;
+
+/*!
+  \brief Queries PP, VV, II and the supported modes off the GUI thread
+
+  loaded() is emitted after each query with its latency; the result can
+  then be read from the GUI thread while the next query runs. Each query
+  holds the sensor's command lock, and sensorWorking() ends the run when
+  a capture has started meanwhile. An interruption request only skips
+  the queries not started yet. A query already sent is not aborted: it
+  ends with the sensor's answer or the response timeout of ScipHandler,
+  so callers that give up earlier just ignore the late results.
+  setQueries() restricts a run to some of the queries, e.g. II alone for
+  live polling.
+*/
+class SensorInformationLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum Query {
+        ParameterQuery = 0,
+        InformationQuery,
+        InternalInformationQuery,
+        ModesQuery,
+        QueryCount,
+    };
+
+    enum {
+        AllQueries = (1 << QueryCount) - 1,
+    };
+
+    explicit SensorInformationLoader(QObject* parent = 0);
+    virtual ~SensorInformationLoader();
+
+    void setRangeSensor(RangeSensor* sensor);
+
+    //! Bit mask of (1 << Query) to run, AllQueries by default
+    void setQueries(int queries);
+    int queries() const;
+
+    RangeSensorParameter parameter() const;
+    RangeSensorInformation information() const;
+    RangeSensorInternalInformation internalInformation() const;
+    QStringList supportedModes() const;
+
+    static QString queryName(int query);
+
+signals:
+    void loaded(int query, qint64 msec);
+
+    //! The sensor was capturing, the remaining queries were not sent
+    void sensorWorking();
+
+protected:
+    void run();
+
+private:
+    RangeSensor* m_sensor;
+    int m_queries;
+    RangeSensorParameter m_parameter;
+    RangeSensorInformation m_information;
+    RangeSensorInternalInformation m_internalInformation;
+    QStringList m_modes;
+};
+
+#endif // SENSORINFORMATIONLOADER_H
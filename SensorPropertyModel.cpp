@@ -0,0 +1,270 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "SensorPropertyModel.h"
+
+namespace
+{
+const char* SensorNames[] = {
+    "Model",
+    "Area front",
+    "Area min",
+    "Area max",
+    "Area total",
+    "Min distance [mm]",
+    "Max distance [mm]",
+    "Motor speed [rpm]",
+    "Product",
+    "Protocol",
+    "Firmware",
+    "Serial number",
+    "Vendor",
+    "Model",
+    "Communication type",
+    "Raw timestamp [Hex]",
+    "Laser status",
+    "Motor desired speed",
+    "Current internal state",
+    "Sensor situation",
+    "Supported Modes",
+};
+Q_STATIC_ASSERT(sizeof(SensorNames) / sizeof(SensorNames[0]) ==
+                SensorPropertyModel::SensorRowCount);
+
+const char* LoggerNames[] = {
+    "Application name",
+    "Application version",
+    "Model",
+    "Serial number",
+    "Area front",
+    "Area min",
+    "Area max",
+    "Area total",
+    "Step grouping",
+    "Min distance [mm]",
+    "Max distance [mm]",
+    "Motor speed [rpm]",
+};
+}
+
+SensorPropertyModel::SensorPropertyModel(QObject* parent)
+    : QAbstractTableModel(parent)
+    , m_layout(LoggerLayout)
+    , m_firstChanged(-1)
+    , m_lastChanged(-1)
+{
+    setLayout(SensorLayout);
+}
+
+void SensorPropertyModel::setLayout(Layout layout)
+{
+    if (layout == m_layout && !m_properties.isEmpty()) {
+        return;
+    }
+
+    const char** names = layout == SensorLayout ? SensorNames : LoggerNames;
+    int rows = layout == SensorLayout ?
+                int(sizeof(SensorNames) / sizeof(SensorNames[0])) :
+                int(sizeof(LoggerNames) / sizeof(LoggerNames[0]));
+
+    beginResetModel();
+    m_layout = layout;
+    m_properties.resize(rows);
+    for (int row = 0; row < rows; ++row) {
+        m_properties[row].name = names[row];
+        m_properties[row].value.clear();
+        m_properties[row].set = false;
+    }
+    m_firstChanged = -1;
+    m_lastChanged = -1;
+    endResetModel();
+}
+
+SensorPropertyModel::Layout SensorPropertyModel::layout() const
+{
+    return m_layout;
+}
+
+void SensorPropertyModel::clearValues()
+{
+    for (int row = 0; row < m_properties.size(); ++row) {
+        if (m_properties[row].set) {
+            setValue(row, QString());
+            m_properties[row].set = false;
+        }
+    }
+    flushChanges();
+}
+
+void SensorPropertyModel::setParameter(const RangeSensorParameter &pp)
+{
+    if (m_layout != SensorLayout) {
+        return;
+    }
+
+    setValue(ModelRow, QString::fromStdString(pp.model));
+    setValue(AreaFrontRow, QString::number(pp.area_front));
+    setValue(AreaMinRow, QString::number(pp.area_min));
+    setValue(AreaMaxRow, QString::number(pp.area_max));
+    setValue(AreaTotalRow, QString::number(pp.area_total));
+    setValue(MinDistanceRow, QString::number(pp.distance_min));
+    setValue(MaxDistanceRow, QString::number(pp.distance_max));
+    setValue(MotorSpeedRow, QString::number(pp.scan_rpm));
+    flushChanges();
+}
+
+void SensorPropertyModel::setInformation(const RangeSensorInformation &vv)
+{
+    if (m_layout != SensorLayout) {
+        return;
+    }
+
+    setValue(ProductRow, QString::fromStdString(vv.product));
+    setValue(ProtocolRow, QString::fromStdString(vv.protocol));
+    setValue(FirmwareRow, QString::fromStdString(vv.firmware));
+    setValue(SerialNumberRow, QString::fromStdString(vv.serial_number));
+    setValue(VendorRow, QString::fromStdString(vv.vendor));
+    flushChanges();
+}
+
+void SensorPropertyModel::setInternalInformation(const RangeSensorInternalInformation &ii)
+{
+    if (m_layout != SensorLayout) {
+        return;
+    }
+
+    setValue(InternalModelRow, QString::fromStdString(ii.model));
+    setValue(CommunicationTypeRow, QString::fromStdString(ii.communicationType));
+    setValue(RawTimestampRow, QString::fromStdString(ii.internalTime));
+    setValue(LaserStatusRow, QString::fromStdString(ii.laserStatus));
+    setValue(MotorDesiredSpeedRow, QString::fromStdString(ii.motorDesiredSpeed));
+    setValue(InternalStateRow, QString::fromStdString(ii.stateID));
+    setValue(SensorSituationRow, QString::fromStdString(ii.sensorSituation));
+    flushChanges();
+}
+
+void SensorPropertyModel::setSupportedModes(const QStringList &modes)
+{
+    if (m_layout != SensorLayout) {
+        return;
+    }
+
+    QString commands;
+    for (int i = 0; i < modes.size(); ++i) {
+        commands.append(QString(" [%1]").arg(modes[i]));
+    }
+    setValue(SupportedModesRow, commands);
+    flushChanges();
+}
+
+void SensorPropertyModel::setLogger(UrgLogHandler* logger)
+{
+    setLayout(LoggerLayout);
+
+    setValue(0, logger->getAppName());
+    setValue(1, logger->getAppVersion());
+    setValue(2, logger->getModel());
+    setValue(3, logger->getSerialNumber());
+    setValue(4, QString::number(logger->getFrontStep()));
+    setValue(5, QString::number(logger->getStartStep()));
+    setValue(6, QString::number(logger->getEndStep()));
+    setValue(7, QString::number(logger->getTotalSteps()));
+    setValue(8, QString::number(logger->getGrouping()));
+    setValue(9, QString::number(logger->getMinDistance()));
+    setValue(10, QString::number(logger->getMaxDistance()));
+    setValue(11, QString::number(logger->getMotorSpeed()));
+    flushChanges();
+}
+
+QString SensorPropertyModel::name(int row) const
+{
+    return QString::fromLatin1(m_properties[row].name);
+}
+
+QString SensorPropertyModel::value(int row) const
+{
+    return m_properties[row].value;
+}
+
+bool SensorPropertyModel::hasValue(int row) const
+{
+    return m_properties[row].set;
+}
+
+int SensorPropertyModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_properties.size();
+}
+
+int SensorPropertyModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(ColumnCount);
+}
+
+QVariant SensorPropertyModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    const Property &property = m_properties[index.row()];
+    if (index.column() == NameColumn) {
+        return QString::fromLatin1(property.name);
+    }
+    return property.value;
+}
+
+QVariant SensorPropertyModel::headerData(int section, Qt::Orientation orientation,
+                                         int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    return section == NameColumn ? tr("Property") : tr("Value");
+}
+
+void SensorPropertyModel::setValue(int row, const QString &value)
+{
+    Property &property = m_properties[row];
+    if (property.set && property.value == value) {
+        return;
+    }
+    property.value = value;
+    property.set = true;
+
+    // Changed rows are reported in contiguous ranges
+    if (m_firstChanged >= 0 && row != m_lastChanged + 1) {
+        flushChanges();
+    }
+    if (m_firstChanged < 0) {
+        m_firstChanged = row;
+    }
+    m_lastChanged = row;
+}
+
+void SensorPropertyModel::flushChanges()
+{
+    if (m_firstChanged < 0) {
+        return;
+    }
+    emit dataChanged(index(m_firstChanged, ValueColumn), index(m_lastChanged, ValueColumn));
+    m_firstChanged = -1;
+    m_lastChanged = -1;
+}
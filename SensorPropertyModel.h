@@ -0,0 +1,128 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef SENSORPROPERTYMODEL_H
+#define SENSORPROPERTYMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QStringList>
+
+#include "RangeSensorParameter.h"
+#include "RangeSensorInformation.h"
+#include "RangeSensorInternalInformation.h"
+#include "UrgLogHandler.h"
+
+using namespace qrk;
+
+/*!
+  \brief Property / value table of a sensor or of a log file
+
+  Rows are fixed by the layout and held in a flat array. Setting values
+  only emits dataChanged() for the rows whose text actually changed,
+  grouped in contiguous ranges, so that frequent refreshes leave the
+  view alone.
+*/
+class SensorPropertyModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Layout {
+        SensorLayout,
+        LoggerLayout,
+    };
+
+    enum Column {
+        NameColumn = 0,
+        ValueColumn,
+        ColumnCount,
+    };
+
+    enum SensorRow {
+        // PP
+        ModelRow = 0,
+        AreaFrontRow,
+        AreaMinRow,
+        AreaMaxRow,
+        AreaTotalRow,
+        MinDistanceRow,
+        MaxDistanceRow,
+        MotorSpeedRow,
+        // VV
+        ProductRow,
+        ProtocolRow,
+        FirmwareRow,
+        SerialNumberRow,
+        VendorRow,
+        // II
+        InternalModelRow,
+        CommunicationTypeRow,
+        RawTimestampRow,
+        LaserStatusRow,
+        MotorDesiredSpeedRow,
+        InternalStateRow,
+        SensorSituationRow,
+
+        SupportedModesRow,
+        SensorRowCount,
+    };
+
+    explicit SensorPropertyModel(QObject* parent = 0);
+
+    //! Change the rows; the values are cleared when the layout changes
+    void setLayout(Layout layout);
+    Layout layout() const;
+    void clearValues();
+
+    void setParameter(const RangeSensorParameter &pp);
+    void setInformation(const RangeSensorInformation &vv);
+    void setInternalInformation(const RangeSensorInternalInformation &ii);
+    void setSupportedModes(const QStringList &modes);
+    void setLogger(UrgLogHandler* logger);
+
+    QString name(int row) const;
+    QString value(int row) const;
+    //! False for a row not loaded yet, e.g. after a canceled reload
+    bool hasValue(int row) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const;
+
+private:
+    struct Property {
+        const char* name;
+        QString value;
+        bool set;
+    };
+
+    QVector<Property> m_properties;
+    Layout m_layout;
+    int m_firstChanged;
+    int m_lastChanged;
+
+    void setValue(int row, const QString &value);
+    void flushChanges();
+};
+
+#endif // SENSORPROPERTYMODEL_H
@@ -0,0 +1,134 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#include "TrendWidget.h"
+
+#include <QPainter>
+
+TrendWidget::TrendWidget(QWidget* parent)
+    : QWidget(parent)
+{
+}
+
+void TrendWidget::setSeries(const QStringList &names, int capacity)
+{
+    m_series.resize(names.size());
+    for (int i = 0; i < names.size(); ++i) {
+        m_series[i].name = names[i];
+        m_series[i].values.fill(0.0, capacity);
+        m_series[i].head = 0;
+        m_series[i].size = 0;
+    }
+    m_points.resize(capacity);
+    update();
+}
+
+void TrendWidget::addSample(int series, double value)
+{
+    if (series < 0 || series >= m_series.size()) {
+        return;
+    }
+
+    Series &s = m_series[series];
+    int capacity = s.values.size();
+    if (capacity == 0) {
+        return;
+    }
+
+    s.values[s.head] = value;
+    s.head = (s.head + 1) % capacity;
+    if (s.size < capacity) {
+        ++s.size;
+    }
+    update();
+}
+
+void TrendWidget::clear()
+{
+    for (int i = 0; i < m_series.size(); ++i) {
+        m_series[i].head = 0;
+        m_series[i].size = 0;
+    }
+    update();
+}
+
+QSize TrendWidget::sizeHint() const
+{
+    return QSize(400, 60 * qMax(1, m_series.size()));
+}
+
+void TrendWidget::paintEvent(QPaintEvent* event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+    if (m_series.isEmpty()) {
+        return;
+    }
+
+    int capacity = m_points.size();
+    qreal bandHeight = qreal(height()) / m_series.size();
+    qreal step = capacity > 1 ? qreal(width() - 1) / (capacity - 1) : 0;
+
+    for (int i = 0; i < m_series.size(); ++i) {
+        const Series &s = m_series[i];
+        qreal top = i * bandHeight;
+
+        painter.setPen(palette().mid().color());
+        painter.drawLine(QPointF(0, top + bandHeight - 1),
+                         QPointF(width(), top + bandHeight - 1));
+        if (s.size == 0) {
+            painter.setPen(palette().text().color());
+            painter.drawText(QRectF(4, top, width() - 8, bandHeight),
+                             Qt::AlignLeft | Qt::AlignTop, s.name);
+            continue;
+        }
+
+        // Oldest sample first, right aligned so the newest one is at the edge
+        int first = (s.head - s.size + capacity) % capacity;
+        double minimum = s.values[first];
+        double maximum = minimum;
+        for (int k = 1; k < s.size; ++k) {
+            double value = s.values[(first + k) % capacity];
+            minimum = qMin(minimum, value);
+            maximum = qMax(maximum, value);
+        }
+        double range = maximum > minimum ? maximum - minimum : 1.0;
+        qreal margin = 4;
+        qreal scale = (bandHeight - 2 * margin) / range;
+        qreal left = (capacity - s.size) * step;
+
+        for (int k = 0; k < s.size; ++k) {
+            double value = s.values[(first + k) % capacity];
+            m_points[k] = QPointF(left + k * step,
+                                  top + bandHeight - margin - (value - minimum) * scale);
+        }
+
+        painter.setPen(palette().highlight().color());
+        painter.drawPolyline(m_points.constData(), s.size);
+
+        double latest = s.values[(s.head - 1 + capacity) % capacity];
+        painter.setPen(palette().text().color());
+        painter.drawText(QRectF(4, top, width() - 8, bandHeight),
+                         Qt::AlignLeft | Qt::AlignTop,
+                         QString("%1: %2").arg(s.name).arg(latest));
+    }
+}
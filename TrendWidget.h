@@ -0,0 +1,65 @@
+/*
+	This file is part of the UrgBenri application.
+
+	Copyright (c) 2016 Mehrez Kristou.
+	All rights reserved.
+
+	Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+	1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+	2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+	3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+
+	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+	Please contact kristou@hokuyo-aut.jp for more details.
+
+*/
+
+#ifndef TRENDWIDGET_H
+#define TRENDWIDGET_H
+
+#include <QWidget>
+#include <QVector>
+#include <QPointF>
+#include <QStringList>
+
+/*!
+  \brief Stacked trend lines of fixed-size sample series
+
+  Each series keeps its most recent samples in a ring allocated by
+  setSeries(), and is drawn in its own band scaled to its range. Adding
+  a sample or repainting does not allocate.
+*/
+class TrendWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TrendWidget(QWidget* parent = 0);
+
+    //! Replace the series, keeping at most \p capacity samples each
+    void setSeries(const QStringList &names, int capacity);
+    void addSample(int series, double value);
+    void clear();
+
+    QSize sizeHint() const;
+
+protected:
+    void paintEvent(QPaintEvent* event);
+
+private:
+    struct Series {
+        QString name;
+        QVector<double> values;
+        int head;
+        int size;
+    };
+
+    QVector<Series> m_series;
+    QVector<QPointF> m_points;
+};
+
+#endif // TRENDWIDGET_H